@@ -0,0 +1,52 @@
+// Checks renderFormatString on a format string compiled by the parser and the optimizer:
+// widths, alignment and precision for every kind of value, ints beyond 64 bits included,
+// and int templates the optimizer folded into the literal text
+// g++ -std=c++20 -O2 bench/format-string.cpp src/runtime/*.cpp src/lexer/*.cpp src/parser/*.cpp src/optimizer/*.cpp -pthread -o bin/format-string
+
+#include "../src/include/lexer.hpp"
+#include "../src/include/parser.hpp"
+#include "../src/include/optimizer.hpp"
+#include "../src/runtime/format.hpp"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char *source = R"(fn main(a, b, c, d):
+    println("[{a:>8}] [{b:.2}] [{c}] [{d:<6}] {007}!")
+)";
+
+int main(){
+    std::istringstream input(source);
+    Lexer lexer(&input);
+    Parser parser;
+    AstNode *root = parser.parse(lexer.getTokens());
+    Optimizer optimizer{OptimizerOptions()};
+    root = optimizer.optimize(root);
+    // main's only expression is println(format)
+    AstNode *call = root->as<Block>().expressions[0]->as<Function>().block->as<Block>().expressions[0];
+    AstNode *format = call->as<BinaryOperation>().right->as<CallArgsList>().args[0];
+
+    Integer big = Integer::parse("-123456789012345678901234567890");
+    struct {
+        std::vector<FormatValue> values;
+        std::string expected;
+    } cases[] = {
+        { { 42LL, 3.14159, true, std::string_view("ab") }, "[      42] [3.14] [true] [ab    ] 7!" },
+        { { -7LL, 2.0, std::string_view("text"), false }, "[      -7] [2.00] [text] [false ] 7!" },
+        { { std::string_view("left"), 0.005, 1.5, 123456789LL }, "[    left] [0.01] [1.5] [123456789] 7!" },
+        { { &big, -1.0, &big, std::string_view("") }, "[-123456789012345678901234567890] [-1.00] "
+            "[-123456789012345678901234567890] [      ] 7!" },
+    };
+    size_t failures = 0;
+    for(auto &test : cases){
+        std::string result = renderFormatString(format, test.values);
+        if(result != test.expected){
+            failures++;
+            std::printf("expected %s\n     got %s\n", test.expected.c_str(), result.c_str());
+        }
+    }
+    std::printf("%zu failures\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,57 @@
+// Checks the generational heap with a small nursery that fills up every few allocations.
+// Each cell of a list is built from the previous one and a fresh cell that nothing else
+// points to, often just as the nursery runs out. The collection must not free that fresh
+// cell before the new one holds it, and must update both of its slots. The whole list is
+// then walked back
+// g++ -std=c++20 -O2 bench/heap-collection.cpp src/runtime/heap.cpp -o bin/heap-collection
+
+#include "../src/runtime/heap.hpp"
+
+#include <cstdio>
+
+static constexpr size_t cells = 100000;
+
+struct Cell : public HeapObject<Cell> {
+    Object *next;
+    Object *other;
+    size_t value;
+
+    Cell(Object *next, Object *other, size_t value)
+      : next(next), other(other), value(value)
+    {
+    }
+    Cell(Cell &&cell)
+      : HeapObject<Cell>(cell), next(cell.next), other(cell.other), value(cell.value)
+    {
+    }
+    void trace(const Tracer &tracer) override {
+        tracer(next);
+        tracer(other);
+    }
+};
+
+int main(){
+    Heap heap(4096);
+    Object *list = nullptr;
+    heap.addRoot(&list);
+    for(size_t i = 0; i < cells; i++){
+        list = heap.allocate<Cell>(list, heap.allocate<Cell>(nullptr, nullptr, i), i);
+        // Garbage pointing into the list, so collections also have something to free
+        if(i % 7 == 0){
+            heap.allocate<Cell>(list, list, cells);
+        }
+    }
+    size_t failures = 0;
+    size_t expected = cells;
+    for(Object *cur = list; cur; cur = static_cast<Cell*>(cur)->next){
+        Cell *cell = static_cast<Cell*>(cur);
+        expected--;
+        failures += cell->value != expected || static_cast<Cell*>(cell->other)->value != expected;
+    }
+    failures += expected != 0;
+    heap.removeRoot(&list);
+    std::printf("%zu minor and %zu major collections, %zu promoted, %zu freed\n", heap.stats.minorCollections,
+        heap.stats.majorCollections, heap.stats.promotedObjects, heap.stats.freedObjects);
+    std::printf("%zu failures\n", failures);
+    return failures != 0;
+}
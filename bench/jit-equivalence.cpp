@@ -0,0 +1,266 @@
+// Checks the JIT's native code against a reference evaluator with the runtime's Integer
+// semantics. Every function of the corpus is called through Jit::call on random arguments,
+// overflowing ones included, until it is hot and compiled. A compiled call must either bail
+// out or return exactly the reference result. Every function of the corpus, the mutually
+// recursive even and odd included, must end up compiled.
+// g++ -std=c++20 -O2 bench/jit-equivalence.cpp src/runtime/*.cpp src/lexer/*.cpp src/parser/*.cpp src/optimizer/*.cpp -pthread -o bin/jit-equivalence
+
+#include "../src/include/lexer.hpp"
+#include "../src/include/parser.hpp"
+#include "../src/include/optimizer.hpp"
+#include "../src/runtime/jit.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static constexpr size_t callsPerFunction = 4 * jitCallThreshold;
+
+static const char *corpus = R"(fn fib(n: int):
+    if n < 2:
+        n
+    else:
+        fib(n - 1) + fib(n - 2)
+
+fn fact(n: int):
+    if n > 1:
+        n * fact(n - 1)
+    else:
+        1
+
+fn sumTo(n: int, acc: int):
+    if n <= 0:
+        acc
+    else:
+        sumTo(n - 1, acc + n)
+
+fn poly(a: int, b: int, c: int, x: int):
+    square = x * x
+    a * square + b * x - c
+
+fn clamp(x: int, low: int, high: int):
+    if x < low:
+        low
+    elif x > high and high >= low:
+        high
+    else:
+        -x + 2 * x
+
+fn steps(n: int, count: int):
+    if n <= 1:
+        count
+    elif n == 2:
+        count + 1
+    else:
+        steps(n - 2, count + 1)
+
+fn mix(a: int, b: int, c: int, d: int, e: int, f: int):
+    poly(a, b, c, d) - clamp(e, f, a) + fact(3)
+
+fn even(n: int):
+    if n <= 0:
+        1
+    else:
+        odd(n - 1)
+
+fn odd(n: int):
+    if n <= 0:
+        0
+    else:
+        even(n - 1)
+)";
+
+using Env = std::vector<std::pair<std::string, Integer>>;
+
+struct Reference {
+    std::unordered_map<std::string, AstNode*> functions;
+
+    static Integer lookup(const Env &env, const std::string &name){
+        for(size_t i = env.size(); i-- > 0;){
+            if(env[i].first == name){
+                return env[i].second;
+            }
+        }
+        throw SystemError("Unbound name " + name, __FILE_NAME__, __LINE__);
+    }
+
+    static AstNode* unwrap(AstNode *node){
+        if(node->type == NodeType::tuplePattern && node->as<TuplePattern>().children.size() == 1){
+            return node->as<TuplePattern>().children[0];
+        }
+        if(node->type == NodeType::tupleExpression && node->as<TupleExpression>().children.size() == 1){
+            return node->as<TupleExpression>().children[0];
+        }
+        return node;
+    }
+
+    bool condition(AstNode *node, Env &env){
+        switch(node->type){
+        case NodeType::boolLiteral:
+            return node->as<BoolLiteral>().value;
+        case NodeType::conjunction:
+            return condition(node->as<BinaryOperation>().left, env) && condition(node->as<BinaryOperation>().right, env);
+        default:
+        break;
+        }
+        Integer left = evaluate(node->as<BinaryOperation>().left, env);
+        Integer right = evaluate(node->as<BinaryOperation>().right, env);
+        switch(node->type){
+        case NodeType::lessThan:
+            return left < right;
+        case NodeType::greaterThan:
+            return left > right;
+        case NodeType::lessEqual:
+            return left <= right;
+        case NodeType::greaterEqual:
+            return left >= right;
+        case NodeType::equality:
+            return left == right;
+        case NodeType::inequality:
+            return !(left == right);
+        default:
+            throw SystemError(std::string("Unexpected condition ") + getNodeTypeName(node->type), __FILE_NAME__, __LINE__);
+        }
+    }
+
+    Integer call(AstNode *fn, const std::vector<Integer> &args){
+        Env env;
+        std::vector<AstNode*> &params = fn->as<Function>().paramList->as<FnParamList>().params;
+        for(size_t i = 0; i < params.size(); i++){
+            env.emplace_back(params[i]->type == NodeType::typedIdentifier ?
+                params[i]->as<TypedIdentifier>().name : params[i]->as<Identifier>().name, args[i]);
+        }
+        return evaluate(fn->as<Function>().block, env);
+    }
+
+    Integer evaluate(AstNode *node, Env &env){
+        switch(node->type){
+        case NodeType::intLiteral:
+            return node->as<IntLiteral>().integer;
+        case NodeType::identifier:
+            return lookup(env, node->as<Identifier>().name);
+        case NodeType::addition:
+            return evaluate(node->as<BinaryOperation>().left, env) + evaluate(node->as<BinaryOperation>().right, env);
+        case NodeType::subtraction:
+            return evaluate(node->as<BinaryOperation>().left, env) - evaluate(node->as<BinaryOperation>().right, env);
+        case NodeType::multiplication:
+            return evaluate(node->as<BinaryOperation>().left, env) * evaluate(node->as<BinaryOperation>().right, env);
+        case NodeType::plusSign:
+            return evaluate(node->as<UnaryOperation>().expr, env);
+        case NodeType::minusSign:
+            return -evaluate(node->as<UnaryOperation>().expr, env);
+        case NodeType::tupleExpression:
+            return evaluate(unwrap(node), env);
+        case NodeType::block:
+        {
+            size_t size = env.size();
+            std::vector<AstNode*> &expressions = node->as<Block>().expressions;
+            for(size_t i = 0; i + 1 < expressions.size(); i++){
+                AstNode *lhs = unwrap(expressions[i]->as<Assignment>().lhs);
+                env.emplace_back(lhs->as<Identifier>().name, evaluate(expressions[i]->as<Assignment>().rhs, env));
+            }
+            Integer result = evaluate(expressions.back(), env);
+            env.resize(size);
+            return result;
+        }
+        case NodeType::ifExpr:
+        {
+            IfExpr &ifExpr = node->as<IfExpr>();
+            if(condition(ifExpr.condition, env)){
+                return evaluate(ifExpr.ifBlock, env);
+            }
+            for(size_t i = 0; i < ifExpr.elifBlock.size(); i++){
+                if(condition(ifExpr.elifCondition[i], env)){
+                    return evaluate(ifExpr.elifBlock[i], env);
+                }
+            }
+            return evaluate(ifExpr.elseBlock, env);
+        }
+        case NodeType::call:
+        case NodeType::tailCall:
+        {
+            std::vector<Integer> args;
+            for(AstNode *arg : node->as<BinaryOperation>().right->as<CallArgsList>().args){
+                args.push_back(evaluate(arg, env));
+            }
+            return call(functions.at(node->as<BinaryOperation>().left->as<Identifier>().name), args);
+        }
+        default:
+            throw SystemError(std::string("Unexpected node ") + getNodeTypeName(node->type), __FILE_NAME__, __LINE__);
+        }
+    }
+};
+
+// Mostly small values, some near the 64-bit limits so arithmetic overflows and bails out
+static int64_t randomArgument(std::mt19937_64 &random, int64_t limit){
+    switch(random() % 8){
+    case 0:
+        return static_cast<int64_t>(random());
+    case 1:
+        return INT64_MAX - static_cast<int64_t>(random() % 16);
+    default:
+        return static_cast<int64_t>(random() % (2 * limit + 1)) - limit;
+    }
+}
+
+int main(){
+    std::istringstream source(corpus);
+    Lexer lexer(&source);
+    Parser parser;
+    AstNode *root = parser.parse(lexer.getTokens());
+    OptimizerOptions options;
+    options.inlining = false;
+    Optimizer optimizer(options);
+    root = optimizer.optimize(root);
+
+    Reference reference;
+    Jit jit;
+    jit.addFunctions(root);
+    for(AstNode *expr : root->as<Block>().expressions){
+        reference.functions[expr->as<Function>().name->as<Identifier>().name] = expr;
+    }
+
+    std::mt19937_64 random(42);
+    size_t failures = 0;
+    for(AstNode *fn : root->as<Block>().expressions){
+        const std::string &name = fn->as<Function>().name->as<Identifier>().name;
+        size_t params = fn->as<Function>().paramList->as<FnParamList>().params.size();
+        // Recursion depth follows the first argument, keep it where the reference stays fast
+        int64_t limit = name == "fib" ? 20 : name == "sumTo" || name == "steps" ? 5000 : 1000;
+        size_t native = 0;
+        size_t bailedOut = 0;
+        for(size_t i = 0; i < callsPerFunction; i++){
+            std::vector<int64_t> args(params);
+            std::vector<Integer> integers;
+            for(size_t p = 0; p < params; p++){
+                args[p] = randomArgument(random, limit);
+                if(p == 0 && name != "poly" && name != "clamp" && name != "mix"){
+                    args[p] = std::min<int64_t>(args[p], limit);
+                }
+                integers.emplace_back(args[p]);
+            }
+            std::optional<int64_t> result = jit.call(fn, args);
+            if(!result){
+                // Past the threshold call() has compiled the function, compile() only looks it up
+                bailedOut += i + 1 >= jitCallThreshold && jit.compile(fn);
+                continue;
+            }
+            native++;
+            Integer expected = reference.call(fn, integers);
+            if(!(expected == Integer(*result))){
+                failures++;
+                std::printf("%s: native %lld, reference %s\n", name.c_str(), static_cast<long long>(*result),
+                    expected.toString().c_str());
+            }
+        }
+        bool compiled = jit.compile(fn);
+        failures += !compiled;
+        std::printf("%-8s %s, %5zu native calls, %5zu bailed out\n", name.c_str(),
+            compiled ? "compiled" : "interpreted", native, bailedOut);
+    }
+    std::printf("%zu failures\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,270 @@
+// Checks every array kernel at every dispatch level the CPU supports against plain loops
+// written from the contract in kernels.hpp. Inputs have every length up to a few registers
+// past the widest vector, start at unaligned offsets and are mixed with edge values:
+// int limits that overflow, NaNs of both signs, infinities and signed zeros. Results must
+// match bit for bit, overflowing int elements included, except for the sign and payload
+// of a NaN computed by float arithmetic
+// g++ -std=c++20 -O2 bench/kernel-equivalence.cpp src/runtime/kernels.cpp -o bin/kernel-equivalence
+
+#include "../src/runtime/kernels.hpp"
+
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr size_t maximumLength = 80;
+static constexpr size_t roundsPerLength = 50;
+
+static size_t failures = 0;
+
+static void check(bool ok, const char *kernel, size_t n){
+    if(!ok){
+        failures++;
+        std::printf("  FAILED %s, %zu elements\n", kernel, n);
+    }
+}
+
+static bool sameBits(double a, double b){
+    return std::bit_cast<uint64_t>(a) == std::bit_cast<uint64_t>(b);
+}
+
+// Arithmetic with two NaN operands returns the first one, and the compiler may swap the
+// operands of a + b or a * b, so a NaN result only has to be some NaN
+static bool sameValue(double a, double b){
+    return sameBits(a, b) || (std::isnan(a) && std::isnan(b));
+}
+
+// References
+
+static bool referenceSum(const int64_t *data, size_t n, int64_t &result){
+    __int128 total = 0;
+    for(size_t i = 0; i < n; i++){
+        total += data[i];
+    }
+    result = static_cast<int64_t>(total);
+    return total >= std::numeric_limits<int64_t>::min() && total <= std::numeric_limits<int64_t>::max();
+}
+
+// Lane k sums elements k, k + 4, k + 8 ... of the whole groups of 4, then the tail is added in order
+static double referenceSum(const double *data, size_t n){
+    double lanes[4] = { 0, 0, 0, 0 };
+    size_t whole = n / 4 * 4;
+    for(size_t i = 0; i < whole; i++){
+        lanes[i % 4] += data[i];
+    }
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for(size_t i = whole; i < n; i++){
+        total += data[i];
+    }
+    return total;
+}
+
+// `x < m ? x : m` per lane over the whole groups of 4, first group as the start, then the
+// lanes and the tail in order. Below 4 elements the first element is every lane
+template<typename Pick>
+static double referencePick(const double *data, size_t n, Pick pick){
+    double lanes[4];
+    size_t whole = n < 4 ? 1 : n / 4 * 4;
+    for(size_t k = 0; k < 4; k++){
+        lanes[k] = data[n < 4 ? 0 : k];
+    }
+    for(size_t i = 4; i < whole; i++){
+        lanes[i % 4] = pick(data[i], lanes[i % 4]);
+    }
+    double result = lanes[0];
+    for(size_t k = 1; k < 4; k++){
+        result = pick(lanes[k], result);
+    }
+    for(size_t i = whole; i < n; i++){
+        result = pick(data[i], result);
+    }
+    return result;
+}
+
+// Inputs
+
+static int64_t randomInt(std::mt19937_64 &random){
+    switch(random() % 8){
+    case 0:
+        return std::numeric_limits<int64_t>::max() - static_cast<int64_t>(random() % 4);
+    case 1:
+        return std::numeric_limits<int64_t>::min() + static_cast<int64_t>(random() % 4);
+    case 2:
+        return static_cast<int64_t>(random());
+    default:
+        return static_cast<int64_t>(random() % 2001) - 1000;
+    }
+}
+
+static double randomFloat(std::mt19937_64 &random){
+    switch(random() % 16){
+    case 0:
+        return std::numeric_limits<double>::quiet_NaN();
+    case 1:
+        return -std::numeric_limits<double>::quiet_NaN();
+    case 2:
+        return random() % 2 ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+    case 3:
+        return random() % 2 ? 0.0 : -0.0;
+    case 4:
+        return std::bit_cast<double>(random());
+    default:
+        return std::uniform_real_distribution<double>(-1e6, 1e6)(random);
+    }
+}
+
+// Most arrays hold no special value at all, so the fast paths are checked too
+template<typename T, typename Random>
+static std::vector<T> randomArray(std::mt19937_64 &random, size_t n, Random element){
+    std::vector<T> values(n + 1);
+    bool plain = random() % 2;
+    for(T &value : values){
+        value = plain ? static_cast<T>(static_cast<int64_t>(random() % 2001) - 1000) : element(random);
+    }
+    return values;
+}
+
+static void checkBytes(std::mt19937_64 &random, size_t n){
+    std::string a(n + 1, '\0');
+    for(char &c : a){
+        c = static_cast<char>(random() % 4 ? 'a' + random() % 3 : random());
+    }
+    // Odd offsets keep the loads unaligned
+    const char *data = a.data() + 1;
+    std::string b(data, n);
+    if(n > 0 && random() % 2){
+        b[random() % n] ^= 1 << (random() % 8);
+    }
+    check(bytesEqual(data, b.data(), n) == (std::memcmp(data, b.data(), n) == 0), "bytesEqual", n);
+    char needle = n > 0 && random() % 2 ? data[random() % n] : static_cast<char>(random());
+    size_t expected = std::string_view(data, n).find(needle);
+    check(indexOfByte(data, n, needle) == (expected == std::string_view::npos ? n : expected), "indexOfByte", n);
+    std::string reversed(n, '\0');
+    reverseBytes(data, reversed.data(), n);
+    check(reversed == std::string(std::string_view(data, n).rbegin(), std::string_view(data, n).rend()), "reverseBytes", n);
+}
+
+static void checkInts(std::mt19937_64 &random, size_t n){
+    std::vector<int64_t> left = randomArray<int64_t>(random, n, randomInt);
+    std::vector<int64_t> right = randomArray<int64_t>(random, n, randomInt);
+    const int64_t *a = left.data() + 1;
+    const int64_t *b = right.data() + 1;
+
+    int64_t needle = n > 0 && random() % 2 ? a[random() % n] : randomInt(random);
+    size_t expectedIndex = n;
+    for(size_t i = 0; i < n && expectedIndex == n; i++){
+        expectedIndex = a[i] == needle ? i : n;
+    }
+    check(indexOfInt(a, n, needle) == expectedIndex, "indexOfInt", n);
+
+    std::vector<uint64_t> reversed(n);
+    reverseWords(reinterpret_cast<const uint64_t*>(a), reversed.data(), n);
+    bool ok = true;
+    for(size_t i = 0; i < n; i++){
+        ok = ok && reversed[i] == static_cast<uint64_t>(a[n - 1 - i]);
+    }
+    check(ok, "reverseWords", n);
+
+    int64_t sum = 0;
+    int64_t expectedSum = 0;
+    bool fits = referenceSum(a, n, expectedSum);
+    check(sumInts(a, n, sum) == fits && (!fits || sum == expectedSum), "sumInts", n);
+
+    struct {
+        const char *name;
+        bool (*kernel)(const int64_t*, const int64_t*, int64_t*, size_t);
+        bool (*reference)(int64_t, int64_t, int64_t*);
+    } operations[] = {
+        { "addInts", addInts, [](int64_t x, int64_t y, int64_t *out){ return __builtin_add_overflow(x, y, out); } },
+        { "subInts", subInts, [](int64_t x, int64_t y, int64_t *out){ return __builtin_sub_overflow(x, y, out); } },
+        { "mulInts", mulInts, [](int64_t x, int64_t y, int64_t *out){ return __builtin_mul_overflow(x, y, out); } },
+    };
+    for(auto &operation : operations){
+        std::vector<int64_t> out(n);
+        std::vector<int64_t> expected(n);
+        bool overflow = false;
+        for(size_t i = 0; i < n; i++){
+            overflow |= operation.reference(a[i], b[i], &expected[i]);
+        }
+        check(operation.kernel(a, b, out.data(), n) == !overflow && out == expected, operation.name, n);
+    }
+
+    if(n > 0){
+        int64_t minimum = a[0];
+        int64_t maximum = a[0];
+        for(size_t i = 1; i < n; i++){
+            minimum = std::min(minimum, a[i]);
+            maximum = std::max(maximum, a[i]);
+        }
+        check(minInts(a, n) == minimum, "minInts", n);
+        check(maxInts(a, n) == maximum, "maxInts", n);
+    }
+}
+
+static void checkFloats(std::mt19937_64 &random, size_t n){
+    std::vector<double> left = randomArray<double>(random, n, randomFloat);
+    std::vector<double> right = randomArray<double>(random, n, randomFloat);
+    const double *a = left.data() + 1;
+    const double *b = right.data() + 1;
+
+    check(sameValue(sumFloats(a, n), referenceSum(a, n)), "sumFloats", n);
+
+    struct {
+        const char *name;
+        void (*kernel)(const double*, const double*, double*, size_t);
+        double (*reference)(double, double);
+    } operations[] = {
+        { "addFloats", addFloats, [](double x, double y){ return x + y; } },
+        { "subFloats", subFloats, [](double x, double y){ return x - y; } },
+        { "mulFloats", mulFloats, [](double x, double y){ return x * y; } },
+    };
+    for(auto &operation : operations){
+        std::vector<double> out(n);
+        bool ok = true;
+        operation.kernel(a, b, out.data(), n);
+        for(size_t i = 0; i < n; i++){
+            ok = ok && sameValue(out[i], operation.reference(a[i], b[i]));
+        }
+        check(ok, operation.name, n);
+    }
+
+    if(n > 0){
+        double minimum = referencePick(a, n, [](double x, double m){ return x < m ? x : m; });
+        double maximum = referencePick(a, n, [](double x, double m){ return x > m ? x : m; });
+        check(sameBits(minFloats(a, n), minimum), "minFloats", n);
+        check(sameBits(maxFloats(a, n), maximum), "maxFloats", n);
+    }
+}
+
+int main(){
+    KernelLevel detected = detectKernelLevel();
+    for(KernelLevel level : { KernelLevel::scalar, KernelLevel::sse42, KernelLevel::avx2 }){
+        if(level > detected){
+            std::printf("%s: not supported by this CPU, skipped\n", getKernelLevelName(level));
+            continue;
+        }
+        setKernelLevel(level);
+        std::printf("%s\n", getKernelLevelName(getKernelLevel()));
+        size_t before = failures;
+        std::mt19937_64 random(42);
+        for(size_t n = 0; n <= maximumLength; n++){
+            for(size_t round = 0; round < roundsPerLength; round++){
+                checkBytes(random, n);
+                checkInts(random, n);
+                checkFloats(random, n);
+            }
+        }
+        for(size_t n : { 1000, 4099, 1 << 16 }){
+            checkBytes(random, n);
+            checkInts(random, n);
+            checkFloats(random, n);
+        }
+        std::printf("  %zu failures\n", failures - before);
+    }
+    return failures != 0;
+}
@@ -0,0 +1,150 @@
+// Micro-benchmark of the runtime's number conversions against iostream and the C library.
+// g++ -std=c++20 -O2 bench/number-conversion.cpp src/runtime/number.cpp -o bin/number-bench
+
+#include "../src/runtime/number.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static constexpr size_t valueCount = 1 << 20;
+
+// Keeps the compiler from dropping the benchmarked work
+static volatile uint64_t sink;
+
+template<typename F>
+static void measure(const char *name, F &&body){
+    auto start = std::chrono::steady_clock::now();
+    uint64_t checksum = body();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sink = checksum;
+    std::printf("%-28s %8.2f ns/value\n", name, seconds * 1e9 / valueCount);
+}
+
+int main(){
+    std::mt19937_64 random(42);
+    std::vector<int64_t> ints(valueCount);
+    std::vector<double> floats(valueCount);
+    std::vector<std::string> intTexts(valueCount);
+    std::vector<std::string> floatTexts(valueCount);
+    for(size_t i = 0; i < valueCount; i++){
+        // Mostly short numbers, like counters and indices read from input
+        ints[i] = static_cast<int64_t>(random() >> (random() % 64)) * (i % 2 ? 1 : -1);
+        floats[i] = std::uniform_real_distribution<double>(-1e6, 1e6)(random);
+        char buffer[maxFloatLength];
+        intTexts[i] = std::string(buffer, writeInt(buffer, ints[i]));
+        floatTexts[i] = std::string(buffer, writeFloat(buffer, floats[i]));
+    }
+
+    std::puts("int parsing");
+    measure("parseInt", [&]{
+        uint64_t sum = 0;
+        for(const std::string &text : intTexts){
+            sum += *parseInt(text);
+        }
+        return sum;
+    });
+    measure("strtoll", [&]{
+        uint64_t sum = 0;
+        for(const std::string &text : intTexts){
+            sum += std::strtoll(text.c_str(), nullptr, 10);
+        }
+        return sum;
+    });
+    measure("istringstream", [&]{
+        uint64_t sum = 0;
+        for(const std::string &text : intTexts){
+            std::istringstream in(text);
+            int64_t value;
+            in >> value;
+            sum += value;
+        }
+        return sum;
+    });
+
+    std::puts("int printing");
+    measure("writeInt", [&]{
+        uint64_t sum = 0;
+        char buffer[maxIntLength];
+        for(int64_t value : ints){
+            sum += writeInt(buffer, value) - buffer;
+        }
+        return sum;
+    });
+    measure("snprintf", [&]{
+        uint64_t sum = 0;
+        char buffer[32];
+        for(int64_t value : ints){
+            sum += std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+        }
+        return sum;
+    });
+    measure("ostringstream", [&]{
+        uint64_t sum = 0;
+        for(int64_t value : ints){
+            std::ostringstream out;
+            out << value;
+            sum += out.str().length();
+        }
+        return sum;
+    });
+
+    std::puts("float parsing");
+    measure("parseFloat", [&]{
+        double sum = 0;
+        for(const std::string &text : floatTexts){
+            sum += *parseFloat(text);
+        }
+        return static_cast<uint64_t>(sum);
+    });
+    measure("strtod", [&]{
+        double sum = 0;
+        for(const std::string &text : floatTexts){
+            sum += std::strtod(text.c_str(), nullptr);
+        }
+        return static_cast<uint64_t>(sum);
+    });
+    measure("istringstream", [&]{
+        double sum = 0;
+        for(const std::string &text : floatTexts){
+            std::istringstream in(text);
+            double value;
+            in >> value;
+            sum += value;
+        }
+        return static_cast<uint64_t>(sum);
+    });
+
+    std::puts("float printing, shortest round trip");
+    measure("writeFloat", [&]{
+        uint64_t sum = 0;
+        char buffer[maxFloatLength];
+        for(double value : floats){
+            sum += writeFloat(buffer, value) - buffer;
+        }
+        return sum;
+    });
+    measure("snprintf %.17g", [&]{
+        uint64_t sum = 0;
+        char buffer[32];
+        for(double value : floats){
+            sum += std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        }
+        return sum;
+    });
+    measure("ostringstream", [&]{
+        uint64_t sum = 0;
+        for(double value : floats){
+            std::ostringstream out;
+            out.precision(17);
+            out << value;
+            sum += out.str().length();
+        }
+        return sum;
+    });
+}
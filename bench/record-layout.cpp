@@ -0,0 +1,127 @@
+// Micro-benchmark of shaped records against records holding a hash map of their fields:
+// bytes allocated per instance and the cost of a field read.
+// g++ -std=c++20 -O2 bench/record-layout.cpp src/runtime/shape.cpp -o bin/record-bench
+
+#include "../src/runtime/shape.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static constexpr size_t recordCount = 1 << 16;
+static constexpr size_t readRounds = 64;
+
+// Every allocation is counted, so the size of a record includes its map nodes and buckets
+static size_t allocatedBytes = 0;
+
+void* operator new(size_t size){
+    allocatedBytes += size;
+    if(void *memory = std::malloc(size)){
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+// The layout shapes replace, one map per instance
+struct MapRecord {
+    std::unordered_map<std::string, Element> fields;
+};
+
+static volatile int64_t sink;
+
+template<typename F>
+static void measure(const char *name, size_t operations, F &&body){
+    auto start = std::chrono::steady_clock::now();
+    sink = body();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-32s %8.2f ns/read\n", name, seconds * 1e9 / operations);
+}
+
+int main(){
+    const std::vector<std::string> fields = { "x", "y", "z", "width", "height", "depth" };
+    Shape *shape = Shape::forFields(fields);
+
+    size_t before = allocatedBytes;
+    std::vector<Record*> records;
+    records.reserve(recordCount);
+    size_t vectorBytes = allocatedBytes - before;
+    for(size_t i = 0; i < recordCount; i++){
+        Record *record = Record::make(shape);
+        for(uint32_t slot = 0; slot < fields.size(); slot++){
+            record->set(slot, static_cast<int64_t>(i + slot));
+        }
+        records.push_back(record);
+    }
+    size_t shapedBytes = allocatedBytes - before - vectorBytes;
+
+    before = allocatedBytes;
+    std::vector<MapRecord*> mapRecords;
+    mapRecords.reserve(recordCount);
+    vectorBytes = allocatedBytes - before;
+    for(size_t i = 0; i < recordCount; i++){
+        MapRecord *record = new MapRecord();
+        for(size_t slot = 0; slot < fields.size(); slot++){
+            record->fields.emplace(fields[slot], static_cast<int64_t>(i + slot));
+        }
+        mapRecords.push_back(record);
+    }
+    size_t mapBytes = allocatedBytes - before - vectorBytes;
+
+    std::printf("record with %zu int fields\n", fields.size());
+    std::printf("%-32s %8zu bytes\n", "shaped", shapedBytes / recordCount);
+    std::printf("%-32s %8zu bytes\n", "hash map", mapBytes / recordCount);
+
+    // Reads `record.height` like a member access site would
+    size_t reads = recordCount * readRounds;
+    FieldCacheTable table;
+    table.addSite("height");
+    measure("shaped, inline cached slot", reads, [&]{
+        int64_t sum = 0;
+        for(size_t round = 0; round < readRounds; round++){
+            for(Record *record : records){
+                sum += std::get<int64_t>(loadField(table, 0, *record));
+            }
+        }
+        return sum;
+    });
+    measure("shaped, lookup by name", reads, [&]{
+        int64_t sum = 0;
+        for(size_t round = 0; round < readRounds; round++){
+            for(Record *record : records){
+                sum += std::get<int64_t>(record->get("height"));
+            }
+        }
+        return sum;
+    });
+    const std::string height = "height";
+    measure("hash map", reads, [&]{
+        int64_t sum = 0;
+        for(size_t round = 0; round < readRounds; round++){
+            for(MapRecord *record : mapRecords){
+                sum += std::get<int64_t>(record->fields.find(height)->second);
+            }
+        }
+        return sum;
+    });
+    table.report(std::cout);
+
+    for(Record *record : records){
+        drop(record);
+    }
+    for(MapRecord *record : mapRecords){
+        delete record;
+    }
+}
@@ -0,0 +1,149 @@
+// Checks normalizeSlice against Python's slice semantics for every start, stop and step
+// around the bounds of short sequences, then takes random chains of slices of slices and
+// compares them with slicing copies. Also checks that compact() copies a small slice out of
+// a large buffer only once it holds the last reference to it
+// g++ -std=c++20 -O2 bench/slice-views.cpp -o bin/slice-views
+
+#include "../src/runtime/slice.hpp"
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+static size_t failures = 0;
+
+static void check(bool ok, const char *what, size_t size){
+    if(!ok){
+        failures++;
+        std::printf("FAILED %s, %zu elements\n", what, size);
+    }
+}
+
+// Positions selected by `[start : stop : step]`, following CPython's PySlice_AdjustIndices
+static std::vector<long long> referenceIndices(long long n, std::optional<long long> start, std::optional<long long> stop, long long step){
+    auto adjust = [n, step](std::optional<long long> pos, long long missing){
+        if(!pos){
+            return missing;
+        }
+        long long value = *pos < 0 ? *pos + n : *pos;
+        if(value < 0){
+            return step < 0 ? -1LL : 0LL;
+        }
+        if(value >= n){
+            return step < 0 ? n - 1 : n;
+        }
+        return value;
+    };
+    long long first = adjust(start, step < 0 ? n - 1 : 0);
+    long long last = adjust(stop, step < 0 ? -1 : n);
+    std::vector<long long> indices;
+    for(long long i = first; step > 0 ? i < last : i > last; i += step){
+        indices.push_back(i);
+    }
+    return indices;
+}
+
+static std::vector<long long> boundsIndices(SliceBounds bounds){
+    std::vector<long long> indices;
+    for(size_t k = 0; k < bounds.length; k++){
+        indices.push_back(static_cast<long long>(bounds.offset) + static_cast<long long>(k) * bounds.stride);
+    }
+    return indices;
+}
+
+static void checkBounds(){
+    for(long long n = 0; n <= 9; n++){
+        std::vector<std::optional<long long>> positions = { std::nullopt };
+        for(long long pos = -n - 3; pos <= n + 3; pos++){
+            positions.push_back(pos);
+        }
+        for(long long step : { -4, -3, -2, -1, 1, 2, 3, 4 }){
+            for(std::optional<long long> start : positions){
+                for(std::optional<long long> stop : positions){
+                    std::vector<long long> expected = referenceIndices(n, start, stop, step);
+                    check(boundsIndices(normalizeSlice(n, start, stop, step)) == expected, "normalizeSlice", n);
+                }
+            }
+        }
+        bool threw = false;
+        try {
+            normalizeSlice(n, std::nullopt, std::nullopt, 0);
+        } catch(const RuntimeError&){
+            threw = true;
+        }
+        check(threw, "normalizeSlice rejects a zero step", n);
+    }
+}
+
+// The copy is sliced the slow way alongside the view, both must hold the same elements
+static void checkChains(std::mt19937_64 &random, size_t size){
+    std::string text(size, '\0');
+    for(char &c : text){
+        c = 'a' + random() % 26;
+    }
+    StringSlice slice = makeStringSlice(text);
+    std::vector<char> copy(text.begin(), text.end());
+    for(size_t depth = 0; depth < 6; depth++){
+        long long n = copy.size();
+        auto position = [&random, n]() -> std::optional<long long> {
+            if(random() % 4 == 0){
+                return std::nullopt;
+            }
+            return static_cast<long long>(random() % (2 * n + 5)) - n - 2;
+        };
+        std::optional<long long> start = position();
+        std::optional<long long> stop = position();
+        long long step = random() % 3 ? 1 : static_cast<long long>(random() % 7) - 3;
+        step = step == 0 ? -1 : step;
+        slice = slice.slice(start, stop, step);
+        std::vector<char> next;
+        for(long long i : referenceIndices(n, start, stop, step)){
+            next.push_back(copy[i]);
+        }
+        copy = next;
+
+        bool ok = slice.size() == copy.size() && slice.materialize() == copy;
+        for(size_t i = 0; ok && i < copy.size(); i++){
+            ok = slice[i] == copy[i];
+        }
+        check(ok, "slice of a slice", size);
+        if(slice.contiguous()){
+            check(slice.view() == std::string_view(copy.data(), copy.size()), "view of a contiguous slice", size);
+        }
+    }
+}
+
+static void checkCompact(){
+    std::string text(sliceRetainMinimum * 2, 'x');
+    text[100] = 'y';
+    StringSlice whole = makeStringSlice(text);
+    StringSlice part = whole.slice(100, 110);
+
+    size_t before = Object::allocations;
+    StringSlice shared = part.compact();
+    check(Object::allocations == before && shared.view() == part.view(), "compact() keeps a buffer still referenced elsewhere", text.size());
+
+    whole = makeStringSlice("");
+    shared = makeStringSlice("");
+    before = Object::allocations;
+    StringSlice copied = part.compact();
+    check(Object::allocations == before + 1 && copied.view() == text.substr(100, 10), "compact() copies a small slice out of its last reference", text.size());
+
+    StringSlice large = makeStringSlice(text).slice(0, text.size() / 2);
+    before = Object::allocations;
+    StringSlice kept = large.compact();
+    check(Object::allocations == before && kept.size() == text.size() / 2, "compact() keeps a large slice in place", text.size());
+}
+
+int main(){
+    checkBounds();
+    std::mt19937_64 random(42);
+    for(size_t size : { 0, 1, 2, 5, 16, 100, 1000 }){
+        for(size_t round = 0; round < 200; round++){
+            checkChains(random, size);
+        }
+    }
+    checkCompact();
+    std::printf("%zu failures\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,152 @@
+// Checks that sorted() on boxed elements and sortBy keep equal elements in their original
+// order, for inputs below and above the parallel sort threshold, and that strings, nested
+// arrays and mixed numbers are ordered as documented in array.cpp. Also checks that
+// String::sorted() orders the bytes of inline, flat and rope strings
+// g++ -std=c++20 -O2 bench/sort-stability.cpp src/runtime/array.cpp src/runtime/sort.cpp src/runtime/kernels.cpp src/runtime/string.cpp src/runtime/thread-pool.cpp -pthread -o bin/sort-stability
+
+#include "../src/runtime/array.hpp"
+#include "../src/runtime/sort.hpp"
+#include "../src/runtime/string.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+
+static size_t failures = 0;
+
+static void check(bool ok, const char *what, size_t size){
+    if(!ok){
+        failures++;
+        std::printf("FAILED %s, %zu elements\n", what, size);
+    }
+}
+
+// Short random words from a small alphabet, so many of them are equal
+static std::string randomWord(std::mt19937_64 &random){
+    std::string word(1 + random() % 3, 'a');
+    for(char &c : word){
+        c = 'a' + random() % 3;
+    }
+    return word;
+}
+
+static void checkStrings(std::mt19937_64 &random, size_t size){
+    Array array;
+    std::vector<StringData*> objects;
+    for(size_t i = 0; i < size; i++){
+        StringData *text = new StringData(randomWord(random));
+        objects.push_back(text);
+        array.push(text);
+        drop(text);
+    }
+    Array result = array.sorted();
+    auto position = [&objects](const Element &value){
+        return std::find(objects.begin(), objects.end(), std::get<Object*>(value)) - objects.begin();
+    };
+    bool ordered = result.size() == size;
+    bool stable = true;
+    for(size_t i = 1; ordered && i < size; i++){
+        const std::string &prev = static_cast<StringData*>(std::get<Object*>(result.get(i - 1)))->flat;
+        const std::string &cur = static_cast<StringData*>(std::get<Object*>(result.get(i)))->flat;
+        ordered = prev <= cur;
+        if(prev == cur && size <= 1 << 12){
+            stable = stable && position(result.get(i - 1)) < position(result.get(i));
+        }
+    }
+    check(ordered, "sorted() orders strings by their text", size);
+    check(stable, "sorted() keeps equal strings in order", size);
+}
+
+// Elements are their original positions, the key is shared by many of them
+static void checkSortBy(std::mt19937_64 &random, size_t size){
+    Array array;
+    for(size_t i = 0; i < size; i++){
+        array.push(int64_t(i));
+    }
+    std::vector<int64_t> keys(size);
+    for(int64_t &key : keys){
+        key = random() % 16;
+    }
+    Array result = array.sortedBy([&keys](const Element &value) -> Element {
+        return keys[std::get<int64_t>(value)];
+    });
+    bool ok = result.size() == size;
+    for(size_t i = 1; ok && i < size; i++){
+        int64_t prev = std::get<int64_t>(result.get(i - 1));
+        int64_t cur = std::get<int64_t>(result.get(i));
+        ok = keys[prev] < keys[cur] || (keys[prev] == keys[cur] && prev < cur);
+    }
+    check(ok, "sortBy is stable", size);
+}
+
+// Equal ints and floats keep their order too, the int comes first
+static void checkMixedNumbers(){
+    Array array;
+    for(Element value : std::vector<Element>{ 2.5, int64_t(3), true, -0.0, int64_t(0), NAN, -INFINITY, int64_t(2), 0.0, false }){
+        array.push(value);
+    }
+    std::vector<Element> expected = { -INFINITY, int64_t(0), -0.0, 0.0, int64_t(2), 2.5, int64_t(3), NAN, false, true };
+    Array result = array.sorted();
+    bool ok = result.size() == expected.size();
+    for(size_t i = 0; ok && i < expected.size(); i++){
+        Element value = result.get(i);
+        ok = value.index() == expected[i].index() && (std::holds_alternative<double>(value) ?
+            std::bit_cast<uint64_t>(std::get<double>(value)) == std::bit_cast<uint64_t>(std::get<double>(expected[i])) :
+            value == expected[i]);
+    }
+    check(ok, "sorted() orders mixed numbers by value", expected.size());
+}
+
+// Bytes above 0x7F sort after ASCII, like in string comparisons
+static void checkStringBytes(std::mt19937_64 &random, size_t size){
+    std::string text(size, '\0');
+    for(char &c : text){
+        c = static_cast<char>(random() % 2 ? 'a' + random() % 26 : random());
+    }
+    std::string half = text.substr(0, size / 2);
+    String str = size >= ropeMinimum ? String::concat(String(half), String(text.substr(size / 2))) : String(text);
+    std::string expected = text;
+    std::sort(expected.begin(), expected.end(), [](char a, char b){
+        return static_cast<unsigned char>(a) < static_cast<unsigned char>(b);
+    });
+    String result = str.sorted();
+    check(result.view() == expected && str.view() == text, "String::sorted() orders bytes as unsigned", size);
+}
+
+static void checkNestedArrays(){
+    Array array;
+    for(std::vector<int64_t> elements : std::vector<std::vector<int64_t>>{ { 1, 2 }, { 1 }, { 0, 5 }, { 1, 2, 0 } }){
+        Array *inner = new Array(elements);
+        array.push(inner);
+        drop(inner);
+    }
+    std::vector<std::vector<int64_t>> expected = { { 0, 5 }, { 1 }, { 1, 2 }, { 1, 2, 0 } };
+    Array result = array.sorted();
+    bool ok = true;
+    for(size_t i = 0; i < expected.size(); i++){
+        std::span<const int64_t> inner = static_cast<Array*>(std::get<Object*>(result.get(i)))->ints();
+        ok = ok && std::vector<int64_t>(inner.begin(), inner.end()) == expected[i];
+    }
+    check(ok, "sorted() orders arrays lexicographically", expected.size());
+}
+
+int main(){
+    // Several workers even on one core, so the parallel merge runs
+    ThreadPool::setGlobalThreads(4);
+    std::mt19937_64 random(42);
+    for(size_t size : { 0, 1, 2, 10, 100, 1000, 1 << 12 }){
+        checkStrings(random, size);
+        checkSortBy(random, size);
+        checkStringBytes(random, size);
+    }
+    // Above parallelSortMinimum, the chunks are merged from several threads
+    checkStrings(random, parallelSortMinimum * 2);
+    checkSortBy(random, parallelSortMinimum * 2 + 17);
+    checkMixedNumbers();
+    checkNestedArrays();
+    std::printf("%zu failures\n", failures);
+    return failures != 0;
+}
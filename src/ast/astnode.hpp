@@ -2,16 +2,18 @@
 
 #include "../include/utils.hpp"
 #include "../token/token.hpp"
+#include "../runtime/integer.hpp"
 
 #include <variant>
+#include <optional>
 
 enum class NodeType {
     // Building blocks
     expression, block,
     // Primaries (*not exhaustive)
-    identifier, intLiteral, floatLiteral, stringLiteral, formatString, stringTemplate,
+    identifier, intLiteral, floatLiteral, boolLiteral, stringLiteral, formatString, stringTemplate, concatenation,
     // Binary Arithmetic Operation
-    addition, subtraction, multiplication, division, exponentiation,
+    addition, subtraction, multiplication, division, exponentiation, root,
     // Unary Operation
     plusSign, minusSign,
     assignment,
@@ -20,11 +22,11 @@ enum class NodeType {
     // Comparisan
     equality, inequality, lessThan, greaterThan, lessEqual, greaterEqual,
     // Function
-    function, fnParamList, callArgsList, call,
+    function, fnParamList, callArgsList, call, tailCall,
     // Statement-like
     ifExpr, forExpr,
     memberAccess,
-    arrayLiteral, arrayAccess, arraySubscript,
+    arrayLiteral, arrayAccess, arraySubscript, sliceSubscript,
     tuplePattern,
     tupleExpression,
     typedIdentifier,
@@ -36,14 +38,17 @@ static std::unordered_map<NodeType, const char*> nodeTypeNameLookup = {
     { NodeType::typedIdentifier, "typedIdentifier" },
     { NodeType::intLiteral, "intLiteral" },
     { NodeType::floatLiteral, "floatLiteral" },
+    { NodeType::boolLiteral, "boolLiteral" },
     { NodeType::stringLiteral, "stringLiteral" },
     { NodeType::stringTemplate, "stringTemplate" },
     { NodeType::formatString, "formatString" },
+    { NodeType::concatenation, "concatenation" },
     { NodeType::addition, "addition" },
     { NodeType::subtraction, "subtraction" },
     { NodeType::multiplication, "multiplication" },
     { NodeType::division, "division" },
     { NodeType::exponentiation, "exponentiation" },
+    { NodeType::root, "root" },
     { NodeType::plusSign, "plusSign" },
     { NodeType::minusSign, "minusSign" },
     { NodeType::assignment, "assignment" },
@@ -62,16 +67,43 @@ static std::unordered_map<NodeType, const char*> nodeTypeNameLookup = {
     { NodeType::block, "block" },
     { NodeType::ifExpr, "ifExpr" },
     { NodeType::call, "call" },
+    { NodeType::tailCall, "tailCall" },
     { NodeType::callArgsList, "callArgsList" },
     { NodeType::forExpr, "forExpr" },
     { NodeType::arrayLiteral, "arrayLiteral" },
     { NodeType::arrayAccess, "arrayAccess" },
     { NodeType::arraySubscript, "arraySubscript" },
+    { NodeType::sliceSubscript, "sliceSubscript" },
     { NodeType::tuplePattern, "tuplePattern" },
     { NodeType::tupleExpression, "tupleExpression" },
 
 };
 
+// Static type of an expression as far as the optimizer could infer it
+enum class ValueType {
+    unknown,
+    unresolved, // Only used while a recursive function's result is being inferred
+    integer,
+    floating,
+    boolean,
+    string,
+    array,
+    tuple,
+    function,
+};
+
+static std::unordered_map<ValueType, const char*> valueTypeNameLookup = {
+    { ValueType::unknown, "unknown" },
+    { ValueType::unresolved, "unresolved" },
+    { ValueType::integer, "int" },
+    { ValueType::floating, "float" },
+    { ValueType::boolean, "bool" },
+    { ValueType::string, "string" },
+    { ValueType::array, "array" },
+    { ValueType::tuple, "tuple" },
+    { ValueType::function, "function" },
+};
+
 class AstNode;
 
 struct BinaryOperation {
@@ -91,27 +123,52 @@ struct VariableDeclaration {
 
 struct IntLiteral {
     std::string value;
+    std::optional<long long> number; // Empty if out of the 64-bit range
+    Integer integer; // Parsed once by the parser, a bigint if out of range
 };
 
 struct StringLiteral {
     std::string value;
 };
 
+// Parsed from the text after ':' in a template, [<|>][width][.precision]
+struct FormatSpec {
+    char align = 0; // 0 means the default, right for numbers and left for strings
+    int width = 0;
+    int precision = -1;
+};
+
 struct StringTemplate {
     AstNode *value;
-    AstNode *format;
+    AstNode *format; // StringLiteral holding the raw specification
+    FormatSpec spec;
 };
 
+// Once compiled by the optimizer, children alternate StringLiteral and StringTemplate,
+// starting and ending with a (possibly empty) StringLiteral
 struct FormatString{
     std::vector<AstNode*> children;
+    size_t literalLength = 0;
+};
+
+// A chain of string additions, concatenated into one buffer sized from all the parts
+struct Concatenation {
+    std::vector<AstNode*> parts;
 };
 
 struct FloatLiteral {
     std::string value;
+    std::optional<double> number;
+};
+
+struct BoolLiteral {
+    bool value;
 };
 
 struct Identifier {
     std::string name;
+    bool lastUse = false; // No later use of this binding, the runtime may move its value
+    int inlineCache = -1; // Field of a member access: slot of the site's field load cache
 };
 
 struct TypedIdentifier {
@@ -127,10 +184,20 @@ struct Function {
     AstNode *paramList;
     AstNode *name;
     AstNode *block;
+    bool memoized = false;
+    size_t memoCapacity = 0; // Entries the memo cache holds, see --memo-size
+    // A nested function is a closure. Bindings are immutable, so its environment is a flat
+    // copy of the enclosing functions' bindings it reads, `captures`, taken when it is created
+    std::vector<std::string> captures;
+    bool local = false; // The closure never outlives the enclosing call, its environment lives in the frame
 };
 
 struct Block {
     std::vector<AstNode*> expressions;
+    // Filled when some expressions are worth running as tasks, see Optimizer::scheduleBindings.
+    // dependencies[i] lists the earlier expressions expression i must wait for
+    std::vector<std::vector<size_t>> dependencies;
+    std::vector<bool> spawn;
 };
 
 struct IfExpr {
@@ -145,15 +212,41 @@ struct ForExpr {
     AstNode *pattern;
     AstNode *expr;
     AstNode *block;
+    bool lazy = false; // Consumed element by element by a reduction, no array is built
+    bool parallel = false; // Iterations are independent and may run on several threads
+    size_t cost = 0; // Estimated work of one iteration, used to size parallel chunks
+    bool local = false; // The array built never outlives the enclosing call, allocated in the call frame
+    // Loop invariant bindings taken out of the body, evaluated once before the first
+    // iteration. None of them run when the sequence is empty
+    std::vector<AstNode*> hoisted;
 };
 
 struct ArrayLiteral {
     std::vector<AstNode*> elements;
+    // Int, float or bool when every element is known to have that type, the array is then
+    // built straight into unboxed storage
+    ValueType elementType = ValueType::unknown;
+    bool local = false; // Never outlives the enclosing call, allocated in the call frame
+};
+
+// Where one name of a compiled destructuring gets its value from
+struct PatternLoad {
+    AstNode *target; // Identifier or TypedIdentifier leaf of the pattern
+    size_t value; // Index into Assignment::values
+    std::vector<uint32_t> path; // Element index at each tuple level of that value, empty binds it whole
 };
 
 struct Assignment {
     AstNode *lhs;
     AstNode *rhs;
+    // Filled by Optimizer::compilePatterns. `values` are the right-hand side expressions to
+    // evaluate, in order, and `loads` bind every name of the pattern from them, so the tuples
+    // spelled out on both sides are never built. shapes[i] is the tuple shape value i must
+    // have, arities in preorder with 0 for a name, checked once together with the declared
+    // types before any name is bound. It is empty for a value bound whole
+    std::vector<AstNode*> values;
+    std::vector<PatternLoad> loads;
+    std::vector<std::vector<uint32_t>> shapes;
 };
 
 struct TuplePattern {
@@ -162,16 +255,26 @@ struct TuplePattern {
 
 struct TupleExpression {
     std::vector<AstNode*> children;
+    bool parallel = false; // Elements are pure and expensive enough to be evaluated as tasks
+    bool local = false; // Never outlives the enclosing call, allocated in the call frame
 };
 
 struct CallArgsList {
     std::vector<AstNode*> args;
+    int inlineCache = -1; // Slot of the call site's inline cache, method calls only
 };
 
 struct ArraySubscript {
     AstNode *index;
 };
 
+// `[start : stop : step]`, every part is optional
+struct SliceSubscript {
+    AstNode *start = nullptr;
+    AstNode *stop = nullptr;
+    AstNode *step = nullptr;
+};
+
 struct AstNode {
     NodeType type;
     std::variant<
@@ -179,8 +282,10 @@ struct AstNode {
         TypedIdentifier,
         IntLiteral,
         FloatLiteral,
+        BoolLiteral,
         StringLiteral,
         FormatString,
+        Concatenation,
         StringTemplate,
         BinaryOperation,
         UnaryOperation,
@@ -189,13 +294,17 @@ struct AstNode {
         FnParamList,
         Block,
         IfExpr,
+        ForExpr,
         CallArgsList,
         ArrayLiteral,
         Assignment,
         TuplePattern,
         TupleExpression,
-        ArraySubscript
+        ArraySubscript,
+        SliceSubscript
     > data;
+    // Operations whose operand types are known run their specialized version, without tag checks
+    ValueType valueType = ValueType::unknown;
     AstNode(){}
     AstNode(NodeType type)
       : type(type) 
@@ -218,4 +327,8 @@ static const char* getNodeTypeName(NodeType type){
         throw SystemError("getNodeTypeName not implemented", __FILE__, __LINE__);
     }
     return nodeTypeNameLookup[type];
+}
+
+static const char* getValueTypeName(ValueType type){
+    return valueTypeNameLookup[type];
 }
\ No newline at end of file
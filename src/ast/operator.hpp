@@ -14,6 +14,7 @@ static std::unordered_map<NodeType, OperatorInfo> operatorInfoLookup = {
     { NodeType::multiplication, { 20, 21, true, false } },
     { NodeType::division, { 20, 21, true, false } },
     { NodeType::exponentiation, { 30, 31, true, false } },
+    { NodeType::root, { 30, 31, true, false } },
     { NodeType::plusSign, { 100, 101, false, true } },
     { NodeType::minusSign, { 100, 101, false, true } },
     //{ NodeType::assignment, { 1, 2, true, false } },
@@ -28,7 +29,8 @@ static std::unordered_map<NodeType, OperatorInfo> operatorInfoLookup = {
     { NodeType::greaterEqual, { 5, 6, true, false } },
     { NodeType::memberAccess, { 200, 201, true, false } },
     { NodeType::arrayAccess, { 150, 1000, true, false } },
-    { NodeType::call, {150, 1000, true, false } }
+    { NodeType::call, {150, 1000, true, false } },
+    { NodeType::tailCall, {150, 1000, true, false } }
 };
 
 static bool isOperator(NodeType type){
@@ -12,6 +12,9 @@ static void printAst(AstNode *node, int level = 0){
         return;
     }
     std::cout << getNodeTypeName(node->type);
+    if(node->valueType != ValueType::unknown){
+        std::cout << " : " << getValueTypeName(node->valueType);
+    }
     if(isOperator(node->type)){
         std::cout << std::endl;
         if(isBinaryOperator(node->type)){
@@ -24,7 +27,14 @@ static void printAst(AstNode *node, int level = 0){
     } 
     switch(node->type){
     case NodeType::identifier:
-        std::cout << " | " << node->as<Identifier>().name << std::endl; 
+        std::cout << " | " << node->as<Identifier>().name;
+        if(node->as<Identifier>().lastUse){
+            std::cout << " | last use";
+        }
+        if(node->as<Identifier>().inlineCache >= 0){
+            std::cout << " | inline cache " << node->as<Identifier>().inlineCache;
+        }
+        std::cout << std::endl;
     break;
     case NodeType::typedIdentifier:
         std::cout << " | ";
@@ -37,6 +47,9 @@ static void printAst(AstNode *node, int level = 0){
     case NodeType::floatLiteral:
         std::cout << " | " << node->as<FloatLiteral>().value << std::endl;
     break;
+    case NodeType::boolLiteral:
+        std::cout << " | " << (node->as<BoolLiteral>().value ? "true" : "false") << std::endl;
+    break;
     case NodeType::stringLiteral:
         std::cout << " | " << node->as<StringLiteral>().value << std::endl;
     break;
@@ -46,6 +59,12 @@ static void printAst(AstNode *node, int level = 0){
             printAst(child, level + 1);
         }
     break;
+    case NodeType::concatenation:
+        std::cout << std::endl;
+        for(AstNode *part : node->as<Concatenation>().parts){
+            printAst(part, level + 1);
+        }
+    break;
     case NodeType::stringTemplate:
         std::cout << std::endl;
         printAst(node->as<StringTemplate>().value, level + 1);
@@ -58,12 +77,29 @@ static void printAst(AstNode *node, int level = 0){
         }
     break;
     case NodeType::function:
+        if(node->as<Function>().memoized){
+            std::cout << " | memoized " << node->as<Function>().memoCapacity;
+        }
+        if(node->as<Function>().local){
+            std::cout << " | local";
+        }
+        for(size_t i = 0; i < node->as<Function>().captures.size(); i++){
+            std::cout << (i == 0 ? " | captures " : ", ") << node->as<Function>().captures[i];
+        }
         std::cout << std::endl;
         printAst(node->as<Function>().name, level + 1);
         printAst(node->as<Function>().paramList, level + 1);
         printAst(node->as<Function>().block, level + 1);
     break;
     case NodeType::block:
+        if(!node->as<Block>().spawn.empty()){
+            std::cout << " | tasks";
+            for(size_t i = 0; i < node->as<Block>().spawn.size(); i++){
+                if(node->as<Block>().spawn[i]){
+                    std::cout << " " << i;
+                }
+            }
+        }
          std::cout << std::endl;
         for(AstNode *expr : node->as<Block>().expressions){
             printAst(expr, level + 1);
@@ -79,13 +115,40 @@ static void printAst(AstNode *node, int level = 0){
         }
         printAst(node->as<IfExpr>().elseBlock, level + 1);
     break;
+    case NodeType::forExpr:
+        if(node->as<ForExpr>().lazy){
+            std::cout << " | lazy";
+        }
+        if(node->as<ForExpr>().parallel){
+            std::cout << " | parallel, cost " << node->as<ForExpr>().cost;
+        }
+        if(node->as<ForExpr>().local){
+            std::cout << " | local";
+        }
+        std::cout << std::endl;
+        printAst(node->as<ForExpr>().pattern, level + 1);
+        printAst(node->as<ForExpr>().expr, level + 1);
+        for(AstNode *binding : node->as<ForExpr>().hoisted){
+            printAst(binding, level + 1);
+        }
+        printAst(node->as<ForExpr>().block, level + 1);
+    break;
     case NodeType::callArgsList:
+        if(node->as<CallArgsList>().inlineCache >= 0){
+            std::cout << " | inline cache " << node->as<CallArgsList>().inlineCache;
+        }
         std::cout << std::endl;
         for(AstNode *args : node->as<CallArgsList>().args){
             printAst(args, level + 1);
         }
     break;
     case NodeType::arrayLiteral:
+        if(node->as<ArrayLiteral>().elementType != ValueType::unknown){
+            std::cout << " | of " << getValueTypeName(node->as<ArrayLiteral>().elementType);
+        }
+        if(node->as<ArrayLiteral>().local){
+            std::cout << " | local";
+        }
         std::cout << std::endl;
         for(AstNode *elem : node->as<ArrayLiteral>().elements){
             printAst(elem, level + 1);
@@ -95,7 +158,26 @@ static void printAst(AstNode *node, int level = 0){
         std::cout << std::endl;
         printAst(node->as<ArraySubscript>().index, level + 1);
     break;
+    case NodeType::sliceSubscript:
+        std::cout << std::endl;
+        printAst(node->as<SliceSubscript>().start, level + 1);
+        printAst(node->as<SliceSubscript>().stop, level + 1);
+        printAst(node->as<SliceSubscript>().step, level + 1);
+    break;
     case NodeType::assignment:
+        for(size_t i = 0; i < node->as<Assignment>().loads.size(); i++){
+            const PatternLoad &load = node->as<Assignment>().loads[i];
+            std::cout << (i == 0 ? " | " : ", ") << (load.target->type == NodeType::identifier ?
+                load.target->as<Identifier>().name : load.target->as<TypedIdentifier>().name) << " <- " << load.value;
+            for(uint32_t index : load.path){
+                std::cout << "." << index;
+            }
+        }
+        for(size_t i = 0; i < node->as<Assignment>().shapes.size(); i++){
+            if(!node->as<Assignment>().shapes[i].empty()){
+                std::cout << " | check " << i;
+            }
+        }
         std::cout << std::endl;
         printAst(node->as<Assignment>().lhs, level + 1);
         printAst(node->as<Assignment>().rhs, level + 1);
@@ -107,6 +189,12 @@ static void printAst(AstNode *node, int level = 0){
         }
     break;
     case NodeType::tupleExpression:
+        if(node->as<TupleExpression>().parallel){
+            std::cout << " | parallel";
+        }
+        if(node->as<TupleExpression>().local){
+            std::cout << " | local";
+        }
         std::cout << std::endl;
         for(AstNode *child : node->as<TupleExpression>().children){
             printAst(child, level + 1);
@@ -1,6 +1,18 @@
 #pragma once
 
+#include "optimizer.hpp"
+
 #include <string>
 
-void repl();
-void script(const std::string&);
\ No newline at end of file
+struct InterpreterOptions {
+    OptimizerOptions optimizer;
+    bool dumpAst = false;
+    size_t threads = 0; // Thread pool size for parallel loops, 0 uses every hardware thread
+    bool jit = false; // Compile hot functions to native code, x86-64 Linux only. Nothing calls them yet
+    bool inlineReport = false; // List the calls the optimizer inlined
+    bool escapeReport = false; // Share of allocation sites the escape analysis keeps off the heap
+    bool cacheReport = false; // State and hit rate of every method call and field load cache
+};
+
+void repl(const InterpreterOptions&);
+void script(const std::string&, const InterpreterOptions&);
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "utils.hpp"
+#include "../ast/astnode.hpp"
+
+#include <iomanip>
+#include <ostream>
+#include <unordered_set>
+
+using TypeEnv = std::unordered_map<std::string, ValueType>;
+
+// Allocation sites of a program, and how many of them the escape analysis moved to the call frame
+struct EscapeStats {
+    size_t sites = 0;
+    size_t local = 0;
+
+    void report(std::ostream &os) const {
+        os << local << " of " << sites << " allocation sites stay off the heap (" << std::fixed << std::setprecision(1)
+           << (sites ? 100.0 * local / sites : 0.0) << "%)" << std::endl;
+    }
+};
+
+struct OptimizerOptions {
+    bool accumulate = false;
+    bool memoize = false;
+    bool inlining = true;
+    bool wholeProgram = false; // The input is the entire program, unreachable definitions may go
+    bool dumpCse = false; // Print the AST right after subexpressions are shared and invariants hoisted
+    size_t memoCacheSize = 4096; // Entries each memoized function's cache holds
+};
+
+class Optimizer {
+private:
+    OptimizerOptions options;
+    std::vector<AstNode*> functions; // Every named function definition of the tree being optimized
+    std::unordered_map<AstNode*, AstNode*> targets; // Identifier to the function definition it names in its scope
+    std::unordered_map<std::string, AstNode*> globalFunctions; // Top-level functions of earlier inputs, for the REPL
+    std::unordered_map<std::string, size_t> definitionCounts; // Functions of each name, earlier inputs included
+    std::unordered_set<AstNode*> pureFunctions;
+    std::unordered_map<AstNode*, ValueType> returnTypes;
+    std::vector<AstNode*> inferring;
+    int temporaries = 0;
+    std::vector<std::string> inlineCacheSites;
+    std::vector<std::string> fieldCacheSites;
+    std::vector<std::string> inlined;
+    std::unordered_map<AstNode*, std::vector<bool>> escapingParams;
+    std::unordered_map<AstNode*, std::unordered_set<std::string>> escapingCaptures;
+    EscapeStats escapeStats;
+
+    void markTailCalls(AstNode*);
+    void markTailPosition(AstNode*);
+    void rewriteAccumulators(AstNode*);
+    AstNode* tryAccumulatorRewrite(AstNode*);
+    void collectFunctions(AstNode*);
+    void rememberGlobals(AstNode*);
+    AstNode* getTarget(AstNode*);
+    void analyzePurity(AstNode*);
+    bool isPure(AstNode*);
+    void markMemoized(AstNode*);
+    void removeDeadDefinitions(AstNode*);
+    void removeDeadBindings(AstNode*);
+    bool isInlinable(AstNode*);
+    AstNode* inlineCall(AstNode*, const std::unordered_set<std::string>&, const std::string&);
+    AstNode* inlineCalls(AstNode*, std::unordered_set<std::string>&, const std::string&);
+    AstNode* inlineCalls(AstNode*);
+    AstNode* foldConstants(AstNode*);
+    AstNode* foldBinaryOperation(AstNode*);
+    AstNode* foldUnaryOperation(AstNode*);
+    AstNode* foldFormatString(AstNode*);
+    AstNode* pruneIf(AstNode*);
+    void markLastUses(AstNode*);
+    AstNode* fuseSequences(AstNode*);
+    AstNode* fuseFor(AstNode*);
+    bool sharesWithGuarded(IfExpr&, size_t);
+    void shareSubexpressions(AstNode*);
+    void hoistInvariants(AstNode*);
+    void markParallelLoops(AstNode*);
+    void collectFreeNames(AstNode*, std::unordered_set<std::string>&, std::unordered_set<AstNode*>&);
+    bool isExpensive(AstNode*);
+    void scheduleBindings(AstNode*);
+    AstNode* fuseConcatenations(AstNode*);
+    void assignInlineCaches(AstNode*);
+    void compilePatterns(AstNode*);
+    void analyzeEscapes(AstNode*);
+    bool analyzeFunctionEscapes(AstNode*, const std::unordered_set<AstNode*>&, bool);
+    ValueType inferType(AstNode*, TypeEnv&);
+    ValueType inferCall(AstNode*, TypeEnv&);
+    ValueType inferFunction(AstNode*);
+    void bindPattern(AstNode*, ValueType, AstNode**, TypeEnv&);
+public:
+    Optimizer(const OptimizerOptions&);
+    AstNode* optimize(AstNode*);
+    // Method name of every inline cache slot handed out so far, in slot order
+    const std::vector<std::string>& getInlineCacheSites() const;
+    // Field name of every field load cache slot, in slot order
+    const std::vector<std::string>& getFieldCacheSites() const;
+    // One line per call site the last optimize call inlined, in order
+    const std::vector<std::string>& getInlined() const;
+    // Counts of the last optimize call
+    const EscapeStats& getEscapeStats() const;
+};
@@ -20,18 +20,21 @@ private:
     AstNode* handleBlock();
     AstNode* handleFn();
     AstNode* handleIf();
+    AstNode* handleFor();
+    AstNode* handleGuard(AstNode*);
     AstNode* handleCallArgsList();
     AstNode* handleArrayLiteral();
     AstNode* handleArraySubscript();
     AstNode* handleStringTemplate();
     AstNode* handleFormatString();
-    AstNode* handleExpression(std::vector<TokenType>);
+    AstNode* handleExpression(std::vector<TokenType>, bool statement = false);
     AstNode* tryTuplePattern(TokenType);
     AstNode* tryTupleExpression(TokenType);
     AstNode* tryAssignment();
     AstNode* tryTypedIdentifier();
     void emitError(const std::string&);
     void popOperatorStack(std::vector<AstNode*>&, AstNode*&, AstNode*&);
+    void finishOperatorStack(std::vector<AstNode*>&, AstNode*);
 public:
     AstNode* parse(std::vector<Token>);
     void addCheckpoint();
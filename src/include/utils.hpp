@@ -30,6 +30,22 @@ public:
     }
 };
 
+class TypeError : public std::runtime_error {
+public:
+    TypeError(const std::string &msg)
+      : std::runtime_error("TYPE ERROR: " + msg)
+    {
+    }
+};
+
+class RuntimeError : public std::runtime_error {
+public:
+    RuntimeError(const std::string &msg)
+      : std::runtime_error("RUNTIME ERROR: " + msg)
+    {
+    }
+};
+
 class SystemError : public std::runtime_error {
 public:
     SystemError(const std::string &msg, const char *fileName, int lineNum)
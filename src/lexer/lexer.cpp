@@ -190,6 +190,7 @@ std::vector<Token> Lexer::getTokens(){
                 emitError("Identifier may not start with a number");
             } else {
                 tokens.push_back(createNewToken());
+                numberIsFloat = false;
                 curState = State::normal;
             }
             break;
@@ -1,13 +1,22 @@
 #include "include/interpreter.hpp"
 
+#include <charconv>
 #include <cstring>
 #include <iostream>
 
+// The whole argument must be a non-negative number
+static bool parseCount(const char *arg, size_t &count){
+    const char *end = arg + std::strlen(arg);
+    auto [ptr, error] = std::from_chars(arg, end, count);
+    return error == std::errc() && ptr == end && ptr != arg;
+}
+
 int main(int argc, char *argv[]){
     bool hasSrcFile = false;
     bool quoteFilePath = false;
     bool forceRepl = false;
     std::string filePath = "";
+    InterpreterOptions options;
     for(int i = 1; i < argc; i++){
         if(quoteFilePath){
             if(argv[i][std::strlen(argv[i]) - 1] == '\"'){
@@ -16,9 +25,37 @@ int main(int argc, char *argv[]){
             } 
             filePath += argv[i];
         } else if(argv[i][0] == '-'){
-            std::string arg = argv[i] + 1;
+            std::string arg = argv[i] + (argv[i][1] == '-' ? 2 : 1);
             if(arg == "r" || arg == "repl"){
                 forceRepl = true;
+            } else if(arg == "accumulate"){
+                options.optimizer.accumulate = true;
+            } else if(arg == "dump-ast"){
+                options.dumpAst = true;
+            } else if(arg == "memoize"){
+                options.optimizer.memoize = true;
+            } else if(arg == "memo-size" && i + 1 < argc){
+                if(!parseCount(argv[++i], options.optimizer.memoCacheSize)){
+                    std::cerr << "--memo-size expects a number, got " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else if(arg == "threads" && i + 1 < argc){
+                if(!parseCount(argv[++i], options.threads)){
+                    std::cerr << "--threads expects a number, got " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else if(arg == "jit"){
+                options.jit = true;
+            } else if(arg == "no-inline"){
+                options.optimizer.inlining = false;
+            } else if(arg == "inline-report"){
+                options.inlineReport = true;
+            } else if(arg == "dump-cse"){
+                options.optimizer.dumpCse = true;
+            } else if(arg == "escape-report"){
+                options.escapeReport = true;
+            } else if(arg == "cache-report"){
+                options.cacheReport = true;
             }
         } else if(!hasSrcFile){
             hasSrcFile = true;
@@ -30,8 +67,8 @@ int main(int argc, char *argv[]){
         }
     }
     if(!hasSrcFile || forceRepl){
-        repl();
+        repl(options);
     } else {
-        script(filePath);
+        script(filePath, options);
     }
 }
\ No newline at end of file
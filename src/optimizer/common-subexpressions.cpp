@@ -0,0 +1,337 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// Expressions cheaper than this are recomputed, binding them would cost about as much
+static constexpr size_t sharedMinimumCost = 3;
+
+// One place an expression is evaluated. `always` is false when it is only evaluated on some
+// paths through the enclosing block: in a branch, a loop body or after a short-circuit
+struct Occurrence {
+    AstNode **slot;
+    std::string key;
+    bool always;
+};
+
+// Identifiers, literals, operators, calls and subscripts, the nodes appendKey spells out
+static bool isShareable(AstNode *node){
+    if(node == nullptr){
+        return true;
+    }
+    switch(node->type){
+    case NodeType::identifier:
+    case NodeType::intLiteral:
+    case NodeType::floatLiteral:
+    case NodeType::boolLiteral:
+    case NodeType::stringLiteral:
+    case NodeType::callArgsList:
+    case NodeType::arraySubscript:
+    case NodeType::sliceSubscript:
+    break;
+    default:
+        if(!isOperator(node->type)){
+            return false;
+        }
+    }
+    for(AstNode **child : getChildren(node)){
+        if(!isShareable(*child)){
+            return false;
+        }
+    }
+    return true;
+}
+
+// A method name alone is not a value, the call around it is
+static bool isCandidate(AstNode *node){
+    return isOperator(node->type) && node->type != NodeType::memberAccess &&
+        isShareable(node) && estimateCost(node) >= sharedMinimumCost;
+}
+
+// Equal for structurally identical expressions, what hash-consing keys on
+static void appendKey(AstNode *node, std::string &key){
+    if(node == nullptr){
+        key += "_";
+        return;
+    }
+    key += getNodeTypeName(node->type);
+    switch(node->type){
+    case NodeType::identifier:
+        key += " " + node->as<Identifier>().name;
+    break;
+    case NodeType::intLiteral:
+        key += " " + node->as<IntLiteral>().value;
+    break;
+    case NodeType::floatLiteral:
+        key += " " + node->as<FloatLiteral>().value;
+    break;
+    case NodeType::boolLiteral:
+        key += node->as<BoolLiteral>().value ? " true" : " false";
+    break;
+    case NodeType::stringLiteral:
+        key += " " + std::to_string(node->as<StringLiteral>().value.size()) + ":" + node->as<StringLiteral>().value;
+    break;
+    default:
+    break;
+    }
+    key += "(";
+    for(AstNode **child : getChildren(node)){
+        appendKey(*child, key);
+        key += ",";
+    }
+    key += ")";
+}
+
+// Candidates in evaluation order, an enclosing candidate before the ones inside it.
+// Nested functions are their own scope and are skipped
+static void collectOccurrences(AstNode **slot, bool always, std::vector<Occurrence> &occurrences){
+    AstNode *node = *slot;
+    if(node == nullptr || node->type == NodeType::function){
+        return;
+    }
+    if(isCandidate(node)){
+        std::string key;
+        appendKey(node, key);
+        occurrences.push_back({ slot, key, always });
+    }
+    switch(node->type){
+    case NodeType::ifExpr:
+    {
+        IfExpr &ifExpr = node->as<IfExpr>();
+        collectOccurrences(&ifExpr.condition, always, occurrences);
+        collectOccurrences(&ifExpr.ifBlock, false, occurrences);
+        for(size_t i = 0; i < ifExpr.elifBlock.size(); i++){
+            collectOccurrences(&ifExpr.elifCondition[i], false, occurrences);
+            collectOccurrences(&ifExpr.elifBlock[i], false, occurrences);
+        }
+        collectOccurrences(&ifExpr.elseBlock, false, occurrences);
+    break;
+    }
+    case NodeType::forExpr:
+    {
+        ForExpr &forExpr = node->as<ForExpr>();
+        collectOccurrences(&forExpr.expr, always, occurrences);
+        for(AstNode *&binding : forExpr.hoisted){
+            collectOccurrences(&binding, false, occurrences);
+        }
+        collectOccurrences(&forExpr.block, false, occurrences);
+    break;
+    }
+    case NodeType::conjunction:
+    case NodeType::disjunction:
+        collectOccurrences(&node->as<BinaryOperation>().left, always, occurrences);
+        collectOccurrences(&node->as<BinaryOperation>().right, false, occurrences);
+    break;
+    default:
+        for(AstNode **child : getChildren(node)){
+            collectOccurrences(child, always, occurrences);
+        }
+    }
+}
+
+static void collectNodes(AstNode *node, std::unordered_set<AstNode*> &nodes){
+    if(node == nullptr){
+        return;
+    }
+    nodes.insert(node);
+    for(AstNode **child : getChildren(node)){
+        collectNodes(*child, nodes);
+    }
+}
+
+static bool readsAny(AstNode *node, const std::unordered_set<std::string> &names){
+    std::unordered_set<std::string> reads;
+    collectReadNames(node, reads);
+    for(const std::string &read : reads){
+        if(names.count(read)){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Groups occurrences by key, keeping the order in which each key first occurs
+static std::vector<std::vector<size_t>> groupOccurrences(const std::vector<Occurrence> &occurrences){
+    std::vector<std::vector<size_t>> groups;
+    std::unordered_map<std::string, size_t> index;
+    for(size_t i = 0; i < occurrences.size(); i++){
+        auto [it, inserted] = index.try_emplace(occurrences[i].key, groups.size());
+        if(inserted){
+            groups.emplace_back();
+        }
+        groups[it->second].push_back(i);
+    }
+    return groups;
+}
+
+// Whether a pure expression always evaluated by elif condition i is evaluated again by what
+// the condition guards: its branch and every later condition and branch
+bool Optimizer::sharesWithGuarded(IfExpr &ifExpr, size_t i){
+    std::vector<Occurrence> condition;
+    collectOccurrences(&ifExpr.elifCondition[i], true, condition);
+    std::unordered_set<std::string> keys;
+    for(const Occurrence &occurrence : condition){
+        if(occurrence.always && isPure(*occurrence.slot)){
+            keys.insert(occurrence.key);
+        }
+    }
+    std::vector<Occurrence> guarded;
+    collectOccurrences(&ifExpr.elifBlock[i], false, guarded);
+    for(size_t j = i + 1; j < ifExpr.elifBlock.size(); j++){
+        collectOccurrences(&ifExpr.elifCondition[j], false, guarded);
+        collectOccurrences(&ifExpr.elifBlock[j], false, guarded);
+    }
+    collectOccurrences(&ifExpr.elseBlock, false, guarded);
+    for(const Occurrence &occurrence : guarded){
+        if(keys.count(occurrence.key)){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Shares repeated pure subexpressions of a block: the first evaluation is bound to a `$shared`
+// temporary right before the block expression containing it, and every occurrence reads the
+// temporary. The first occurrence must be evaluated whenever the block runs, so no expression
+// is computed that wouldn't have been. The rest may be in branches or loop bodies further on.
+// An expression is only shared when the names it reads mean the same thing at every
+// occurrence: none is bound inside the block below its top level, and top-level bindings of
+// them come before the first occurrence. Expressions reaching I/O are never shared, see isPure.
+// An elif condition only runs once the conditions before it failed. When it computes something
+// its branch or a later one computes again, the if is split there:
+// `if a: x elif b: y else: z` becomes `if a: x else: (if b: y else: z)`, and the else block
+// shares it like any other block
+void Optimizer::shareSubexpressions(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::ifExpr){
+        IfExpr &ifExpr = node->as<IfExpr>();
+        for(size_t i = 0; i < ifExpr.elifCondition.size(); i++){
+            if(!sharesWithGuarded(ifExpr, i)){
+                continue;
+            }
+            AstNode *rest = new AstNode(NodeType::ifExpr, IfExpr{
+                ifExpr.elifCondition[i],
+                ifExpr.elifBlock[i],
+                std::vector<AstNode*>(ifExpr.elifCondition.begin() + i + 1, ifExpr.elifCondition.end()),
+                std::vector<AstNode*>(ifExpr.elifBlock.begin() + i + 1, ifExpr.elifBlock.end()),
+                ifExpr.elseBlock
+            });
+            ifExpr.elifCondition.resize(i);
+            ifExpr.elifBlock.resize(i);
+            ifExpr.elseBlock = new AstNode(NodeType::block, Block{{ rest }, {}, {}});
+            break;
+        }
+    }
+    for(AstNode **child : getChildren(node)){
+        shareSubexpressions(*child);
+    }
+    if(node->type != NodeType::block){
+        return;
+    }
+    std::vector<AstNode*> &expressions = node->as<Block>().expressions;
+    while(true){
+        std::unordered_map<std::string, size_t> boundAt;
+        std::unordered_set<std::string> nested;
+        std::vector<Occurrence> occurrences;
+        std::vector<size_t> owners;
+        for(size_t i = 0; i < expressions.size(); i++){
+            if(expressions[i]->type == NodeType::assignment){
+                std::unordered_set<std::string> bound;
+                collectPatternNames(expressions[i]->as<Assignment>().lhs, bound);
+                for(const std::string &name : bound){
+                    boundAt[name] = i;
+                }
+                collectBoundNames(expressions[i]->as<Assignment>().rhs, nested);
+            } else {
+                collectBoundNames(expressions[i], nested);
+            }
+            collectOccurrences(&expressions[i], true, occurrences);
+            owners.resize(occurrences.size(), i);
+        }
+        const std::vector<size_t> *best = nullptr;
+        size_t bestCost = 0;
+        std::vector<std::vector<size_t>> groups = groupOccurrences(occurrences);
+        for(const std::vector<size_t> &group : groups){
+            const Occurrence &first = occurrences[group[0]];
+            if(group.size() < 2 || !first.always || estimateCost(*first.slot) <= bestCost || !isPure(*first.slot)){
+                continue;
+            }
+            std::unordered_set<std::string> reads;
+            collectReadNames(*first.slot, reads);
+            bool stable = true;
+            for(const std::string &read : reads){
+                if(nested.count(read) || (boundAt.count(read) && boundAt[read] >= owners[group[0]])){
+                    stable = false;
+                }
+            }
+            if(stable){
+                best = &group;
+                bestCost = estimateCost(*first.slot);
+            }
+        }
+        if(best == nullptr){
+            return;
+        }
+        std::string name = "$shared" + std::to_string(temporaries++);
+        AstNode *value = *occurrences[(*best)[0]].slot;
+        for(size_t i : *best){
+            *occurrences[i].slot = new AstNode(NodeType::identifier, Identifier{name});
+        }
+        expressions.insert(expressions.begin() + owners[(*best)[0]], makeBinding(name, value));
+    }
+}
+
+// Moves what a for body computes the same way on every iteration into the for's hoisted
+// bindings, evaluated once instead of once per element. First whole bindings at the top level
+// of the body whose value is pure and reads nothing bound by the loop, in order, so a binding
+// reading an earlier hoisted one can follow it. The body's last expression is its value and
+// stays. Then pure subexpressions with the same property, where only those evaluated on every
+// iteration are hoisted, along with their other occurrences. Inner loops go first, what they
+// hoisted is only evaluated when they run and stays with them
+void Optimizer::hoistInvariants(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    for(AstNode **child : getChildren(node)){
+        hoistInvariants(*child);
+    }
+    if(node->type != NodeType::forExpr || node->as<ForExpr>().block->type != NodeType::block){
+        return;
+    }
+    ForExpr &forExpr = node->as<ForExpr>();
+    std::vector<AstNode*> &body = forExpr.block->as<Block>().expressions;
+    for(size_t i = 0; i + 1 < body.size();){
+        std::unordered_set<std::string> bound;
+        collectPatternNames(forExpr.pattern, bound);
+        collectBoundNames(forExpr.block, bound);
+        AstNode *expr = body[i];
+        if(expr->type == NodeType::assignment && isPure(expr->as<Assignment>().rhs) &&
+            !readsAny(expr->as<Assignment>().rhs, bound)){
+            forExpr.hoisted.push_back(expr);
+            body.erase(body.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    std::unordered_set<std::string> bound;
+    collectPatternNames(forExpr.pattern, bound);
+    collectBoundNames(forExpr.block, bound);
+    std::vector<Occurrence> occurrences;
+    collectOccurrences(&forExpr.block, true, occurrences);
+    std::unordered_set<AstNode*> moved;
+    for(const std::vector<size_t> &group : groupOccurrences(occurrences)){
+        const Occurrence &first = occurrences[group[0]];
+        if(!first.always || moved.count(*first.slot) || !isPure(*first.slot) || readsAny(*first.slot, bound)){
+            continue;
+        }
+        std::string name = "$invariant" + std::to_string(temporaries++);
+        AstNode *value = *first.slot;
+        for(size_t i : group){
+            if(!moved.count(*occurrences[i].slot)){
+                collectNodes(*occurrences[i].slot, moved);
+                *occurrences[i].slot = new AstNode(NodeType::identifier, Identifier{name});
+            }
+        }
+        forExpr.hoisted.push_back(makeBinding(name, value));
+    }
+}
@@ -0,0 +1,348 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// Int literals are already parsed by the parser
+static void parseNumber(AstNode *node){
+    if(node->type == NodeType::floatLiteral){
+        FloatLiteral &lit = node->as<FloatLiteral>();
+        double value;
+        std::from_chars_result res = std::from_chars(lit.value.data(), lit.value.data() + lit.value.size(), value);
+        if(res.ec == std::errc()){
+            lit.number = value;
+        }
+    }
+}
+
+static bool isIntLiteral(AstNode *node){
+    return node && node->type == NodeType::intLiteral;
+}
+
+static bool isFloatLiteral(AstNode *node){
+    return node && node->type == NodeType::floatLiteral && node->as<FloatLiteral>().number;
+}
+
+static bool isBoolLiteral(AstNode *node){
+    return node && node->type == NodeType::boolLiteral;
+}
+
+static bool isStringLiteral(AstNode *node){
+    return node && node->type == NodeType::stringLiteral;
+}
+
+template<typename T>
+static AstNode* foldComparison(NodeType type, const T &a, const T &b){
+    switch(type){
+    case NodeType::equality:
+        return makeBoolLiteral(a == b);
+    case NodeType::inequality:
+        return makeBoolLiteral(a != b);
+    case NodeType::lessThan:
+        return makeBoolLiteral(a < b);
+    case NodeType::greaterThan:
+        return makeBoolLiteral(a > b);
+    case NodeType::lessEqual:
+        return makeBoolLiteral(a <= b);
+    case NodeType::greaterEqual:
+        return makeBoolLiteral(a >= b);
+    default:
+        return nullptr;
+    }
+}
+
+static bool checkedPow(long long base, long long exp, long long &result){
+    result = 1;
+    while(exp > 0){
+        if(exp & 1 && __builtin_mul_overflow(result, base, &result)){
+            return false;
+        }
+        exp >>= 1;
+        if(exp > 0 && __builtin_mul_overflow(base, base, &base)){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sums, differences and products promote to bigints like they do at runtime. Powers and
+// roots are only folded for 64-bit operands, nullptr leaves the operation to the runtime
+static AstNode* foldInt(NodeType type, const IntLiteral &left, const IntLiteral &right){
+    switch(type){
+    case NodeType::addition:
+        return makeIntLiteral(left.integer + right.integer);
+    case NodeType::subtraction:
+        return makeIntLiteral(left.integer - right.integer);
+    case NodeType::multiplication:
+        return makeIntLiteral(left.integer * right.integer);
+    default:
+    break;
+    }
+    if(!left.number || !right.number){
+        return foldComparison(type, left.integer, right.integer);
+    }
+    long long a = *left.number;
+    long long b = *right.number;
+    long long result;
+    switch(type){
+    case NodeType::exponentiation:
+        if(b < 0 || !checkedPow(a, b, result)){
+            return nullptr;
+        }
+        return makeIntLiteral(result);
+    case NodeType::root:
+        if(b <= 0 || a < 0){
+            return nullptr;
+        }
+        return makeFloatLiteral(std::pow(static_cast<double>(a), 1.0 / b));
+    default:
+        return foldComparison(type, a, b);
+    }
+}
+
+static AstNode* foldFloat(NodeType type, double a, double b){
+    double result;
+    switch(type){
+    case NodeType::addition:
+        result = a + b;
+    break;
+    case NodeType::subtraction:
+        result = a - b;
+    break;
+    case NodeType::multiplication:
+        result = a * b;
+    break;
+    case NodeType::division:
+        if(b == 0){
+            return nullptr;
+        }
+        result = a / b;
+    break;
+    case NodeType::exponentiation:
+        result = std::pow(a, b);
+    break;
+    case NodeType::root:
+        if(b == 0){
+            return nullptr;
+        }
+        result = std::pow(a, 1.0 / b);
+    break;
+    default:
+        return foldComparison(type, a, b);
+    }
+    return std::isfinite(result) ? makeFloatLiteral(result) : nullptr;
+}
+
+// Operands of different types are never folded, mixing them is a type error left to the runtime.
+// `false and x` and `true or x` aren't folded either unless x is a literal: folding runs before
+// type inference, which still has to reject an x that isn't a bool
+AstNode* Optimizer::foldBinaryOperation(AstNode *node){
+    AstNode *left = node->as<BinaryOperation>().left;
+    AstNode *right = node->as<BinaryOperation>().right;
+    AstNode *folded = nullptr;
+    if(isIntLiteral(left) && isIntLiteral(right)){
+        folded = foldInt(node->type, left->as<IntLiteral>(), right->as<IntLiteral>());
+    } else if(isFloatLiteral(left) && isFloatLiteral(right)){
+        folded = foldFloat(node->type, *left->as<FloatLiteral>().number, *right->as<FloatLiteral>().number);
+    } else if(isStringLiteral(left) && isStringLiteral(right)){
+        const std::string &a = left->as<StringLiteral>().value;
+        const std::string &b = right->as<StringLiteral>().value;
+        folded = node->type == NodeType::addition ? makeStringLiteral(a + b) : foldComparison(node->type, a, b);
+    } else if(isBoolLiteral(left) && isBoolLiteral(right)){
+        bool a = left->as<BoolLiteral>().value;
+        bool b = right->as<BoolLiteral>().value;
+        switch(node->type){
+        case NodeType::conjunction:
+            folded = makeBoolLiteral(a && b);
+        break;
+        case NodeType::disjunction:
+            folded = makeBoolLiteral(a || b);
+        break;
+        case NodeType::equality:
+            folded = makeBoolLiteral(a == b);
+        break;
+        case NodeType::inequality:
+            folded = makeBoolLiteral(a != b);
+        break;
+        default:
+        break;
+        }
+    }
+    return folded ? folded : node;
+}
+
+AstNode* Optimizer::foldUnaryOperation(AstNode *node){
+    AstNode *expr = node->as<UnaryOperation>().expr;
+    switch(node->type){
+    case NodeType::plusSign:
+        if(isIntLiteral(expr) || isFloatLiteral(expr)){
+            return expr;
+        }
+    break;
+    case NodeType::minusSign:
+        if(isIntLiteral(expr)){
+            return makeIntLiteral(-expr->as<IntLiteral>().integer);
+        }
+        if(isFloatLiteral(expr)){
+            return makeFloatLiteral(-*expr->as<FloatLiteral>().number);
+        }
+    break;
+    case NodeType::negation:
+        if(isBoolLiteral(expr)){
+            return makeBoolLiteral(!expr->as<BoolLiteral>().value);
+        }
+    break;
+    default:
+    break;
+    }
+    return node;
+}
+
+// Compiles a format string once: constant unformatted int, bool and string templates are
+// inlined, neighbouring literals merged and the literal length recorded so the runtime
+// can size its output in one go. Floats are left alone, their output format belongs to the runtime.
+// A format string with nothing left to substitute becomes a single string literal
+AstNode* Optimizer::foldFormatString(AstNode *node){
+    FormatString &format = node->as<FormatString>();
+    std::vector<AstNode*> children;
+    std::string text;
+    size_t literalLength = 0;
+    for(AstNode *child : format.children){
+        if(isStringLiteral(child)){
+            text += child->as<StringLiteral>().value;
+            continue;
+        }
+        AstNode *value = child->as<StringTemplate>().value;
+        if(child->as<StringTemplate>().format == nullptr){
+            if(isStringLiteral(value)){
+                text += value->as<StringLiteral>().value;
+                continue;
+            } else if(isIntLiteral(value)){
+                text += value->as<IntLiteral>().integer.toString();
+                continue;
+            } else if(isBoolLiteral(value)){
+                text += value->as<BoolLiteral>().value ? "true" : "false";
+                continue;
+            }
+        }
+        literalLength += text.length();
+        children.push_back(makeStringLiteral(text));
+        children.push_back(child);
+        text.clear();
+    }
+    if(children.empty()){
+        return makeStringLiteral(text);
+    }
+    literalLength += text.length();
+    children.push_back(makeStringLiteral(text));
+    format.children = children;
+    format.literalLength = literalLength;
+    return node;
+}
+
+// Drops branches whose condition is constant false, a constant true condition
+// becomes the else branch. An if left with only an else is replaced by its block
+AstNode* Optimizer::pruneIf(AstNode *node){
+    IfExpr &ifExpr = node->as<IfExpr>();
+    std::vector<AstNode*> conditions = { ifExpr.condition };
+    std::vector<AstNode*> blocks = { ifExpr.ifBlock };
+    conditions.insert(conditions.end(), ifExpr.elifCondition.begin(), ifExpr.elifCondition.end());
+    blocks.insert(blocks.end(), ifExpr.elifBlock.begin(), ifExpr.elifBlock.end());
+    std::vector<AstNode*> keptConditions;
+    std::vector<AstNode*> keptBlocks;
+    AstNode *elseBlock = ifExpr.elseBlock;
+    for(size_t i = 0; i < conditions.size(); i++){
+        if(!isBoolLiteral(conditions[i])){
+            keptConditions.push_back(conditions[i]);
+            keptBlocks.push_back(blocks[i]);
+        } else if(conditions[i]->as<BoolLiteral>().value){
+            elseBlock = blocks[i];
+            break;
+        }
+    }
+    if(keptConditions.empty()){
+        return elseBlock ? elseBlock : node;
+    }
+    ifExpr.condition = keptConditions[0];
+    ifExpr.ifBlock = keptBlocks[0];
+    ifExpr.elifCondition.assign(keptConditions.begin() + 1, keptConditions.end());
+    ifExpr.elifBlock.assign(keptBlocks.begin() + 1, keptBlocks.end());
+    ifExpr.elseBlock = elseBlock;
+    return node;
+}
+
+AstNode* Optimizer::foldConstants(AstNode *node){
+    if(node == nullptr){
+        return nullptr;
+    }
+    for(AstNode **child : getChildren(node)){
+        *child = foldConstants(*child);
+    }
+    switch(node->type){
+    case NodeType::intLiteral:
+    case NodeType::floatLiteral:
+        parseNumber(node);
+        return node;
+    case NodeType::formatString:
+        return foldFormatString(node);
+    case NodeType::ifExpr:
+        return pruneIf(node);
+    case NodeType::call:
+    case NodeType::tailCall:
+    case NodeType::memberAccess:
+    case NodeType::arrayAccess:
+        return node;
+    default:
+    break;
+    }
+    if(isOperator(node->type) && isBinaryOperator(node->type)){
+        if(node->as<BinaryOperation>().left && node->as<BinaryOperation>().right){
+            return foldBinaryOperation(node);
+        }
+    } else if(isOperator(node->type)){
+        if(node->as<UnaryOperation>().expr){
+            return foldUnaryOperation(node);
+        }
+    }
+    return node;
+}
+
+static void collectConcatenationParts(AstNode *node, std::vector<AstNode*> &parts){
+    if(node->type == NodeType::addition && node->valueType == ValueType::string){
+        collectConcatenationParts(node->as<BinaryOperation>().left, parts);
+        collectConcatenationParts(node->as<BinaryOperation>().right, parts);
+    } else if(node->type == NodeType::concatenation){
+        for(AstNode *part : node->as<Concatenation>().parts){
+            collectConcatenationParts(part, parts);
+        }
+    } else if(isStringLiteral(node) && !parts.empty() && isStringLiteral(parts.back())){
+        parts.back() = makeStringLiteral(parts.back()->as<StringLiteral>().value + node->as<StringLiteral>().value);
+        parts.back()->valueType = ValueType::string;
+    } else {
+        parts.push_back(node);
+    }
+}
+
+// `a + b + c` on strings would copy the growing prefix at every step. A chain of three
+// or more parts becomes one concatenation that sizes its result once and copies each part
+// once, neighbouring literals merged. Needs the string types found by inferType
+AstNode* Optimizer::fuseConcatenations(AstNode *node){
+    if(node == nullptr){
+        return nullptr;
+    }
+    for(AstNode **child : getChildren(node)){
+        *child = fuseConcatenations(*child);
+    }
+    if(node->type != NodeType::addition || node->valueType != ValueType::string){
+        return node;
+    }
+    std::vector<AstNode*> parts;
+    collectConcatenationParts(node, parts);
+    if(parts.size() == 1){
+        return parts[0];
+    }
+    if(parts.size() < 3){
+        return node;
+    }
+    AstNode *returned = new AstNode(NodeType::concatenation, Concatenation{parts});
+    returned->valueType = ValueType::string;
+    return returned;
+}
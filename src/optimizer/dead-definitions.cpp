@@ -0,0 +1,98 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// Names a top-level expression defines: the name of a function, the names a binding binds
+static void collectDefinedNames(AstNode *node, std::unordered_set<std::string> &names){
+    if(node->type == NodeType::function && node->as<Function>().name){
+        names.insert(node->as<Function>().name->as<Identifier>().name);
+    } else if(node->type == NodeType::assignment){
+        collectPatternNames(node->as<Assignment>().lhs, names);
+    }
+}
+
+// Drops the top-level definitions the program never reaches. What runs is `main` if it is
+// defined, and every top-level expression that defines nothing. Bindings with effects run
+// too, whether or not their names are read. Everything the names read by those reaches,
+// through the call graph and global bindings, is kept; the rest goes before any other pass
+// spends work on it. Only for whole programs: a REPL line may define what a later one uses
+void Optimizer::removeDeadDefinitions(AstNode *root){
+    if(root == nullptr || root->type != NodeType::block){
+        return;
+    }
+    std::vector<AstNode*> &expressions = root->as<Block>().expressions;
+    std::unordered_map<std::string, std::vector<size_t>> definitions;
+    std::vector<size_t> worklist;
+    for(size_t i = 0; i < expressions.size(); i++){
+        AstNode *expr = expressions[i];
+        std::unordered_set<std::string> defined;
+        collectDefinedNames(expr, defined);
+        for(const std::string &name : defined){
+            definitions[name].push_back(i);
+        }
+        if(defined.empty() || defined.count("main") ||
+            (expr->type == NodeType::assignment && !isPure(expr->as<Assignment>().rhs))){
+            worklist.push_back(i);
+        }
+    }
+    std::vector<bool> reached(expressions.size());
+    while(!worklist.empty()){
+        size_t i = worklist.back();
+        worklist.pop_back();
+        if(reached[i]){
+            continue;
+        }
+        reached[i] = true;
+        std::unordered_set<std::string> reads;
+        collectReadNames(expressions[i], reads);
+        for(const std::string &read : reads){
+            auto it = definitions.find(read);
+            if(it != definitions.end()){
+                worklist.insert(worklist.end(), it->second.begin(), it->second.end());
+            }
+        }
+    }
+    std::vector<AstNode*> kept;
+    for(size_t i = 0; i < expressions.size(); i++){
+        if(reached[i]){
+            kept.push_back(expressions[i]);
+        }
+    }
+    expressions = std::move(kept);
+}
+
+// Bindings in a function body whose names nothing after them reads, and whose value has no
+// effect, are dropped. The body's last expression is its value and always stays. Bindings
+// in nested blocks are left alone, they stay visible to the rest of the body
+void Optimizer::removeDeadBindings(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    for(AstNode **child : getChildren(node)){
+        removeDeadBindings(*child);
+    }
+    if(node->type != NodeType::function || node->as<Function>().block->type != NodeType::block){
+        return;
+    }
+    std::vector<AstNode*> &expressions = node->as<Function>().block->as<Block>().expressions;
+    if(expressions.empty()){
+        return;
+    }
+    std::unordered_set<std::string> reads;
+    collectReadNames(expressions.back(), reads);
+    for(int i = expressions.size() - 2; i >= 0; i--){
+        AstNode *expr = expressions[i];
+        if(expr->type == NodeType::assignment && isPure(expr->as<Assignment>().rhs)){
+            std::unordered_set<std::string> bound;
+            collectPatternNames(expr->as<Assignment>().lhs, bound);
+            bool used = false;
+            for(const std::string &name : bound){
+                used = used || reads.count(name);
+            }
+            if(!used){
+                expressions.erase(expressions.begin() + i);
+                continue;
+            }
+        }
+        collectReadNames(expr, reads);
+    }
+}
@@ -0,0 +1,389 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+#include <algorithm>
+
+// Methods whose result is a new value that holds neither the receiver nor an argument
+static std::unordered_set<std::string> nonRetainingMethods = {
+    "length", "sum", "any", "all", "join"
+};
+
+static bool isAllocationSite(AstNode *node, const std::unordered_set<AstNode*> &unbuilt){
+    switch(node->type){
+    case NodeType::tupleExpression:
+        return node->as<TupleExpression>().children.size() >= 2 && !unbuilt.count(node);
+    case NodeType::arrayLiteral:
+        return true;
+    case NodeType::forExpr:
+        return !node->as<ForExpr>().lazy;
+    case NodeType::function:
+        return !node->as<Function>().captures.empty();
+    default:
+        return false;
+    }
+}
+
+static void collectSpelledOut(AstNode *node, const std::vector<AstNode*> &values, std::unordered_set<AstNode*> &unbuilt){
+    if(node == nullptr || node->type != NodeType::tupleExpression ||
+        std::find(values.begin(), values.end(), node) != values.end()){
+        return;
+    }
+    unbuilt.insert(node);
+    for(AstNode *child : node->as<TupleExpression>().children){
+        collectSpelledOut(child, values, unbuilt);
+    }
+}
+
+// Tuple expressions a compiled assignment spells out instead of building, see compilePatterns
+static void collectUnbuilt(AstNode *node, std::unordered_set<AstNode*> &unbuilt){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::assignment){
+        collectSpelledOut(node->as<Assignment>().rhs, node->as<Assignment>().values, unbuilt);
+    }
+    for(AstNode **child : getChildren(node)){
+        collectUnbuilt(*child, unbuilt);
+    }
+}
+
+// One walk over a function body. Each node is visited with whether the value it produces
+// escapes the call: it is returned, passed where it may be kept, stored in something that
+// escapes, or bound to a name that does. Separately, whether its contents escape: an element
+// read out of it does, while the value itself may still die with the call. Names found
+// escaping are added to `escaping` or `contentsEscaping`, the walk repeats until both stop changing
+struct EscapeWalk {
+    const std::unordered_map<AstNode*, AstNode*> &targets;
+    const std::unordered_map<AstNode*, std::vector<bool>> &escapingParams;
+    const std::unordered_map<AstNode*, std::unordered_set<std::string>> &escapingCaptures;
+    const std::unordered_set<AstNode*> &unbuilt;
+    std::unordered_set<std::string> locals;
+    std::unordered_set<std::string> escaping;
+    std::unordered_set<std::string> contentsEscaping;
+    std::unordered_set<std::string> escapingFree; // Names of enclosing functions this body lets escape
+    bool changed = false;
+    bool mark = false;
+    EscapeStats stats;
+
+    EscapeWalk(const std::unordered_map<AstNode*, AstNode*> &targets,
+        const std::unordered_map<AstNode*, std::vector<bool>> &escapingParams,
+        const std::unordered_map<AstNode*, std::unordered_set<std::string>> &escapingCaptures,
+        const std::unordered_set<AstNode*> &unbuilt)
+      : targets(targets), escapingParams(escapingParams), escapingCaptures(escapingCaptures), unbuilt(unbuilt)
+    {
+    }
+
+    void escape(const std::string &name, bool escapes, bool contents){
+        if(!locals.count(name)){
+            if(escapes || contents){
+                escapingFree.insert(name);
+            }
+            return;
+        }
+        if(escapes){
+            changed |= escaping.insert(name).second;
+        }
+        if(contents){
+            changed |= contentsEscaping.insert(name).second;
+        }
+    }
+
+    bool anyEscapes(AstNode *pattern){
+        std::unordered_set<std::string> names;
+        collectPatternNames(pattern, names);
+        for(const std::string &name : names){
+            if(escaping.count(name)){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool anyContentsEscape(AstNode *pattern){
+        std::unordered_set<std::string> names;
+        collectPatternNames(pattern, names);
+        for(const std::string &name : names){
+            if(contentsEscaping.count(name)){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // A compiled assignment binds each name to a value whole or to a part of it, see compilePatterns
+    void assignment(Assignment &assignment){
+        if(assignment.values.empty()){
+            bool escapes = anyEscapes(assignment.lhs);
+            walk(assignment.rhs, escapes, escapes || anyContentsEscape(assignment.lhs));
+            return;
+        }
+        std::vector<bool> escapes(assignment.values.size());
+        std::vector<bool> contents(assignment.values.size());
+        for(const PatternLoad &load : assignment.loads){
+            bool targetEscapes = anyEscapes(load.target);
+            bool targetContents = anyContentsEscape(load.target);
+            if(load.path.empty()){
+                escapes[load.value] = escapes[load.value] || targetEscapes;
+                contents[load.value] = contents[load.value] || targetContents;
+            } else {
+                contents[load.value] = contents[load.value] || targetEscapes || targetContents;
+            }
+        }
+        for(size_t i = 0; i < assignment.values.size(); i++){
+            walk(assignment.values[i], escapes[i], escapes[i] || contents[i]);
+        }
+    }
+
+    void call(AstNode *node, bool escapes, bool contents){
+        AstNode *callee = node->as<BinaryOperation>().left;
+        std::vector<AstNode*> &args = node->as<BinaryOperation>().right->as<CallArgsList>().args;
+        const std::vector<bool> *params = nullptr;
+        bool retained = true;
+        if(callee->type == NodeType::identifier && !locals.count(callee->as<Identifier>().name)){
+            const std::string &name = callee->as<Identifier>().name;
+            auto target = targets.find(callee);
+            auto it = target == targets.end() ? escapingParams.end() : escapingParams.find(target->second);
+            if(it != escapingParams.end() && it->second.size() == args.size()){
+                params = &it->second;
+            }
+            retained = !effectfulBuiltins.count(name);
+        } else if(callee->type == NodeType::memberAccess){
+            AstNode *method = callee->as<BinaryOperation>().right;
+            retained = !(method && method->type == NodeType::identifier && nonRetainingMethods.count(method->as<Identifier>().name));
+            // Otherwise the result may be the receiver itself updated in place, or one of its elements
+            if(retained){
+                walk(callee->as<BinaryOperation>().left, escapes, escapes || contents);
+            } else {
+                walk(callee->as<BinaryOperation>().left, false, false);
+            }
+        } else {
+            // Calling a closure keeps nothing of it, what its body lets escape is in escapingCaptures
+            walk(callee, false, false);
+        }
+        for(size_t i = 0; i < args.size(); i++){
+            bool kept = params ? (*params)[i] : retained;
+            walk(args[i], kept, kept);
+        }
+    }
+
+    void walk(AstNode *node, bool escapes, bool contents){
+        if(node == nullptr){
+            return;
+        }
+        if(mark && isAllocationSite(node, unbuilt)){
+            stats.sites++;
+            stats.local += !escapes;
+        }
+        switch(node->type){
+        case NodeType::identifier:
+            escape(node->as<Identifier>().name, escapes, contents);
+        break;
+        case NodeType::function:
+        {
+            // The closure's environment holds copies of the captured values
+            Function &fn = node->as<Function>();
+            auto it = escapingCaptures.find(node);
+            for(const std::string &name : fn.captures){
+                if(escapes || contents || (it != escapingCaptures.end() && it->second.count(name))){
+                    escape(name, true, true);
+                }
+            }
+            if(mark){
+                fn.local = !escapes && !fn.captures.empty();
+            }
+        break;
+        }
+        case NodeType::tupleExpression:
+            // One element parentheses only group, their element is the value itself
+            if(node->as<TupleExpression>().children.size() == 1){
+                walk(node->as<TupleExpression>().children[0], escapes, contents);
+                break;
+            }
+            for(AstNode *child : node->as<TupleExpression>().children){
+                walk(child, escapes || contents, escapes || contents);
+            }
+            if(mark){
+                node->as<TupleExpression>().local = !escapes && isAllocationSite(node, unbuilt);
+            }
+        break;
+        case NodeType::arrayLiteral:
+            for(AstNode *elem : node->as<ArrayLiteral>().elements){
+                walk(elem, escapes || contents, escapes || contents);
+            }
+            if(mark){
+                node->as<ArrayLiteral>().local = !escapes;
+            }
+        break;
+        case NodeType::forExpr:
+        {
+            ForExpr &forExpr = node->as<ForExpr>();
+            walk(forExpr.expr, false, anyEscapes(forExpr.pattern) || anyContentsEscape(forExpr.pattern));
+            for(AstNode *binding : forExpr.hoisted){
+                walk(binding, false, false);
+            }
+            // The body's values are the elements of the array built
+            walk(forExpr.block, escapes || contents, escapes || contents);
+            if(mark){
+                forExpr.local = !escapes && !forExpr.lazy;
+            }
+        break;
+        }
+        case NodeType::block:
+        {
+            std::vector<AstNode*> &expressions = node->as<Block>().expressions;
+            for(size_t i = 0; i < expressions.size(); i++){
+                bool last = i + 1 == expressions.size();
+                walk(expressions[i], last && escapes, last && contents);
+            }
+        break;
+        }
+        case NodeType::assignment:
+            assignment(node->as<Assignment>());
+        break;
+        case NodeType::ifExpr:
+        {
+            IfExpr &ifExpr = node->as<IfExpr>();
+            walk(ifExpr.condition, false, false);
+            walk(ifExpr.ifBlock, escapes, contents);
+            for(size_t i = 0; i < ifExpr.elifBlock.size(); i++){
+                walk(ifExpr.elifCondition[i], false, false);
+                walk(ifExpr.elifBlock[i], escapes, contents);
+            }
+            walk(ifExpr.elseBlock, escapes, contents);
+        break;
+        }
+        case NodeType::call:
+        case NodeType::tailCall:
+            call(node, escapes, contents);
+        break;
+        case NodeType::memberAccess:
+            // A method value is bound to its receiver
+            walk(node->as<BinaryOperation>().left, escapes, escapes || contents);
+        break;
+        case NodeType::arrayAccess:
+            walk(node->as<BinaryOperation>().left, false, escapes || contents);
+            walk(node->as<BinaryOperation>().right, false, false);
+        break;
+        case NodeType::addition:
+        case NodeType::concatenation:
+            // The result may reuse an operand's storage
+            for(AstNode **child : getChildren(node)){
+                walk(*child, escapes, contents);
+            }
+        break;
+        case NodeType::typedIdentifier:
+        case NodeType::tuplePattern:
+        break;
+        default:
+        {
+            bool kept = !isOperator(node->type);
+            for(AstNode **child : getChildren(node)){
+                walk(*child, kept, kept);
+            }
+        }
+        }
+    }
+};
+
+// Analyzes one function body, nested functions were done before. Returns whether the
+// escaping parameters of a named function changed
+bool Optimizer::analyzeFunctionEscapes(AstNode *node, const std::unordered_set<AstNode*> &unbuilt, bool mark){
+    Function &fn = node->as<Function>();
+    EscapeWalk walk(targets, escapingParams, escapingCaptures, unbuilt);
+    for(AstNode *param : fn.paramList->as<FnParamList>().params){
+        collectPatternNames(param, walk.locals);
+    }
+    // A memo cache keeps the arguments of every call as its key
+    if(fn.memoCapacity > 0){
+        walk.escaping = walk.locals;
+        walk.contentsEscaping = walk.locals;
+    }
+    collectBoundNames(fn.block, walk.locals);
+    do {
+        walk.changed = false;
+        walk.walk(fn.block, true, true);
+    } while(walk.changed);
+    if(mark){
+        walk.mark = true;
+        walk.walk(fn.block, true, true);
+        escapeStats.sites += walk.stats.sites;
+        escapeStats.local += walk.stats.local;
+    }
+    escapingCaptures[node] = walk.escapingFree;
+    if(!fn.name){
+        return false;
+    }
+    std::vector<bool> params;
+    for(AstNode *param : fn.paramList->as<FnParamList>().params){
+        params.push_back(param && (walk.anyEscapes(param) || walk.anyContentsEscape(param)));
+    }
+    std::vector<bool> &known = escapingParams[node];
+    if(known == params){
+        return false;
+    }
+    known = std::move(params);
+    return true;
+}
+
+static void collectFunctionNodes(AstNode *node, std::vector<AstNode*> &nodes){
+    if(node == nullptr){
+        return;
+    }
+    for(AstNode **child : getChildren(node)){
+        collectFunctionNodes(*child, nodes);
+    }
+    if(node->type == NodeType::function){
+        nodes.push_back(node);
+    }
+}
+
+static void countTopLevelSites(AstNode *node, const std::unordered_set<AstNode*> &unbuilt, EscapeStats &stats){
+    if(node == nullptr || node->type == NodeType::function){
+        return;
+    }
+    stats.sites += isAllocationSite(node, unbuilt);
+    for(AstNode **child : getChildren(node)){
+        countTopLevelSites(*child, unbuilt, stats);
+    }
+}
+
+// Escape analysis of closures, tuples and arrays built by literals and for-expressions.
+// A value that provably never outlives the call creating it is marked local: it goes in the
+// call frame instead of on the heap. Every function body is analyzed on its own, nested ones
+// first, so a closure tells its enclosing function which captured values it lets escape.
+// Calls to named functions use which parameters of the definition they resolve to escape,
+// iterated to a fixed point over the whole program since functions may be (mutually)
+// recursive; any other call is assumed to keep its arguments. Top-level values are globals
+// and stay on the heap
+void Optimizer::analyzeEscapes(AstNode *root){
+    escapeStats = EscapeStats{};
+    escapingParams.clear();
+    escapingCaptures.clear();
+    collectCaptures(root, {});
+    std::unordered_set<AstNode*> unbuilt;
+    collectUnbuilt(root, unbuilt);
+    std::vector<AstNode*> nodes;
+    collectFunctionNodes(root, nodes);
+    // Parameters start out not escaping and only ever start to, recursion settles on the least fixed point
+    for(AstNode *node : nodes){
+        Function &fn = node->as<Function>();
+        if(fn.name){
+            escapingParams[node].assign(fn.paramList->as<FnParamList>().params.size(), false);
+        }
+    }
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(AstNode *node : nodes){
+            changed |= analyzeFunctionEscapes(node, unbuilt, false);
+        }
+    }
+    for(AstNode *node : nodes){
+        analyzeFunctionEscapes(node, unbuilt, true);
+    }
+    countTopLevelSites(root, unbuilt, escapeStats);
+}
+
+const EscapeStats& Optimizer::getEscapeStats() const {
+    return escapeStats;
+}
@@ -0,0 +1,156 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// Methods that consume their receiver one element at a time and keep nothing of it
+static std::unordered_set<std::string> reductionMethods = {
+    "join", "sum", "min", "max", "length", "any", "all"
+};
+
+static AstNode* makeForExpr(AstNode *pattern, AstNode *expr, const std::vector<AstNode*> &body){
+    return new AstNode(NodeType::forExpr, ForExpr{
+        new AstNode(NodeType::tuplePattern, TuplePattern{{ pattern }}),
+        expr,
+        new AstNode(NodeType::block, Block{body, {}, {}}),
+        false, false, 0, false, {}
+    });
+}
+
+// `xs.map(f)` or `xs.filter(f)` with a single function argument named `f`, returns the method name
+static const std::string* getSequenceMethod(AstNode *node){
+    if(node->type != NodeType::call){
+        return nullptr;
+    }
+    AstNode *callee = node->as<BinaryOperation>().left;
+    if(callee->type != NodeType::memberAccess){
+        return nullptr;
+    }
+    AstNode *method = callee->as<BinaryOperation>().right;
+    if(!isIdentifierNamed(method, "map") && !isIdentifierNamed(method, "filter")){
+        return nullptr;
+    }
+    std::vector<AstNode*> &args = node->as<BinaryOperation>().right->as<CallArgsList>().args;
+    if(args.size() != 1 || args[0] == nullptr || args[0]->type != NodeType::identifier){
+        return nullptr;
+    }
+    return &method->as<Identifier>().name;
+}
+
+// Every expression whose value becomes an element of the for: the last expression of
+// the body, through the branches of ifs. An if without else yields nothing when no branch runs
+static void collectYieldSlots(AstNode **slot, std::vector<AstNode**> &slots){
+    AstNode *node = *slot;
+    if(node == nullptr){
+        return;
+    }
+    switch(node->type){
+    case NodeType::block:
+    {
+        std::vector<AstNode*> &expressions = node->as<Block>().expressions;
+        if(!expressions.empty()){
+            collectYieldSlots(&expressions.back(), slots);
+        }
+    break;
+    }
+    case NodeType::ifExpr:
+    {
+        IfExpr &ifExpr = node->as<IfExpr>();
+        collectYieldSlots(&ifExpr.ifBlock, slots);
+        for(AstNode *&block : ifExpr.elifBlock){
+            collectYieldSlots(&block, slots);
+        }
+        collectYieldSlots(&ifExpr.elseBlock, slots);
+    break;
+    }
+    default:
+        slots.push_back(slot);
+    }
+}
+
+// `for p in (for q in xs: a): b` becomes `for q in xs: (p = a; b)`, every element goes
+// through both bodies before the next one is produced. Both bodies must be pure, since their
+// effects would otherwise interleave, and the inner body must not rebind a name the outer one reads
+AstNode* Optimizer::fuseFor(AstNode *node){
+    ForExpr &outer = node->as<ForExpr>();
+    if(outer.expr->type != NodeType::forExpr){
+        return node;
+    }
+    ForExpr &inner = outer.expr->as<ForExpr>();
+    if(!isPure(outer.block) || !isPure(inner.block)){
+        return node;
+    }
+    std::unordered_set<std::string> innerNames;
+    std::unordered_set<std::string> outerNames;
+    collectPatternNames(inner.pattern, innerNames);
+    collectAssignedNames(inner.block, innerNames);
+    collectPatternNames(outer.pattern, outerNames);
+    collectReferencedNames(outer.block, outerNames);
+    for(const std::string &name : innerNames){
+        if(outerNames.count(name)){
+            return node;
+        }
+    }
+    std::vector<AstNode**> slots;
+    collectYieldSlots(&inner.block, slots);
+    for(AstNode **slot : slots){
+        std::vector<AstNode*> body = {
+            new AstNode(NodeType::assignment, Assignment{
+                cloneAst(outer.pattern),
+                new AstNode(NodeType::tupleExpression, TupleExpression{{ *slot }}),
+                {}, {}, {}
+            })
+        };
+        for(AstNode *expr : outer.block->as<Block>().expressions){
+            body.push_back(cloneAst(expr));
+        }
+        *slot = new AstNode(NodeType::block, Block{body, {}, {}});
+    }
+    return outer.expr;
+}
+
+// Turns sequence pipelines into a single loop. `map` and `filter` over pure functions become
+// for-expressions, nested for-expressions are fused, and a for whose elements are consumed one at
+// a time (by a reduction or another for) is marked lazy: no intermediate array is built for it
+AstNode* Optimizer::fuseSequences(AstNode *node){
+    if(node == nullptr){
+        return nullptr;
+    }
+    for(AstNode **child : getChildren(node)){
+        *child = fuseSequences(*child);
+    }
+    const std::string *method = getSequenceMethod(node);
+    if(method && pureFunctions.count(getTarget(node->as<BinaryOperation>().right->as<CallArgsList>().args[0]))){
+        AstNode *receiver = node->as<BinaryOperation>().left->as<BinaryOperation>().left;
+        AstNode *fn = node->as<BinaryOperation>().right->as<CallArgsList>().args[0];
+        std::string item = "$item" + std::to_string(temporaries++);
+        AstNode *call = makeCall(fn, { new AstNode(NodeType::identifier, Identifier{item}) });
+        AstNode *body;
+        if(*method == "map"){
+            body = call;
+        } else {
+            body = new AstNode(NodeType::ifExpr, IfExpr{
+                call,
+                new AstNode(NodeType::block, Block{{ new AstNode(NodeType::identifier, Identifier{item}) }, {}, {}}),
+                {}, {}, nullptr
+            });
+        }
+        node = makeForExpr(new AstNode(NodeType::identifier, Identifier{item}), receiver, { body });
+    }
+    if(node->type == NodeType::forExpr){
+        node = fuseFor(node);
+        // Left unfused, the inner for may still feed the outer one element by element, but
+        // only when neither body has effects that would then interleave
+        AstNode *inner = node->as<ForExpr>().expr;
+        if(inner->type == NodeType::forExpr && isPure(node->as<ForExpr>().block) && isPure(inner->as<ForExpr>().block)){
+            inner->as<ForExpr>().lazy = true;
+        }
+    }
+    if(node->type == NodeType::memberAccess){
+        AstNode *receiver = node->as<BinaryOperation>().left;
+        AstNode *method = node->as<BinaryOperation>().right;
+        if(receiver->type == NodeType::forExpr && method && method->type == NodeType::identifier &&
+            reductionMethods.count(method->as<Identifier>().name)){
+            receiver->as<ForExpr>().lazy = true;
+        }
+    }
+    return node;
+}
@@ -0,0 +1,44 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// Every `receiver.method(args)` call, in tail position too, gets its own method cache slot,
+// every other `receiver.field` a field load cache slot. Slots keep counting across optimize
+// calls, so the REPL's runtime can append the sites of each new input
+void Optimizer::assignInlineCaches(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    if((node->type == NodeType::call || node->type == NodeType::tailCall) &&
+        node->as<BinaryOperation>().left->type == NodeType::memberAccess){
+        AstNode *callee = node->as<BinaryOperation>().left;
+        AstNode *args = node->as<BinaryOperation>().right;
+        AstNode *method = callee->as<BinaryOperation>().right;
+        if(method && method->type == NodeType::identifier && args->as<CallArgsList>().inlineCache < 0){
+            args->as<CallArgsList>().inlineCache = inlineCacheSites.size();
+            inlineCacheSites.push_back(method->as<Identifier>().name);
+        }
+        assignInlineCaches(callee->as<BinaryOperation>().left);
+        assignInlineCaches(args);
+        return;
+    }
+    if(node->type == NodeType::memberAccess){
+        AstNode *field = node->as<BinaryOperation>().right;
+        if(field && field->type == NodeType::identifier && field->as<Identifier>().inlineCache < 0){
+            field->as<Identifier>().inlineCache = fieldCacheSites.size();
+            fieldCacheSites.push_back(field->as<Identifier>().name);
+        }
+        assignInlineCaches(node->as<BinaryOperation>().left);
+        return;
+    }
+    for(AstNode **child : getChildren(node)){
+        assignInlineCaches(*child);
+    }
+}
+
+const std::vector<std::string>& Optimizer::getInlineCacheSites() const {
+    return inlineCacheSites;
+}
+
+const std::vector<std::string>& Optimizer::getFieldCacheSites() const {
+    return fieldCacheSites;
+}
@@ -0,0 +1,235 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// Function bodies costing at most this much are inlined, about a dozen simple operations
+static constexpr size_t inlineMaximumCost = 32;
+
+static bool isLiteral(AstNode *node){
+    return node->type == NodeType::intLiteral || node->type == NodeType::floatLiteral ||
+        node->type == NodeType::boolLiteral || node->type == NodeType::stringLiteral;
+}
+
+static bool containsFunction(AstNode *node){
+    if(node == nullptr){
+        return false;
+    }
+    if(node->type == NodeType::function){
+        return true;
+    }
+    for(AstNode **child : getChildren(node)){
+        if(containsFunction(*child)){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Non-null parameters of a function or arguments of a call, `f()` has a single null one
+static std::vector<AstNode*> getNodes(const std::vector<AstNode*> &nodes){
+    std::vector<AstNode*> result;
+    for(AstNode *node : nodes){
+        if(node){
+            result.push_back(node);
+        }
+    }
+    return result;
+}
+
+// Replaces the identifiers found in `names`, in patterns too. Member names after a '.' are kept
+static AstNode* substitute(AstNode *node, const std::unordered_map<std::string, AstNode*> &names){
+    if(node == nullptr){
+        return nullptr;
+    }
+    if(node->type == NodeType::identifier || node->type == NodeType::typedIdentifier){
+        const std::string &name = node->type == NodeType::identifier ?
+            node->as<Identifier>().name : node->as<TypedIdentifier>().name;
+        auto it = names.find(name);
+        if(it == names.end()){
+            return node;
+        }
+        if(node->type == NodeType::typedIdentifier){
+            node->as<TypedIdentifier>().name = it->second->as<Identifier>().name;
+            return node;
+        }
+        return cloneAst(it->second);
+    }
+    if(node->type == NodeType::memberAccess){
+        node->as<BinaryOperation>().left = substitute(node->as<BinaryOperation>().left, names);
+        return node;
+    }
+    for(AstNode **child : getChildren(node)){
+        *child = substitute(*child, names);
+    }
+    return node;
+}
+
+// An inlined call binds its arguments to fresh `$` names, bound once and never rebound. Once
+// inlining into an inlined body turned one of those arguments into a literal or another `$`
+// name, it is forwarded to the uses, so the constant folding sweep sees the literals
+static AstNode* forwardLiterals(AstNode *node){
+    if(node == nullptr){
+        return nullptr;
+    }
+    for(AstNode **child : getChildren(node)){
+        *child = forwardLiterals(*child);
+    }
+    if(node->type != NodeType::block){
+        return node;
+    }
+    std::vector<AstNode*> &expressions = node->as<Block>().expressions;
+    std::unordered_map<std::string, AstNode*> literals;
+    for(size_t i = 0; i < expressions.size(); i++){
+        AstNode *expr = expressions[i];
+        if(!literals.empty()){
+            expressions[i] = substitute(expr, literals);
+            continue;
+        }
+        if(expr->type != NodeType::assignment || expr->as<Assignment>().lhs->type != NodeType::tuplePattern ||
+            expr->as<Assignment>().rhs->type != NodeType::tupleExpression){
+            continue;
+        }
+        std::vector<AstNode*> &patterns = expr->as<Assignment>().lhs->as<TuplePattern>().children;
+        std::vector<AstNode*> &values = expr->as<Assignment>().rhs->as<TupleExpression>().children;
+        for(size_t j = 0; j < patterns.size() && patterns.size() == values.size();){
+            if(patterns[j]->type == NodeType::identifier && patterns[j]->as<Identifier>().name[0] == '$' &&
+                (isLiteral(values[j]) || (values[j]->type == NodeType::identifier &&
+                values[j]->as<Identifier>().name[0] == '$'))){
+                literals[patterns[j]->as<Identifier>().name] = values[j];
+                patterns.erase(patterns.begin() + j);
+                values.erase(values.begin() + j);
+            } else {
+                j++;
+            }
+        }
+        if(patterns.empty()){
+            expressions.erase(expressions.begin() + i);
+            i--;
+        }
+    }
+    if(!literals.empty() && expressions.size() == 1 && expressions[0]->type != NodeType::assignment){
+        return expressions[0];
+    }
+    return node;
+}
+
+// Small pure functions that can't reach themselves are worth inlining. Purity keeps the
+// rewrite safe: only the arguments are evaluated at the call site, exactly once each
+bool Optimizer::isInlinable(AstNode *fn){
+    AstNode *body = fn->as<Function>().block;
+    if(!pureFunctions.count(fn) || estimateCost(body) > inlineMaximumCost || containsFunction(body)){
+        return false;
+    }
+    std::unordered_set<std::string> names;
+    std::unordered_set<AstNode*> fns;
+    collectFreeNames(body, names, fns);
+    return !fns.count(fn);
+}
+
+// `f(a, b)` becomes a block binding the arguments once, followed by a copy of the body.
+// Parameters and locals of the copy get fresh names, so they can't capture or shadow the
+// caller's names. An argument that folds to a literal is substituted for its parameter instead,
+// the constant folding sweep after inlining can then fold it into the body. `scope` holds the names bound
+// by the enclosing functions and loops, the callee must not read one of them as a global.
+// Only functions whose name has a single definition are inlined, and only when every other
+// name the body reads has at most one, so the copy can't come to mean a different function
+AstNode* Optimizer::inlineCall(AstNode *node, const std::unordered_set<std::string> &scope, const std::string &caller){
+    AstNode *callee = node->as<BinaryOperation>().left;
+    if(callee->type != NodeType::identifier){
+        return node;
+    }
+    const std::string &name = callee->as<Identifier>().name;
+    AstNode *target = getTarget(callee);
+    if(target == nullptr || definitionCounts[name] != 1 || !isInlinable(target)){
+        return node;
+    }
+    Function &fn = target->as<Function>();
+    std::vector<AstNode*> params = getNodes(fn.paramList->as<FnParamList>().params);
+    std::vector<AstNode*> args = getNodes(node->as<BinaryOperation>().right->as<CallArgsList>().args);
+    if(params.size() != args.size()){
+        return node;
+    }
+    std::unordered_set<std::string> locals;
+    for(AstNode *param : params){
+        collectPatternNames(param, locals);
+    }
+    collectBoundNames(fn.block, locals);
+    std::unordered_set<std::string> reads;
+    collectReferencedNames(fn.block, reads);
+    for(const std::string &read : reads){
+        auto it = definitionCounts.find(read);
+        if(!locals.count(read) && (scope.count(read) || (it != definitionCounts.end() && it->second > 1))){
+            return node;
+        }
+    }
+    std::unordered_map<std::string, AstNode*> renames;
+    for(const std::string &local : locals){
+        std::string base = local.substr(local.find_first_not_of('$'));
+        renames[local] = new AstNode(NodeType::identifier, Identifier{"$" + base + std::to_string(temporaries++)});
+    }
+    std::vector<AstNode*> patterns;
+    std::vector<AstNode*> values;
+    for(size_t i = 0; i < params.size(); i++){
+        args[i] = foldConstants(args[i]);
+        if(params[i]->type == NodeType::identifier && isLiteral(args[i])){
+            renames[params[i]->as<Identifier>().name] = args[i];
+        } else {
+            patterns.push_back(substitute(cloneAst(params[i]), renames));
+            values.push_back(args[i]);
+        }
+    }
+    std::vector<AstNode*> expressions;
+    if(!patterns.empty()){
+        expressions.push_back(new AstNode(NodeType::assignment, Assignment{
+            new AstNode(NodeType::tuplePattern, TuplePattern{patterns}),
+            new AstNode(NodeType::tupleExpression, TupleExpression{values}),
+            {}, {}, {}
+        }));
+    }
+    for(AstNode *expr : fn.block->as<Block>().expressions){
+        expressions.push_back(substitute(cloneAst(expr), renames));
+    }
+    inlined.push_back("inlined " + name + " into " + caller + ", cost " + std::to_string(estimateCost(fn.block)));
+    AstNode *block = forwardLiterals(new AstNode(NodeType::block, Block{expressions, {}, {}}));
+    if(block->as<Block>().expressions.size() == 1 && block->as<Block>().expressions[0]->type != NodeType::assignment){
+        return block->as<Block>().expressions[0];
+    }
+    return block;
+}
+
+// Calls are inlined bottom up, the arguments first, and an inlined body is not searched
+// again. A body that itself calls small functions was already rewritten when its own
+// definition came first in the program, otherwise those calls stay
+AstNode* Optimizer::inlineCalls(AstNode *node, std::unordered_set<std::string> &scope, const std::string &caller){
+    if(node == nullptr){
+        return nullptr;
+    }
+    if(node->type == NodeType::function){
+        Function &fn = node->as<Function>();
+        std::unordered_set<std::string> inner = scope;
+        for(AstNode *param : fn.paramList->as<FnParamList>().params){
+            collectPatternNames(param, inner);
+        }
+        collectBoundNames(fn.block, inner);
+        std::string name = fn.name ? fn.name->as<Identifier>().name : caller;
+        fn.block = inlineCalls(fn.block, inner, name);
+        return node;
+    }
+    for(AstNode **child : getChildren(node)){
+        *child = inlineCalls(*child, scope, caller);
+    }
+    if(node->type == NodeType::call){
+        return inlineCall(node, scope, caller);
+    }
+    return node;
+}
+
+AstNode* Optimizer::inlineCalls(AstNode *root){
+    inlined.clear();
+    std::unordered_set<std::string> scope;
+    collectBoundNames(root, scope);
+    return inlineCalls(root, scope, "top level");
+}
+
+const std::vector<std::string>& Optimizer::getInlined() const {
+    return inlined;
+}
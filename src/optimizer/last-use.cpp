@@ -0,0 +1,173 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// Every name a nested function refers to is captured, it stays alive for the whole body
+static void collectCapturedNames(AstNode *node, std::unordered_set<std::string> &names, bool nested){
+    if(node == nullptr){
+        return;
+    }
+    if(nested && node->type == NodeType::identifier){
+        names.insert(node->as<Identifier>().name);
+    }
+    for(AstNode **child : getChildren(node)){
+        collectCapturedNames(*child, names, nested || node->type == NodeType::function);
+    }
+}
+
+static void markLastUse(AstNode*, const std::unordered_set<std::string>&, std::unordered_set<std::string>&);
+
+// Expression i can only drop a name once every other reader of it is done. Earlier inline
+// expressions are, and tasks are submitted in order, so only an earlier task that i doesn't
+// wait for may still be reading it while i runs
+static void markTaskBlock(Block &block, const std::unordered_set<std::string> &locals, std::unordered_set<std::string> &live){
+    size_t count = block.expressions.size();
+    std::vector<std::unordered_set<std::string>> taskReads(count);
+    std::vector<std::vector<bool>> waitsFor(count, std::vector<bool>(count));
+    for(size_t i = 0; i < count; i++){
+        AstNode *expr = block.expressions[i];
+        if(block.spawn[i]){
+            collectReadNames(expr->type == NodeType::assignment ? expr->as<Assignment>().rhs : expr, taskReads[i]);
+        }
+        for(size_t dep : block.dependencies[i]){
+            waitsFor[i][dep] = true;
+            for(size_t j = 0; j < dep; j++){
+                waitsFor[i][j] = waitsFor[i][j] || waitsFor[dep][j];
+            }
+        }
+    }
+    for(size_t i = count; i-- > 0;){
+        std::unordered_set<std::string> concurrent;
+        for(size_t j = 0; j < i; j++){
+            if(block.spawn[j] && !waitsFor[i][j]){
+                for(const std::string &name : taskReads[j]){
+                    if(!live.count(name)){
+                        concurrent.insert(name);
+                    }
+                }
+            }
+        }
+        live.insert(concurrent.begin(), concurrent.end());
+        markLastUse(block.expressions[i], locals, live);
+        // Only kept live for expression i, it says nothing about the ones before it
+        std::unordered_set<std::string> reads;
+        collectReadNames(block.expressions[i], reads);
+        for(const std::string &name : concurrent){
+            if(!reads.count(name)){
+                live.erase(name);
+            }
+        }
+    }
+}
+
+// Walks the node in reverse evaluation order, `live` holds the locals used after it
+static void markLastUse(AstNode *node, const std::unordered_set<std::string> &locals, std::unordered_set<std::string> &live){
+    if(node == nullptr){
+        return;
+    }
+    switch(node->type){
+    case NodeType::identifier:
+    {
+        Identifier &iden = node->as<Identifier>();
+        if(locals.count(iden.name) && !live.count(iden.name)){
+            iden.lastUse = true;
+            live.insert(iden.name);
+        }
+        return;
+    }
+    case NodeType::function:
+        return;
+    case NodeType::assignment:
+    {
+        std::unordered_set<std::string> bound;
+        collectPatternNames(node->as<Assignment>().lhs, bound);
+        for(const std::string &name : bound){
+            live.erase(name);
+        }
+        markLastUse(node->as<Assignment>().rhs, locals, live);
+        return;
+    }
+    case NodeType::memberAccess:
+        markLastUse(node->as<BinaryOperation>().left, locals, live);
+        return;
+    case NodeType::forExpr:
+    {
+        // The body runs once per element, what it reads from outside stays live throughout.
+        // Only its own bindings, rebound every iteration, can die inside it
+        ForExpr &forExpr = node->as<ForExpr>();
+        std::unordered_set<std::string> bound;
+        std::unordered_set<std::string> used;
+        collectPatternNames(forExpr.pattern, bound);
+        collectAssignedNames(forExpr.block, bound);
+        collectCapturedNames(forExpr.block, used, true);
+        for(const std::string &name : used){
+            if(!bound.count(name)){
+                live.insert(name);
+            }
+        }
+        std::unordered_set<std::string> body = live;
+        markLastUse(forExpr.block, locals, body);
+        for(int i = forExpr.hoisted.size() - 1; i >= 0; i--){
+            markLastUse(forExpr.hoisted[i], locals, live);
+        }
+        markLastUse(forExpr.expr, locals, live);
+        return;
+    }
+    case NodeType::ifExpr:
+    {
+        // Only one branch runs, each starts from what is live after the if
+        IfExpr &ifExpr = node->as<IfExpr>();
+        std::vector<AstNode*> conditions = { ifExpr.condition };
+        std::vector<AstNode*> blocks = { ifExpr.ifBlock };
+        conditions.insert(conditions.end(), ifExpr.elifCondition.begin(), ifExpr.elifCondition.end());
+        blocks.insert(blocks.end(), ifExpr.elifBlock.begin(), ifExpr.elifBlock.end());
+        std::unordered_set<std::string> next = live;
+        markLastUse(ifExpr.elseBlock, locals, next);
+        for(int i = conditions.size() - 1; i >= 0; i--){
+            std::unordered_set<std::string> branch = live;
+            markLastUse(blocks[i], locals, branch);
+            branch.insert(next.begin(), next.end());
+            markLastUse(conditions[i], locals, branch);
+            next = branch;
+        }
+        live = next;
+        return;
+    }
+    case NodeType::block:
+        if(!node->as<Block>().spawn.empty()){
+            markTaskBlock(node->as<Block>(), locals, live);
+            return;
+        }
+        [[fallthrough]];
+    default:
+    {
+        std::vector<AstNode**> children = getChildren(node);
+        for(int i = children.size() - 1; i >= 0; i--){
+            markLastUse(*children[i], locals, live);
+        }
+    }
+    }
+}
+
+// Marks every use of a local binding after which the binding is dead. This is where a
+// reference counting runtime would insert its drop: the value is moved instead of copied,
+// so an operation that receives it with a count of one can update it in place.
+// Top-level bindings are globals that later functions or REPL lines may read, they are never marked
+void Optimizer::markLastUses(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::function){
+        Function &func = node->as<Function>();
+        std::unordered_set<std::string> locals;
+        for(AstNode *param : func.paramList->as<FnParamList>().params){
+            collectPatternNames(param, locals);
+        }
+        collectAssignedNames(func.block, locals);
+        std::unordered_set<std::string> live;
+        collectCapturedNames(func.block, live, false);
+        markLastUse(func.block, locals, live);
+    }
+    for(AstNode **child : getChildren(node)){
+        markLastUses(*child);
+    }
+}
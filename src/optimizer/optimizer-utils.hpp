@@ -0,0 +1,324 @@
+#pragma once
+
+#include "../ast/astnode.hpp"
+#include "../ast/operator.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+#include <charconv>
+#include <cmath>
+
+// Built-ins that perform I/O, anything reaching them is not pure
+static std::unordered_set<std::string> effectfulBuiltins = {
+    "input",
+    "print",
+    "println",
+};
+
+// Pointers to every child slot of a node, so passes can rewrite the tree in place
+static std::vector<AstNode**> getChildren(AstNode *node){
+    std::vector<AstNode**> children;
+    if(node == nullptr){
+        return children;
+    }
+    if(isOperator(node->type)){
+        if(isBinaryOperator(node->type)){
+            children.push_back(&node->as<BinaryOperation>().left);
+            children.push_back(&node->as<BinaryOperation>().right);
+        } else {
+            children.push_back(&node->as<UnaryOperation>().expr);
+        }
+        return children;
+    }
+    switch(node->type){
+    case NodeType::identifier:
+    case NodeType::typedIdentifier:
+    case NodeType::intLiteral:
+    case NodeType::floatLiteral:
+    case NodeType::boolLiteral:
+    case NodeType::stringLiteral:
+    break;
+    case NodeType::formatString:
+        for(AstNode *&child : node->as<FormatString>().children){
+            children.push_back(&child);
+        }
+    break;
+    case NodeType::concatenation:
+        for(AstNode *&part : node->as<Concatenation>().parts){
+            children.push_back(&part);
+        }
+    break;
+    case NodeType::stringTemplate:
+        children.push_back(&node->as<StringTemplate>().value);
+        children.push_back(&node->as<StringTemplate>().format);
+    break;
+    case NodeType::fnParamList:
+        for(AstNode *&param : node->as<FnParamList>().params){
+            children.push_back(&param);
+        }
+    break;
+    case NodeType::function:
+        children.push_back(&node->as<Function>().name);
+        children.push_back(&node->as<Function>().paramList);
+        children.push_back(&node->as<Function>().block);
+    break;
+    case NodeType::block:
+        for(AstNode *&expr : node->as<Block>().expressions){
+            children.push_back(&expr);
+        }
+    break;
+    case NodeType::ifExpr:
+        children.push_back(&node->as<IfExpr>().condition);
+        children.push_back(&node->as<IfExpr>().ifBlock);
+        for(int i = 0; i < node->as<IfExpr>().elifBlock.size(); i++){
+            children.push_back(&node->as<IfExpr>().elifCondition[i]);
+            children.push_back(&node->as<IfExpr>().elifBlock[i]);
+        }
+        children.push_back(&node->as<IfExpr>().elseBlock);
+    break;
+    case NodeType::forExpr:
+        children.push_back(&node->as<ForExpr>().pattern);
+        children.push_back(&node->as<ForExpr>().expr);
+        for(AstNode *&binding : node->as<ForExpr>().hoisted){
+            children.push_back(&binding);
+        }
+        children.push_back(&node->as<ForExpr>().block);
+    break;
+    case NodeType::callArgsList:
+        for(AstNode *&arg : node->as<CallArgsList>().args){
+            children.push_back(&arg);
+        }
+    break;
+    case NodeType::arrayLiteral:
+        for(AstNode *&elem : node->as<ArrayLiteral>().elements){
+            children.push_back(&elem);
+        }
+    break;
+    case NodeType::arraySubscript:
+        children.push_back(&node->as<ArraySubscript>().index);
+    break;
+    case NodeType::sliceSubscript:
+        children.push_back(&node->as<SliceSubscript>().start);
+        children.push_back(&node->as<SliceSubscript>().stop);
+        children.push_back(&node->as<SliceSubscript>().step);
+    break;
+    case NodeType::assignment:
+        children.push_back(&node->as<Assignment>().lhs);
+        children.push_back(&node->as<Assignment>().rhs);
+    break;
+    case NodeType::tuplePattern:
+        for(AstNode *&child : node->as<TuplePattern>().children){
+            children.push_back(&child);
+        }
+    break;
+    case NodeType::tupleExpression:
+        for(AstNode *&child : node->as<TupleExpression>().children){
+            children.push_back(&child);
+        }
+    break;
+    default:
+        throw SystemError(std::string("getChildren node type ") +
+            getNodeTypeName(node->type) + " is unimplemented",
+            __FILE_NAME__, __LINE__);
+    }
+    return children;
+}
+
+static AstNode* cloneAst(AstNode *node){
+    if(node == nullptr){
+        return nullptr;
+    }
+    AstNode *returned = new AstNode(*node);
+    for(AstNode **child : getChildren(returned)){
+        *child = cloneAst(*child);
+    }
+    return returned;
+}
+
+static bool isIdentifierNamed(AstNode *node, const std::string &name){
+    return node && node->type == NodeType::identifier && node->as<Identifier>().name == name;
+}
+
+// Counts identifiers referring to `name`, member names after a '.' are not references
+static int countReferences(AstNode *node, const std::string &name){
+    if(node == nullptr){
+        return 0;
+    }
+    if(isIdentifierNamed(node, name)){
+        return 1;
+    }
+    if(node->type == NodeType::memberAccess){
+        return countReferences(node->as<BinaryOperation>().left, name);
+    }
+    int count = 0;
+    for(AstNode **child : getChildren(node)){
+        count += countReferences(*child, name);
+    }
+    return count;
+}
+
+static bool isCallTo(AstNode *node, const std::string &name){
+    return node && (node->type == NodeType::call || node->type == NodeType::tailCall) &&
+        isIdentifierNamed(node->as<BinaryOperation>().left, name);
+}
+
+static AstNode* makeCall(AstNode *callee, const std::vector<AstNode*> &args){
+    return new AstNode(NodeType::call, BinaryOperation{
+        callee,
+        new AstNode(NodeType::callArgsList, CallArgsList{args})
+    });
+}
+
+static AstNode* makeIntLiteral(const Integer &value){
+    return new AstNode(NodeType::intLiteral, IntLiteral{value.toString(), value.toInt(), value});
+}
+
+// Shortest text that reads back to the same double, always with a decimal point
+static AstNode* makeFloatLiteral(double value){
+    char buffer[32];
+    std::to_chars_result res = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    std::string text(buffer, res.ptr);
+    if(text.find_first_of(".e") == std::string::npos){
+        text += ".0";
+    }
+    return new AstNode(NodeType::floatLiteral, FloatLiteral{text, value});
+}
+
+static AstNode* makeBoolLiteral(bool value){
+    return new AstNode(NodeType::boolLiteral, BoolLiteral{value});
+}
+
+static AstNode* makeStringLiteral(const std::string &value){
+    return new AstNode(NodeType::stringLiteral, StringLiteral{value});
+}
+
+static void collectPatternNames(AstNode *pattern, std::unordered_set<std::string> &names){
+    if(pattern == nullptr){
+        return;
+    }
+    if(pattern->type == NodeType::identifier){
+        names.insert(pattern->as<Identifier>().name);
+    } else if(pattern->type == NodeType::typedIdentifier){
+        names.insert(pattern->as<TypedIdentifier>().name);
+    } else if(pattern->type == NodeType::tuplePattern){
+        for(AstNode *child : pattern->as<TuplePattern>().children){
+            collectPatternNames(child, names);
+        }
+    }
+}
+
+// Every identifier under the node, nested functions included
+static void collectReferencedNames(AstNode *node, std::unordered_set<std::string> &names){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::identifier){
+        names.insert(node->as<Identifier>().name);
+    }
+    for(AstNode **child : getChildren(node)){
+        collectReferencedNames(*child, names);
+    }
+}
+
+// Names bound by assignments in a function body, nested functions excluded
+static void collectAssignedNames(AstNode *node, std::unordered_set<std::string> &names){
+    if(node == nullptr || node->type == NodeType::function){
+        return;
+    }
+    if(node->type == NodeType::assignment){
+        collectPatternNames(node->as<Assignment>().lhs, names);
+    }
+    for(AstNode **child : getChildren(node)){
+        collectAssignedNames(*child, names);
+    }
+}
+
+// Names bound inside a scope: assignments and for patterns, nested functions excluded
+static void collectBoundNames(AstNode *node, std::unordered_set<std::string> &names){
+    if(node == nullptr || node->type == NodeType::function){
+        return;
+    }
+    if(node->type == NodeType::assignment){
+        collectPatternNames(node->as<Assignment>().lhs, names);
+    } else if(node->type == NodeType::forExpr){
+        collectPatternNames(node->as<ForExpr>().pattern, names);
+    }
+    for(AstNode **child : getChildren(node)){
+        collectBoundNames(*child, names);
+    }
+}
+
+// Identifiers a node reads, member names after a '.' are not reads
+static void collectReadNames(AstNode *node, std::unordered_set<std::string> &names){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::identifier){
+        names.insert(node->as<Identifier>().name);
+    } else if(node->type == NodeType::memberAccess){
+        collectReadNames(node->as<BinaryOperation>().left, names);
+        return;
+    }
+    for(AstNode **child : getChildren(node)){
+        collectReadNames(*child, names);
+    }
+}
+
+// Flat closure environments: the names a nested function reads, its own nested functions
+// included, that the enclosing functions bind. `enclosing` holds those bindings
+static void collectCaptures(AstNode *node, const std::unordered_set<std::string> &enclosing){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type != NodeType::function){
+        for(AstNode **child : getChildren(node)){
+            collectCaptures(*child, enclosing);
+        }
+        return;
+    }
+    Function &fn = node->as<Function>();
+    std::unordered_set<std::string> own;
+    for(AstNode *param : fn.paramList->as<FnParamList>().params){
+        collectPatternNames(param, own);
+    }
+    collectBoundNames(fn.block, own);
+    std::unordered_set<std::string> reads;
+    collectReadNames(fn.block, reads);
+    fn.captures.clear();
+    for(const std::string &read : reads){
+        if(enclosing.count(read) && !own.count(read)){
+            fn.captures.push_back(read);
+        }
+    }
+    std::sort(fn.captures.begin(), fn.captures.end());
+    std::unordered_set<std::string> inner = enclosing;
+    inner.insert(own.begin(), own.end());
+    collectCaptures(fn.block, inner);
+}
+
+// `name = value`, in the tuple form the parser gives assignments
+static AstNode* makeBinding(const std::string &name, AstNode *value){
+    return new AstNode(NodeType::assignment, Assignment{
+        new AstNode(NodeType::tuplePattern, TuplePattern{{ new AstNode(NodeType::identifier, Identifier{name}) }}),
+        new AstNode(NodeType::tupleExpression, TupleExpression{{ value }}),
+        {}, {}, {}
+    });
+}
+
+// Rough work of evaluating a node once. A call to a user function or a nested loop is
+// assumed to cost a fixed multiple of a simple operation, their sizes aren't known here
+static size_t estimateCost(AstNode *node){
+    if(node == nullptr || node->type == NodeType::function){
+        return 0;
+    }
+    size_t cost = 1;
+    for(AstNode **child : getChildren(node)){
+        cost += estimateCost(*child);
+    }
+    if(node->type == NodeType::call || node->type == NodeType::tailCall){
+        cost += 16;
+    } else if(node->type == NodeType::forExpr){
+        cost *= 64;
+    }
+    return cost;
+}
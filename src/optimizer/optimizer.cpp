@@ -0,0 +1,51 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+#include "../ast/print.hpp"
+
+Optimizer::Optimizer(const OptimizerOptions &options)
+  : options(options)
+{
+}
+
+AstNode* Optimizer::optimize(AstNode *root){
+    root = foldConstants(root);
+    collectFunctions(root);
+    analyzePurity(root);
+    if(options.wholeProgram){
+        removeDeadDefinitions(root);
+        collectFunctions(root);
+    }
+    removeDeadBindings(root);
+    if(options.inlining){
+        root = inlineCalls(root);
+        root = foldConstants(root);
+        collectFunctions(root);
+    }
+    root = fuseSequences(root);
+    collectFunctions(root);
+    shareSubexpressions(root);
+    hoistInvariants(root);
+    if(options.dumpCse){
+        printAst(root);
+    }
+    markParallelLoops(root);
+    scheduleBindings(root);
+    TypeEnv globals;
+    returnTypes.clear();
+    inferType(root, globals);
+    root = fuseConcatenations(root);
+    if(options.memoize){
+        markMemoized(root);
+    }
+    if(options.accumulate){
+        rewriteAccumulators(root);
+        collectFunctions(root);
+    }
+    markTailCalls(root);
+    markLastUses(root);
+    assignInlineCaches(root);
+    compilePatterns(root);
+    analyzeEscapes(root);
+    rememberGlobals(root);
+    return root;
+}
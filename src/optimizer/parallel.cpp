@@ -0,0 +1,21 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// A for whose body is pure has independent iterations, the runtime may split it into
+// chunks over the thread pool. Whether it's worth it depends on the collection size,
+// known only at runtime, so the body cost estimate is recorded along with the flag
+void Optimizer::markParallelLoops(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::forExpr){
+        ForExpr &forExpr = node->as<ForExpr>();
+        if(isPure(forExpr.block)){
+            forExpr.parallel = true;
+            forExpr.cost = estimateCost(forExpr.block);
+        }
+    }
+    for(AstNode **child : getChildren(node)){
+        markParallelLoops(*child);
+    }
+}
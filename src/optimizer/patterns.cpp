@@ -0,0 +1,88 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// `(p)` is p and `(e)` is e, one element parentheses only group
+static AstNode* unwrapPattern(AstNode *pattern){
+    while(pattern->type == NodeType::tuplePattern && pattern->as<TuplePattern>().children.size() == 1){
+        pattern = pattern->as<TuplePattern>().children[0];
+    }
+    return pattern;
+}
+
+static AstNode* unwrapValue(AstNode *value){
+    while(value && value->type == NodeType::tupleExpression && value->as<TupleExpression>().children.size() == 1){
+        value = value->as<TupleExpression>().children[0];
+    }
+    return value;
+}
+
+static void encodeShape(AstNode *pattern, std::vector<uint32_t> &shape){
+    pattern = unwrapPattern(pattern);
+    if(pattern->type != NodeType::tuplePattern){
+        shape.push_back(0);
+        return;
+    }
+    shape.push_back(pattern->as<TuplePattern>().children.size());
+    for(AstNode *child : pattern->as<TuplePattern>().children){
+        encodeShape(child, shape);
+    }
+}
+
+// Loads of every name under `pattern` out of value `index`, reached through `path`
+static void emitLoads(AstNode *pattern, size_t index, std::vector<uint32_t> &path, Assignment &assignment){
+    pattern = unwrapPattern(pattern);
+    if(pattern->type != NodeType::tuplePattern){
+        assignment.loads.push_back({ pattern, index, path });
+        return;
+    }
+    std::vector<AstNode*> &children = pattern->as<TuplePattern>().children;
+    for(uint32_t i = 0; i < children.size(); i++){
+        path.push_back(i);
+        emitLoads(children[i], index, path, assignment);
+        path.pop_back();
+    }
+}
+
+// Pairs the pattern with the right-hand side as deep as both spell out tuples of the same
+// arity. Each name matched to an expression binds its value directly; a subpattern that
+// meets any other expression destructures that expression's value with loads
+static void matchPattern(AstNode *pattern, AstNode *value, Assignment &assignment){
+    pattern = unwrapPattern(pattern);
+    value = unwrapValue(value);
+    if(pattern->type == NodeType::tuplePattern && value && value->type == NodeType::tupleExpression &&
+        value->as<TupleExpression>().children.size() == pattern->as<TuplePattern>().children.size()){
+        std::vector<AstNode*> &patterns = pattern->as<TuplePattern>().children;
+        for(size_t i = 0; i < patterns.size(); i++){
+            matchPattern(patterns[i], value->as<TupleExpression>().children[i], assignment);
+        }
+        return;
+    }
+    size_t index = assignment.values.size();
+    assignment.values.push_back(value);
+    assignment.shapes.emplace_back();
+    if(pattern->type == NodeType::tuplePattern){
+        encodeShape(pattern, assignment.shapes.back());
+    }
+    std::vector<uint32_t> path;
+    emitLoads(pattern, index, path, assignment);
+}
+
+// Compiles every destructuring assignment into direct bindings and flat indexed loads, so
+// `(a, (b, c)) = (x, (y, z))` evaluates x, y and z and binds them with no tuple in between,
+// and `(a, (b, c)) = f()` checks the shape of f's result once, then loads a, b and c by index.
+// Runs last, the plan points into the final tree
+void Optimizer::compilePatterns(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    for(AstNode **child : getChildren(node)){
+        compilePatterns(*child);
+    }
+    if(node->type == NodeType::assignment){
+        Assignment &assignment = node->as<Assignment>();
+        assignment.values.clear();
+        assignment.loads.clear();
+        assignment.shapes.clear();
+        matchPattern(assignment.lhs, assignment.rhs, assignment);
+    }
+}
@@ -0,0 +1,195 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+using FunctionScope = std::unordered_map<std::string, AstNode*>;
+
+// Named functions defined directly in a scope, nested function bodies are scopes of their own
+static void collectDefinitions(AstNode *node, FunctionScope &scope){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::function){
+        if(node->as<Function>().name){
+            // Defined twice in the same scope, which one a call means isn't known statically
+            auto [it, inserted] = scope.try_emplace(node->as<Function>().name->as<Identifier>().name, node);
+            if(!inserted){
+                it->second = nullptr;
+            }
+        }
+        return;
+    }
+    for(AstNode **child : getChildren(node)){
+        collectDefinitions(*child, scope);
+    }
+}
+
+// What each name means in a function body or at the top level. Names the scope binds some
+// other way, by a parameter, an assignment or a for pattern, map to null and hide outer functions
+static FunctionScope makeScope(AstNode *paramList, AstNode *body){
+    FunctionScope scope;
+    collectDefinitions(body, scope);
+    std::unordered_set<std::string> bound;
+    if(paramList){
+        for(AstNode *param : paramList->as<FnParamList>().params){
+            collectPatternNames(param, bound);
+        }
+    }
+    collectBoundNames(body, bound);
+    for(const std::string &name : bound){
+        scope[name] = nullptr;
+    }
+    return scope;
+}
+
+// Resolves every identifier read to the function definition it names, innermost scope first.
+// Member names after a '.' and the names a node binds are not reads
+static void resolveNames(AstNode *node, std::vector<FunctionScope> &scopes, std::unordered_map<AstNode*, AstNode*> &targets){
+    if(node == nullptr){
+        return;
+    }
+    switch(node->type){
+    case NodeType::identifier:
+        for(auto scope = scopes.rbegin(); scope != scopes.rend(); scope++){
+            auto it = scope->find(node->as<Identifier>().name);
+            if(it != scope->end()){
+                if(it->second){
+                    targets[node] = it->second;
+                }
+                return;
+            }
+        }
+    break;
+    case NodeType::function:
+        scopes.push_back(makeScope(node->as<Function>().paramList, node->as<Function>().block));
+        resolveNames(node->as<Function>().block, scopes, targets);
+        scopes.pop_back();
+    break;
+    case NodeType::memberAccess:
+        resolveNames(node->as<BinaryOperation>().left, scopes, targets);
+    break;
+    case NodeType::assignment:
+        resolveNames(node->as<Assignment>().rhs, scopes, targets);
+    break;
+    case NodeType::forExpr:
+        resolveNames(node->as<ForExpr>().expr, scopes, targets);
+        for(AstNode *binding : node->as<ForExpr>().hoisted){
+            resolveNames(binding, scopes, targets);
+        }
+        resolveNames(node->as<ForExpr>().block, scopes, targets);
+    break;
+    default:
+        for(AstNode **child : getChildren(node)){
+            resolveNames(*child, scopes, targets);
+        }
+    }
+}
+
+static void collectFunctionNodes(AstNode *node, std::vector<AstNode*> &functions){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::function && node->as<Function>().name){
+        functions.push_back(node);
+    }
+    for(AstNode **child : getChildren(node)){
+        collectFunctionNodes(*child, functions);
+    }
+}
+
+// Every function is keyed by its definition: nested functions of different bodies may share a
+// name. Passes that clone or build nodes call this again, so the copies are resolved too
+void Optimizer::collectFunctions(AstNode *root){
+    functions.clear();
+    targets.clear();
+    definitionCounts.clear();
+    collectFunctionNodes(root, functions);
+    for(AstNode *fn : functions){
+        definitionCounts[fn->as<Function>().name->as<Identifier>().name]++;
+    }
+    for(auto &[name, fn] : globalFunctions){
+        definitionCounts[name] += fn != nullptr;
+    }
+    std::vector<FunctionScope> scopes = { globalFunctions, makeScope(nullptr, root) };
+    resolveNames(root, scopes, targets);
+}
+
+// A later REPL line sees the functions an earlier one defined, unless it rebinds their names
+void Optimizer::rememberGlobals(AstNode *root){
+    for(auto &[name, fn] : makeScope(nullptr, root)){
+        globalFunctions[name] = fn;
+    }
+}
+
+// The function definition an identifier names, null if it names anything else
+AstNode* Optimizer::getTarget(AstNode *node){
+    auto it = targets.find(node);
+    return it == targets.end() ? nullptr : it->second;
+}
+
+// An expression is pure if it reaches no I/O built-in and only calls pure named functions.
+// Calling anything else by name (a parameter, an unknown global) is assumed impure
+bool Optimizer::isPure(AstNode *node){
+    if(node == nullptr){
+        return true;
+    }
+    if(node->type == NodeType::identifier && effectfulBuiltins.count(node->as<Identifier>().name)){
+        return false;
+    }
+    if(node->type == NodeType::call || node->type == NodeType::tailCall){
+        AstNode *callee = node->as<BinaryOperation>().left;
+        if(callee->type == NodeType::identifier && !pureFunctions.count(getTarget(callee))){
+            return false;
+        }
+    }
+    if(node->type == NodeType::memberAccess){
+        return isPure(node->as<BinaryOperation>().left);
+    }
+    for(AstNode **child : getChildren(node)){
+        if(!isPure(*child)){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Starts by assuming every function is pure and removes the ones that are not
+// until nothing changes, so (mutually) recursive functions stay pure. Functions of
+// earlier REPL lines keep what was found for them
+void Optimizer::analyzePurity(AstNode *root){
+    for(AstNode *fn : functions){
+        pureFunctions.insert(fn);
+    }
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(AstNode *fn : functions){
+            if(pureFunctions.count(fn) && !isPure(fn->as<Function>().block)){
+                pureFunctions.erase(fn);
+                changed = true;
+            }
+        }
+    }
+}
+
+// Only pure recursive functions are memoized, they are the ones whose calls repeat. The cache
+// is keyed on the arguments alone, so neither the function nor one it reaches may be a closure:
+// its result would depend on the captured values too
+void Optimizer::markMemoized(AstNode *root){
+    collectCaptures(root, {});
+    for(AstNode *fn : functions){
+        std::unordered_set<std::string> names;
+        std::unordered_set<AstNode*> fns;
+        collectFreeNames(fn->as<Function>().block, names, fns);
+        if(!pureFunctions.count(fn) || !fns.count(fn)){
+            continue;
+        }
+        bool captures = false;
+        for(AstNode *reached : fns){
+            captures = captures || !reached->as<Function>().captures.empty();
+        }
+        if(!captures){
+            fn->as<Function>().memoized = true;
+            fn->as<Function>().memoCapacity = options.memoCacheSize;
+        }
+    }
+}
@@ -0,0 +1,247 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+enum class AccumulatorOp {
+    none,
+    addition,
+    multiplication,
+    append,
+};
+
+// Collects the slots whose value becomes the function's result.
+// Fails if some path has no value (an if without an else)
+static bool collectTailSlots(AstNode **slot, std::vector<AstNode**> &slots){
+    AstNode *node = *slot;
+    if(node == nullptr){
+        return false;
+    }
+    switch(node->type){
+    case NodeType::block:
+        if(node->as<Block>().expressions.empty()){
+            return false;
+        }
+        return collectTailSlots(&node->as<Block>().expressions.back(), slots);
+    case NodeType::ifExpr:
+    {
+        IfExpr &ifExpr = node->as<IfExpr>();
+        if(!collectTailSlots(&ifExpr.ifBlock, slots)){
+            return false;
+        }
+        for(AstNode *&elifBlock : ifExpr.elifBlock){
+            if(!collectTailSlots(&elifBlock, slots)){
+                return false;
+            }
+        }
+        return collectTailSlots(&ifExpr.elseBlock, slots);
+    }
+    default:
+        slots.push_back(slot);
+        return true;
+    }
+}
+
+static std::vector<AstNode*> getCallArgs(AstNode *call){
+    std::vector<AstNode*> args;
+    for(AstNode *arg : call->as<BinaryOperation>().right->as<CallArgsList>().args){
+        if(arg){
+            args.push_back(arg);
+        }
+    }
+    return args;
+}
+
+// Matches `x + f(..)`, `x * f(..)`, `f(..) * x` and `x.append(f(..))`, returns the call to `name`
+// and points `operand` at the slot of x
+static AstNode* getPendingCall(AstNode *node, const std::string &name, AccumulatorOp &op, AstNode **&operand){
+    if(node->type == NodeType::addition || node->type == NodeType::multiplication){
+        BinaryOperation &binOp = node->as<BinaryOperation>();
+        op = node->type == NodeType::addition ? AccumulatorOp::addition : AccumulatorOp::multiplication;
+        if(isCallTo(binOp.right, name) && countReferences(binOp.left, name) == 0){
+            operand = &binOp.left;
+            return binOp.right;
+        }
+        // Only multiplication commutes, string addition does not
+        if(node->type == NodeType::multiplication && isCallTo(binOp.left, name) && countReferences(binOp.right, name) == 0){
+            operand = &binOp.right;
+            return binOp.left;
+        }
+        return nullptr;
+    }
+    if(node->type == NodeType::call){
+        AstNode *callee = node->as<BinaryOperation>().left;
+        if(callee->type != NodeType::memberAccess || !isIdentifierNamed(callee->as<BinaryOperation>().right, "append")){
+            return nullptr;
+        }
+        std::vector<AstNode*> args = getCallArgs(node);
+        if(args.size() != 1 || !isCallTo(args[0], name) || countReferences(callee, name) != 0){
+            return nullptr;
+        }
+        op = AccumulatorOp::append;
+        operand = &callee->as<BinaryOperation>().left;
+        return args[0];
+    }
+    return nullptr;
+}
+
+static AstNode* combine(AccumulatorOp op, AstNode *acc, AstNode *value){
+    switch(op){
+    case AccumulatorOp::addition:
+        return new AstNode(NodeType::addition, BinaryOperation{acc, value});
+    case AccumulatorOp::multiplication:
+        return new AstNode(NodeType::multiplication, BinaryOperation{acc, value});
+    case AccumulatorOp::append:
+        return makeCall(
+            new AstNode(NodeType::memberAccess, BinaryOperation{
+                acc,
+                new AstNode(NodeType::identifier, Identifier{"append"})
+            }),
+            { value }
+        );
+    default:
+        throw SystemError("combine called without an accumulator operation", __FILE_NAME__, __LINE__);
+    }
+}
+
+static AstNode* makeAccumulatorCall(const std::string &accName, AstNode *call, AstNode *acc){
+    std::vector<AstNode*> args = getCallArgs(call);
+    args.push_back(acc);
+    return makeCall(new AstNode(NodeType::identifier, Identifier{accName}), args);
+}
+
+void Optimizer::markTailPosition(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    switch(node->type){
+    case NodeType::call:
+        node->type = NodeType::tailCall;
+    break;
+    case NodeType::block:
+        if(!node->as<Block>().expressions.empty()){
+            markTailPosition(node->as<Block>().expressions.back());
+        }
+    break;
+    case NodeType::ifExpr:
+        markTailPosition(node->as<IfExpr>().ifBlock);
+        for(AstNode *elifBlock : node->as<IfExpr>().elifBlock){
+            markTailPosition(elifBlock);
+        }
+        markTailPosition(node->as<IfExpr>().elseBlock);
+    break;
+    default:
+    break;
+    }
+}
+
+// Every call whose value is returned directly becomes a tailCall. The runtime must
+// evaluate tailCall by replacing the current frame, not pushing a new one, which keeps
+// self and mutual recursion in tail position at constant stack depth.
+// A memoized function stores its result after the body returns, which a replaced frame
+// never does, so no call of its body is a tail call
+void Optimizer::markTailCalls(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::function && node->as<Function>().memoCapacity == 0){
+        markTailPosition(node->as<Function>().block);
+    }
+    for(AstNode **child : getChildren(node)){
+        markTailCalls(*child);
+    }
+}
+
+void Optimizer::rewriteAccumulators(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    for(AstNode **child : getChildren(node)){
+        rewriteAccumulators(*child);
+    }
+    if(node->type != NodeType::block){
+        return;
+    }
+    std::vector<AstNode*> &expressions = node->as<Block>().expressions;
+    for(int i = 0; i < expressions.size(); i++){
+        if(expressions[i] == nullptr || expressions[i]->type != NodeType::function){
+            continue;
+        }
+        AstNode *accFn = tryAccumulatorRewrite(expressions[i]);
+        if(accFn){
+            expressions.insert(expressions.begin() + i + 1, accFn);
+            i++;
+        }
+    }
+}
+
+// Rewrites linear recursion like
+//     fn f(n): if n > 1: n * f(n - 1) else: 1
+// into accumulator-passing form
+//     fn f(n): if n > 1: f$acc(n - 1, n) else: 1
+//     fn f$acc(n, $acc): if n > 1: f$acc(n - 1, $acc * n) else: $acc * 1
+// The operation only has to be associative, the accumulator is seeded with the first
+// pending operand so no identity value is needed. Returns the new function or nullptr
+AstNode* Optimizer::tryAccumulatorRewrite(AstNode *fn){
+    Function &func = fn->as<Function>();
+    if(func.name == nullptr){
+        return nullptr;
+    }
+    const std::string name = func.name->as<Identifier>().name;
+    std::vector<AstNode**> leaves;
+    if(!collectTailSlots(&func.block, leaves)){
+        return nullptr;
+    }
+    AccumulatorOp op = AccumulatorOp::none;
+    AccumulatorOp leafOp;
+    AstNode **operand;
+    int selfCalls = 0;
+    for(AstNode **leaf : leaves){
+        int refs = countReferences(*leaf, name);
+        if(refs == 0){
+            continue;
+        }
+        if(refs == 1 && isCallTo(*leaf, name)){
+            selfCalls++;
+            continue;
+        }
+        if(refs != 1 || !getPendingCall(*leaf, name, leafOp, operand)){
+            return nullptr;
+        }
+        if(op != AccumulatorOp::none && op != leafOp){
+            return nullptr;
+        }
+        op = leafOp;
+        selfCalls++;
+    }
+    // Any other reference (in a condition, an assignment, a nested function) is not linear recursion
+    if(op == AccumulatorOp::none || countReferences(func.block, name) != selfCalls){
+        return nullptr;
+    }
+
+    const std::string accName = name + "$acc";
+    AstNode *accFn = cloneAst(fn);
+    Function &accFunc = accFn->as<Function>();
+    accFunc.name->as<Identifier>().name = accName;
+    accFunc.paramList->as<FnParamList>().params.push_back(
+        new AstNode(NodeType::identifier, Identifier{"$acc"})
+    );
+    std::vector<AstNode**> accLeaves;
+    collectTailSlots(&accFunc.block, accLeaves);
+    for(AstNode **leaf : accLeaves){
+        AstNode *acc = new AstNode(NodeType::identifier, Identifier{"$acc"});
+        if(countReferences(*leaf, name) == 0){
+            *leaf = combine(op, acc, *leaf);
+        } else if(isCallTo(*leaf, name)){
+            *leaf = makeAccumulatorCall(accName, *leaf, acc);
+        } else {
+            AstNode *call = getPendingCall(*leaf, name, leafOp, operand);
+            *leaf = makeAccumulatorCall(accName, call, combine(op, acc, *operand));
+        }
+    }
+    for(AstNode **leaf : leaves){
+        AstNode *call = getPendingCall(*leaf, name, leafOp, operand);
+        if(call){
+            *leaf = makeAccumulatorCall(accName, call, *operand);
+        }
+    }
+    return accFn;
+}
@@ -0,0 +1,114 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+// Work below this many cost units runs inline, a task handoff would cost more than it saves
+static constexpr size_t taskMinimumCost = 256;
+
+// Names the node reads, including the ones read by the user functions it reaches.
+// `fns` receives every function reached
+void Optimizer::collectFreeNames(AstNode *node, std::unordered_set<std::string> &names, std::unordered_set<AstNode*> &fns){
+    if(node == nullptr){
+        return;
+    }
+    if(node->type == NodeType::identifier){
+        names.insert(node->as<Identifier>().name);
+        AstNode *fn = getTarget(node);
+        if(fn && !fns.count(fn)){
+            fns.insert(fn);
+            collectFreeNames(fn->as<Function>().block, names, fns);
+        }
+    }
+    for(AstNode **child : getChildren(node)){
+        collectFreeNames(*child, names, fns);
+    }
+}
+
+// Large by itself, or reaching a recursive function whose running time the estimate can't bound
+bool Optimizer::isExpensive(AstNode *node){
+    if(estimateCost(node) >= taskMinimumCost){
+        return true;
+    }
+    std::unordered_set<std::string> names;
+    std::unordered_set<AstNode*> fns;
+    collectFreeNames(node, names, fns);
+    for(AstNode *fn : fns){
+        std::unordered_set<std::string> reached;
+        std::unordered_set<AstNode*> calls;
+        collectFreeNames(fn->as<Function>().block, reached, calls);
+        if(calls.count(fn)){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bindings are immutable, so an expression only has to wait for the earlier ones binding
+// a name it reads. Pure expensive expressions of a block become tasks that start as soon as
+// their dependencies are done; everything else runs inline in order. An expression with effects
+// also waits for every task spawned before it: a task that fails first must stop it, as it
+// would in program order. markLastUses keeps a name a task reads alive for the expressions
+// that don't wait for it.
+// Tuple elements never depend on each other, the tuple is parallel when two or more are expensive
+void Optimizer::scheduleBindings(AstNode *node){
+    if(node == nullptr){
+        return;
+    }
+    for(AstNode **child : getChildren(node)){
+        scheduleBindings(*child);
+    }
+    if(node->type == NodeType::tupleExpression){
+        TupleExpression &tuple = node->as<TupleExpression>();
+        int expensive = 0;
+        for(AstNode *child : tuple.children){
+            if(!isPure(child)){
+                return;
+            }
+            expensive += isExpensive(child);
+        }
+        tuple.parallel = expensive >= 2;
+        return;
+    }
+    if(node->type != NodeType::block || node->as<Block>().expressions.size() < 2){
+        return;
+    }
+    Block &block = node->as<Block>();
+    size_t count = block.expressions.size();
+    std::vector<std::unordered_set<std::string>> bound(count);
+    std::vector<std::vector<size_t>> dependencies(count);
+    std::vector<bool> spawn(count);
+    bool anySpawned = false;
+    for(size_t i = 0; i < count; i++){
+        AstNode *expr = block.expressions[i];
+        if(expr->type == NodeType::assignment){
+            collectPatternNames(expr->as<Assignment>().lhs, bound[i]);
+        } else if(expr->type == NodeType::function && expr->as<Function>().name){
+            bound[i].insert(expr->as<Function>().name->as<Identifier>().name);
+        }
+        std::unordered_set<std::string> names;
+        std::unordered_set<AstNode*> fns;
+        collectFreeNames(expr, names, fns);
+        for(size_t j = 0; j < i; j++){
+            for(const std::string &name : bound[j]){
+                if(names.count(name)){
+                    dependencies[i].push_back(j);
+                    break;
+                }
+            }
+        }
+        bool pure = isPure(expr);
+        spawn[i] = expr->type != NodeType::function && pure && isExpensive(expr);
+        anySpawned = anySpawned || spawn[i];
+        if(!pure){
+            for(size_t j = 0; j < i; j++){
+                if(spawn[j] && std::find(dependencies[i].begin(), dependencies[i].end(), j) == dependencies[i].end()){
+                    dependencies[i].push_back(j);
+                }
+            }
+            std::sort(dependencies[i].begin(), dependencies[i].end());
+        }
+    }
+    if(anySpawned){
+        block.dependencies = std::move(dependencies);
+        block.spawn = std::move(spawn);
+    }
+}
@@ -0,0 +1,433 @@
+#include "../include/optimizer.hpp"
+#include "optimizer-utils.hpp"
+
+#include <algorithm>
+
+static std::unordered_map<std::string, ValueType> annotationTypeLookup = {
+    { "int", ValueType::integer },
+    { "float", ValueType::floating },
+    { "bool", ValueType::boolean },
+    { "string", ValueType::string },
+    { "array", ValueType::array },
+};
+
+// Names that aren't built-in types are user types, unknown to the optimizer for now
+static ValueType annotationType(const std::string &name){
+    if(!annotationTypeLookup.count(name)){
+        return ValueType::unknown;
+    }
+    return annotationTypeLookup[name];
+}
+
+static bool isKnown(ValueType type){
+    return type != ValueType::unknown && type != ValueType::unresolved;
+}
+
+static bool isNumeric(ValueType type){
+    return type == ValueType::integer || type == ValueType::floating;
+}
+
+// An int is accepted wherever a float is expected
+static bool isAssignable(ValueType from, ValueType to){
+    return !isKnown(from) || !isKnown(to) || from == to ||
+        (from == ValueType::integer && to == ValueType::floating);
+}
+
+static ValueType joinTypes(ValueType a, ValueType b){
+    if(a == ValueType::unresolved){
+        return b;
+    }
+    if(b == ValueType::unresolved){
+        return a;
+    }
+    return a == b ? a : ValueType::unknown;
+}
+
+static void emitOperandError(NodeType op, ValueType left, ValueType right){
+    throw TypeError(std::string("Operator ") + getNodeTypeName(op) + " can't be applied to " +
+        getValueTypeName(left) + " and " + getValueTypeName(right));
+}
+
+static ValueType binaryResultType(NodeType op, ValueType left, ValueType right){
+    switch(op){
+    case NodeType::conjunction:
+    case NodeType::disjunction:
+        if((isKnown(left) && left != ValueType::boolean) || (isKnown(right) && right != ValueType::boolean)){
+            emitOperandError(op, left, right);
+        }
+        return ValueType::boolean;
+    case NodeType::equality:
+    case NodeType::inequality:
+        if(isKnown(left) && isKnown(right) && left != right && !(isNumeric(left) && isNumeric(right))){
+            emitOperandError(op, left, right);
+        }
+        return ValueType::boolean;
+    case NodeType::lessThan:
+    case NodeType::greaterThan:
+    case NodeType::lessEqual:
+    case NodeType::greaterEqual:
+        if(isKnown(left) && isKnown(right) && !(isNumeric(left) && isNumeric(right)) &&
+            !(left == ValueType::string && right == ValueType::string)){
+            emitOperandError(op, left, right);
+        }
+        return ValueType::boolean;
+    default:
+    break;
+    }
+    if(left == ValueType::unresolved || right == ValueType::unresolved){
+        return ValueType::unresolved;
+    }
+    if(!isKnown(left) || !isKnown(right)){
+        return ValueType::unknown;
+    }
+    if(left == ValueType::integer && right == ValueType::integer){
+        if(op == NodeType::division){
+            return ValueType::unknown;
+        }
+        return op == NodeType::root ? ValueType::floating : ValueType::integer;
+    }
+    if(isNumeric(left) && isNumeric(right)){
+        return ValueType::floating;
+    }
+    if(op == NodeType::addition && left == right && (left == ValueType::string || left == ValueType::array)){
+        return left;
+    }
+    emitOperandError(op, left, right);
+    return ValueType::unknown;
+}
+
+static ValueType methodResultType(ValueType receiver, const std::string &method){
+    bool sequence = receiver == ValueType::string || receiver == ValueType::array;
+    if(method == "length"){
+        return sequence ? ValueType::integer : ValueType::unknown;
+    } else if(method == "toInt"){
+        return ValueType::integer;
+    } else if(method == "toFloat"){
+        return ValueType::floating;
+    } else if(method == "toString" || method == "join"){
+        return ValueType::string;
+    } else if(method == "sort" || method == "sortBy" || method == "append" || method == "reverse"){
+        return sequence ? receiver : ValueType::unknown;
+    }
+    return ValueType::unknown;
+}
+
+// The parser wraps the right-hand side of an assignment in a one element tuple expression,
+// and one element parentheses only group. Returns the slot of the value inside them
+static AstNode** unwrapValue(AstNode **slot){
+    while(*slot && (*slot)->type == NodeType::tupleExpression && (*slot)->as<TupleExpression>().children.size() == 1){
+        slot = &(*slot)->as<TupleExpression>().children[0];
+    }
+    return slot;
+}
+
+// An int given where a float is declared is converted where it is given, so the value
+// has the declared type at runtime too
+static void convertToFloat(AstNode *&value){
+    if(value->type == NodeType::intLiteral && value->as<IntLiteral>().number){
+        value = makeFloatLiteral(*value->as<IntLiteral>().number);
+    } else {
+        value = makeCall(new AstNode(NodeType::memberAccess, BinaryOperation{
+            value,
+            new AstNode(NodeType::identifier, Identifier{"toFloat"})
+        }), {});
+    }
+    value->valueType = ValueType::floating;
+}
+
+// `value` is the slot of the expression the pattern is matched against, if it is known.
+// Names matched to an expression that isn't spelled out as a tuple, like `a, b = t` or
+// `a, b = pair(3)`, are unknown: only the runtime sees the tuple's arity and elements
+void Optimizer::bindPattern(AstNode *pattern, ValueType type, AstNode **value, TypeEnv &env){
+    switch(pattern->type){
+    case NodeType::identifier:
+        env[pattern->as<Identifier>().name] = type;
+        pattern->valueType = type;
+    break;
+    case NodeType::typedIdentifier:
+    {
+        TypedIdentifier &iden = pattern->as<TypedIdentifier>();
+        ValueType declared = annotationType(iden.type);
+        if(!isAssignable(type, declared)){
+            throw TypeError("`" + iden.name + "` is declared as " + iden.type + " but given " + getValueTypeName(type));
+        }
+        if(type == ValueType::integer && declared == ValueType::floating){
+            if(value == nullptr){
+                declared = ValueType::integer;
+            } else {
+                convertToFloat(*unwrapValue(value));
+            }
+        }
+        pattern->valueType = isKnown(declared) ? declared : type;
+        env[iden.name] = pattern->valueType;
+    break;
+    }
+    case NodeType::tuplePattern:
+    {
+        std::vector<AstNode*> &children = pattern->as<TuplePattern>().children;
+        if(children.size() == 1){
+            bindPattern(children[0], type, value, env);
+            break;
+        }
+        AstNode **inner = value ? unwrapValue(value) : nullptr;
+        std::vector<AstNode*> *values = nullptr;
+        if(inner && *inner && (*inner)->type == NodeType::tupleExpression){
+            values = &(*inner)->as<TupleExpression>().children;
+            if(values->size() != children.size()){
+                throw TypeError("Can't unpack " + std::to_string(values->size()) + " values into " +
+                    std::to_string(children.size()) + " names");
+            }
+        } else if(isKnown(type) && type != ValueType::tuple){
+            throw TypeError(std::string("Can't unpack ") + getValueTypeName(type) + " into " +
+                std::to_string(children.size()) + " names");
+        }
+        for(size_t i = 0; i < children.size(); i++){
+            AstNode **child = values ? &(*values)[i] : nullptr;
+            bindPattern(children[i], child ? (*child)->valueType : ValueType::unknown, child, env);
+        }
+    break;
+    }
+    default:
+        throw SystemError(std::string("bindPattern node type ") + getNodeTypeName(pattern->type) +
+            " is not a pattern", __FILE_NAME__, __LINE__);
+    }
+}
+
+// Arity and annotated parameter types are checked against the definition the callee names in
+// the caller's scope. Calls through anything else, a binding or an ambiguous name, aren't checked
+ValueType Optimizer::inferCall(AstNode *node, TypeEnv &env){
+    AstNode *callee = node->as<BinaryOperation>().left;
+    std::vector<AstNode**> args;
+    for(AstNode *&arg : node->as<BinaryOperation>().right->as<CallArgsList>().args){
+        if(arg){
+            inferType(arg, env);
+            args.push_back(&arg);
+        }
+    }
+    if(callee->type == NodeType::memberAccess){
+        ValueType receiver = inferType(callee->as<BinaryOperation>().left, env);
+        AstNode *method = callee->as<BinaryOperation>().right;
+        if(method && method->type == NodeType::identifier){
+            return methodResultType(receiver, method->as<Identifier>().name);
+        }
+        return ValueType::unknown;
+    }
+    AstNode *fn = getTarget(callee);
+    if(fn == nullptr || env.count(callee->as<Identifier>().name)){
+        inferType(callee, env);
+        return ValueType::unknown;
+    }
+    const std::string &name = callee->as<Identifier>().name;
+    callee->valueType = ValueType::function;
+    std::vector<AstNode*> &params = fn->as<Function>().paramList->as<FnParamList>().params;
+    if(params.size() != args.size()){
+        throw TypeError("`" + name + "` expects " + std::to_string(params.size()) + " arguments, got " +
+            std::to_string(args.size()));
+    }
+    for(size_t i = 0; i < params.size(); i++){
+        if(params[i]->type != NodeType::typedIdentifier){
+            continue;
+        }
+        const std::string &declared = params[i]->as<TypedIdentifier>().type;
+        if(!isAssignable((*args[i])->valueType, annotationType(declared))){
+            throw TypeError("Argument " + std::to_string(i + 1) + " of `" + name + "` expects " + declared +
+                ", got " + getValueTypeName((*args[i])->valueType));
+        }
+        if((*args[i])->valueType == ValueType::integer && annotationType(declared) == ValueType::floating){
+            convertToFloat(*args[i]);
+        }
+    }
+    return inferFunction(fn);
+}
+
+// Infers the body with the parameters' annotated types. A recursive call first stands for
+// the function's own yet unknown result (unresolved), the body is then inferred again with
+// the result found, and if that doesn't confirm it the result becomes unknown
+ValueType Optimizer::inferFunction(AstNode *fn){
+    Function &func = fn->as<Function>();
+    fn->valueType = ValueType::function;
+    if(returnTypes.count(fn)){
+        return returnTypes[fn];
+    }
+    if(std::find(inferring.begin(), inferring.end(), fn) != inferring.end()){
+        return inferring.back() == fn ? ValueType::unresolved : ValueType::unknown;
+    }
+    auto inferBody = [&](){
+        TypeEnv env;
+        for(AstNode *param : func.paramList->as<FnParamList>().params){
+            if(param->type == NodeType::typedIdentifier){
+                bindPattern(param, annotationType(param->as<TypedIdentifier>().type), nullptr, env);
+            } else {
+                bindPattern(param, ValueType::unknown, nullptr, env);
+            }
+        }
+        ValueType result = inferType(func.block, env);
+        return result == ValueType::unresolved ? ValueType::unknown : result;
+    };
+    inferring.push_back(fn);
+    ValueType result = inferBody();
+    if(func.name){
+        returnTypes[fn] = result;
+        if(inferBody() != result){
+            result = returnTypes[fn] = ValueType::unknown;
+            inferBody();
+        }
+    }
+    inferring.pop_back();
+    return result;
+}
+
+ValueType Optimizer::inferType(AstNode *node, TypeEnv &env){
+    if(node == nullptr){
+        return ValueType::unknown;
+    }
+    ValueType result = ValueType::unknown;
+    switch(node->type){
+    case NodeType::intLiteral:
+        result = ValueType::integer;
+    break;
+    case NodeType::floatLiteral:
+        result = ValueType::floating;
+    break;
+    case NodeType::boolLiteral:
+        result = ValueType::boolean;
+    break;
+    case NodeType::stringLiteral:
+        result = ValueType::string;
+    break;
+    case NodeType::formatString:
+    case NodeType::concatenation:
+    case NodeType::stringTemplate:
+        for(AstNode **child : getChildren(node)){
+            inferType(*child, env);
+        }
+        result = ValueType::string;
+    break;
+    case NodeType::identifier:
+    {
+        const std::string &name = node->as<Identifier>().name;
+        if(env.count(name)){
+            result = env[name];
+        } else if(getTarget(node)){
+            result = ValueType::function;
+        }
+    break;
+    }
+    case NodeType::arrayLiteral:
+    {
+        ArrayLiteral &array = node->as<ArrayLiteral>();
+        ValueType element = ValueType::unresolved;
+        for(AstNode *elem : array.elements){
+            if(elem){
+                element = joinTypes(element, inferType(elem, env));
+            }
+        }
+        if(element == ValueType::integer || element == ValueType::floating || element == ValueType::boolean){
+            array.elementType = element;
+        }
+        result = ValueType::array;
+    break;
+    }
+    case NodeType::tupleExpression:
+    {
+        std::vector<AstNode*> &children = node->as<TupleExpression>().children;
+        for(AstNode *child : children){
+            inferType(child, env);
+        }
+        result = children.size() == 1 && children[0] ? children[0]->valueType : ValueType::tuple;
+    break;
+    }
+    case NodeType::assignment:
+    {
+        AstNode *&rhs = node->as<Assignment>().rhs;
+        bindPattern(node->as<Assignment>().lhs, inferType(rhs, env), &rhs, env);
+    break;
+    }
+    case NodeType::block:
+        for(AstNode *expr : node->as<Block>().expressions){
+            result = inferType(expr, env);
+        }
+    break;
+    case NodeType::ifExpr:
+    {
+        IfExpr &ifExpr = node->as<IfExpr>();
+        std::vector<AstNode*> conditions = { ifExpr.condition };
+        conditions.insert(conditions.end(), ifExpr.elifCondition.begin(), ifExpr.elifCondition.end());
+        for(AstNode *condition : conditions){
+            ValueType type = inferType(condition, env);
+            if(isKnown(type) && type != ValueType::boolean){
+                throw TypeError(std::string("Condition must be bool, got ") + getValueTypeName(type));
+            }
+        }
+        result = inferType(ifExpr.ifBlock, env);
+        for(AstNode *elifBlock : ifExpr.elifBlock){
+            result = joinTypes(result, inferType(elifBlock, env));
+        }
+        result = ifExpr.elseBlock ? joinTypes(result, inferType(ifExpr.elseBlock, env)) : ValueType::unknown;
+    break;
+    }
+    case NodeType::forExpr:
+    {
+        // The loop variables are only visible in the body
+        ForExpr &forExpr = node->as<ForExpr>();
+        ValueType sequence = inferType(forExpr.expr, env);
+        TypeEnv body = env;
+        bindPattern(forExpr.pattern, sequence == ValueType::string ? ValueType::string : ValueType::unknown, nullptr, body);
+        for(AstNode *binding : forExpr.hoisted){
+            inferType(binding, body);
+        }
+        inferType(forExpr.block, body);
+        result = ValueType::array;
+    break;
+    }
+    case NodeType::function:
+        inferFunction(node);
+        result = ValueType::function;
+    break;
+    case NodeType::call:
+    case NodeType::tailCall:
+        result = inferCall(node, env);
+    break;
+    case NodeType::memberAccess:
+        inferType(node->as<BinaryOperation>().left, env);
+    break;
+    case NodeType::arrayAccess:
+    {
+        // A slice is a sequence of the same kind as the one it's taken from
+        ValueType sequence = inferType(node->as<BinaryOperation>().left, env);
+        bool slice = node->as<BinaryOperation>().right->type == NodeType::sliceSubscript;
+        if(sequence == ValueType::string || (slice && sequence == ValueType::array)){
+            result = sequence;
+        }
+        inferType(node->as<BinaryOperation>().right, env);
+    break;
+    }
+    case NodeType::plusSign:
+    case NodeType::minusSign:
+        result = inferType(node->as<UnaryOperation>().expr, env);
+        if(isKnown(result) && !isNumeric(result)){
+            throw TypeError(std::string("Operator ") + getNodeTypeName(node->type) + " can't be applied to " +
+                getValueTypeName(result));
+        }
+    break;
+    case NodeType::negation:
+        result = inferType(node->as<UnaryOperation>().expr, env);
+        if(isKnown(result) && result != ValueType::boolean){
+            throw TypeError(std::string("Operator negation can't be applied to ") + getValueTypeName(result));
+        }
+        result = ValueType::boolean;
+    break;
+    default:
+        if(isOperator(node->type) && isBinaryOperator(node->type)){
+            ValueType left = inferType(node->as<BinaryOperation>().left, env);
+            ValueType right = inferType(node->as<BinaryOperation>().right, env);
+            result = binaryResultType(node->type, left, right);
+        } else {
+            for(AstNode **child : getChildren(node)){
+                inferType(*child, env);
+            }
+        }
+    }
+    node->valueType = result;
+    return result;
+}
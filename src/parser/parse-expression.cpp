@@ -35,7 +35,30 @@ void Parser::popOperatorStack(std::vector<AstNode*> &operatorNodes, AstNode *&la
     operatorNodes.push_back(newNode);
 }
 
-AstNode* Parser::handleExpression(std::vector<TokenType> delimeters){
+// Gives the last operand to the innermost pending operator and links the rest outward
+void Parser::finishOperatorStack(std::vector<AstNode*> &operatorNodes, AstNode *lastPrimary){
+	if(!operatorNodes.empty() && lastPrimary){
+		AstNode *lastOp = operatorNodes.back();
+		if(isPrefixOperator(lastOp->type)){
+			lastOp->as<UnaryOperation>().expr = lastPrimary;
+		} else if(isBinaryOperator(lastOp->type)){
+			lastOp->as<BinaryOperation>().right = lastPrimary;
+		}
+	}
+	while(operatorNodes.size() >= 2){
+		AstNode *last = operatorNodes.back();
+		AstNode *secLast = operatorNodes.at(operatorNodes.size() - 2);
+		if(isPrefixOperator(secLast->type)){
+			secLast->as<UnaryOperation>().expr = last;
+		} else {
+			secLast->as<BinaryOperation>().right = last;
+		}
+		operatorNodes.pop_back();
+	}
+}
+
+// `statement` is set where a whole statement is parsed, the only place a guard may follow it
+AstNode* Parser::handleExpression(std::vector<TokenType> delimeters, bool statement){
 	//std::cout << "EXP" << std::endl;
 	AstNode *lastPrimary = nullptr;
 	bool prevOperator = false;
@@ -54,26 +77,11 @@ AstNode* Parser::handleExpression(std::vector<TokenType> delimeters){
 		// }
 		// std::cout << std::endl;
 		//std::cout << (std::find(delimeter.begin(), delimeter.end(), curToken.type)) << " " << (delimeter.end()) << std::endl;
-		if(std::find(delimeters.begin(), delimeters.end(), curToken.type) != delimeters.end()){
+		// An if after a complete statement expression starts its guard, see Parser::handleGuard
+		bool isGuard = statement && curToken.type == TokenType::ifKeyword && lastPrimary;
+		if(isGuard || std::find(delimeters.begin(), delimeters.end(), curToken.type) != delimeters.end()){
 			//std::cout << "HEY" << std::endl;
-			if(!operatorNodes.empty() && lastPrimary){
-				AstNode *lastOp = operatorNodes.back();
-				if(isPrefixOperator(lastOp->type)){
-					lastOp->as<UnaryOperation>().expr = lastPrimary;
-				} else if(isBinaryOperator(lastOp->type)){
-					lastOp->as<BinaryOperation>().right = lastPrimary;
-				}
-			}
-			while(operatorNodes.size() >= 2){
-				AstNode *last = operatorNodes.back();
-				AstNode *secLast = operatorNodes.at(operatorNodes.size() - 2);
-				if(isPrefixOperator(secLast->type)){
-					secLast->as<UnaryOperation>().expr = last;
-				} else {
-					secLast->as<BinaryOperation>().right = last;
-				}
-				operatorNodes.pop_back();
-			}
+			finishOperatorStack(operatorNodes, lastPrimary);
 			tokenInd++;
 			break;
 		} else if(isOperator(curToken) && (!lastPrimary || prevOperator)){ // Prefix Operator
@@ -136,8 +144,22 @@ AstNode* Parser::handleExpression(std::vector<TokenType> delimeters){
 			AstNode *func = handleFn();
 			return func;
 		} else if(curToken.type == TokenType::ifKeyword){
+			if(lastPrimary){
+				emitError("Expected an operator before if, a guard only follows a whole statement");
+			}
 			AstNode *expr = handleIf();
 			return expr;
+		} else if(curToken.type == TokenType::forKeyword){
+			lastPrimary = handleFor();
+			prevOperator = false;
+			prevUnary = false;
+			// A method may be chained on the line after the block, like `.join()`
+			if(tryToken(TokenType::dot)){
+				continue;
+			}
+			// The block took the line end with it, the for is the last operand
+			finishOperatorStack(operatorNodes, lastPrimary);
+			break;
 		} else if(curToken.type == TokenType::squareStart){
 			if(lastPrimary){
 				AstNode *accessNode = new AstNode(NodeType::arrayAccess, BinaryOperation{});	
@@ -6,14 +6,11 @@
 
 AstNode* Parser::handleBlock(){
 	AstNode *returned = new AstNode(NodeType::block, Block{});
-	AstNode *assignment = tryAssignment();
-	if(assignment){
-		returned->as<Block>().expressions.push_back(assignment);
-	} else {
-		//std::cout << "FAIL" << std::endl;
-	}
 	while(tokenInd < tokens.size()){
-		AstNode *exp = handleExpression({ TokenType::newline });
+		AstNode *exp = tryAssignment();
+		if(!exp){
+			exp = handleGuard(handleExpression({ TokenType::newline }, true));
+		}
 		returned->as<Block>().expressions.push_back(exp);
 		if(discardToken(TokenType::dedent)){
 			break;
@@ -29,10 +26,16 @@ AstNode* Parser::handleStringTemplate(){
 	//std::cout << getTokenTypeName(getPrevToken().type) << std::endl;
 	if(getPrevToken().type == TokenType::colon){
 		//std::cout << "YES" << std::endl;
-		AstNode *format = handleExpression({ TokenType::curlyEnd });
-		//std::cout << getTokenTypeName(getCurToken().type) << std::endl;
-
-		returned->as<StringTemplate>().format = format;
+		std::string spec;
+		while(getCurToken().type != TokenType::curlyEnd){
+			spec += getCurToken().text;
+			tokenInd++;
+		}
+		tokenInd++;
+		if(!parseFormatSpec(spec, returned->as<StringTemplate>().spec)){
+			emitError("Invalid format specification `" + spec + "`");
+		}
+		returned->as<StringTemplate>().format = new AstNode(NodeType::stringLiteral, StringLiteral{spec});
 	}
 	//printAst(returned);
 	return returned;
@@ -91,6 +94,32 @@ AstNode* Parser::handleIf(){
 	return returned;
 }
 
+AstNode* Parser::handleFor(){
+	AstNode *returned = new AstNode(NodeType::forExpr, ForExpr{});
+	expectToken(TokenType::forKeyword);
+	AstNode *pattern = tryTuplePattern(TokenType::inKeyword);
+	if(!pattern){
+		emitError("Expected a pattern after for");
+	}
+	returned->as<ForExpr>().pattern = pattern;
+	returned->as<ForExpr>().expr = handleExpression({ TokenType::colon });
+	expectToken(TokenType::newline);
+	expectToken(TokenType::indent);
+	returned->as<ForExpr>().block = handleBlock();
+	return returned;
+}
+
+// `value if condition` yields value only when the condition holds, it becomes an if without else
+AstNode* Parser::handleGuard(AstNode *value){
+	if(tokenInd == 0 || getPrevToken().type != TokenType::ifKeyword){
+		return value;
+	}
+	AstNode *returned = new AstNode(NodeType::ifExpr, IfExpr{});
+	returned->as<IfExpr>().condition = handleExpression({ TokenType::newline });
+	returned->as<IfExpr>().ifBlock = new AstNode(NodeType::block, Block{{ value }});
+	return returned;
+}
+
 AstNode* Parser::handleFnParamList(){
 	AstNode *returned = new AstNode(NodeType::fnParamList, FnParamList{});
 	bool usesParen = discardToken(TokenType::parenStart);
@@ -154,8 +183,15 @@ AstNode* Parser::handleCallArgsList(){
 
 AstNode* Parser::handleArraySubscript(){
 	expectToken(TokenType::squareStart);
-	AstNode *returned = new AstNode(NodeType::arraySubscript, ArraySubscript{});
-	returned->as<ArraySubscript>().index = handleExpression({ TokenType::squareEnd });
+	AstNode *index = handleExpression({ TokenType::squareEnd, TokenType::colon });
+	if(getPrevToken().type == TokenType::squareEnd){
+		return new AstNode(NodeType::arraySubscript, ArraySubscript{index});
+	}
+	AstNode *returned = new AstNode(NodeType::sliceSubscript, SliceSubscript{index});
+	returned->as<SliceSubscript>().stop = handleExpression({ TokenType::squareEnd, TokenType::colon });
+	if(getPrevToken().type == TokenType::colon){
+		returned->as<SliceSubscript>().step = handleExpression({ TokenType::squareEnd });
+	}
 	return returned;
 }
 
@@ -258,7 +294,8 @@ AstNode* Parser::tryTupleExpression(TokenType delimeter){
 		} else {
 			child = handleExpression({ delimeter, TokenType::comma, TokenType::newline });
 			returned->as<TupleExpression>().children.push_back(child);
-			if(getPrevToken().type == delimeter) break;
+			// A block-form value like a for ends its line along with its block
+			if(getPrevToken().type == delimeter || getPrevToken().type == TokenType::dedent) break;
 		}
 		discardToken(TokenType::comma);
 	}
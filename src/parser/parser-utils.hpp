@@ -15,6 +15,8 @@ static NodeType tokenToBinaryOperator(TokenType type){
 		return NodeType::division;
 	case TokenType::exponent:
 		return NodeType::exponentiation;
+	case TokenType::root:
+		return NodeType::root;
 	case TokenType::doubleAmpersand:
 		return NodeType::conjunction;
 	case TokenType::doubleBar:
@@ -66,11 +68,18 @@ static AstNode* tokenToPrimary(Token &token){
 	case TokenType::identifier:
 		return new AstNode(NodeType::identifier, Identifier{token.text});
 	case TokenType::intLiteral:
-		return new AstNode(NodeType::intLiteral, IntLiteral{token.text});
+	{
+		Integer value = Integer::parse(token.text);
+		return new AstNode(NodeType::intLiteral, IntLiteral{token.text, value.toInt(), value});
+	}
 	case TokenType::floatLiteral:
 		return new AstNode(NodeType::floatLiteral, FloatLiteral{token.text});
 	case TokenType::string:
-		return new AstNode(NodeType::stringLiteral, StringLiteral{token.text});
+		// Strip the surrounding quotes
+		return new AstNode(NodeType::stringLiteral, StringLiteral{token.text.substr(1, token.text.length() - 2)});
+	case TokenType::trueKeyword:
+	case TokenType::falseKeyword:
+		return new AstNode(NodeType::boolLiteral, BoolLiteral{token.type == TokenType::trueKeyword});
 	case TokenType::formatString:
 		return new AstNode(NodeType::formatString, FormatString{
 			{new AstNode(NodeType::stringLiteral, StringLiteral{token.text})}
@@ -84,6 +93,8 @@ static bool isPrimary(const TokenType type){
     return 
     type == TokenType::intLiteral || 
     type == TokenType::floatLiteral || 
+    type == TokenType::trueKeyword ||
+    type == TokenType::falseKeyword ||
     type == TokenType::string ||
     type == TokenType::identifier ||
 	type == TokenType::formatString;
@@ -120,9 +131,33 @@ static bool isPrimary(NodeType type){
     type == NodeType::identifier ||
     type == NodeType::intLiteral ||
     type == NodeType::floatLiteral ||
+    type == NodeType::boolLiteral ||
     type == NodeType::stringLiteral ||
 	type == NodeType::formatString ||
     type == NodeType::callArgsList ||
-    type == NodeType::arraySubscript;
+    type == NodeType::arraySubscript ||
+    type == NodeType::sliceSubscript;
 }
 
+// Format specification grammar: [<|>][width][.precision], the precision is capped
+// so numbers always fit the runtime's formatting buffer
+static bool parseFormatSpec(const std::string &text, FormatSpec &spec){
+	int i = 0;
+	if(i < text.length() && (text[i] == '<' || text[i] == '>')){
+		spec.align = text[i++];
+	}
+	while(i < text.length() && isdigit(text[i]) && spec.width < 10000){
+		spec.width = spec.width * 10 + (text[i++] - '0');
+	}
+	if(i < text.length() && text[i] == '.'){
+		i++;
+		if(i == text.length()){
+			return false;
+		}
+		spec.precision = 0;
+		while(i < text.length() && isdigit(text[i]) && spec.precision <= 100){
+			spec.precision = spec.precision * 10 + (text[i++] - '0');
+		}
+	}
+	return i == text.length() && spec.precision <= 100;
+}
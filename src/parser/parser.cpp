@@ -9,7 +9,10 @@ AstNode* Parser::handleArrayLiteral(){
 	expectToken(TokenType::squareStart);
 	AstNode *returned = new AstNode(NodeType::arrayLiteral, ArrayLiteral{});
 	while(getPrevToken().type != TokenType::squareEnd){
-		AstNode *elem = handleExpression({ TokenType::comma, TokenType::squareEnd });
+		AstNode *elem = handleExpression({ TokenType::comma, TokenType::squareEnd, TokenType::colon });
+		if(getPrevToken().type == TokenType::colon){
+			emitError("Range literals like `[start : stop : step]` are not supported yet");
+		}
 		returned->as<ArrayLiteral>().elements.push_back(elem);
 		if(getCurToken().type == TokenType::squareEnd){
 			break;
@@ -86,7 +89,7 @@ AstNode* Parser::parse(std::vector<Token> tokenStream){
 			root->as<Block>().expressions.push_back(assignment);
 			continue;
 		}
-		AstNode *exp = handleExpression({ TokenType::newline });	
+		AstNode *exp = handleGuard(handleExpression({ TokenType::newline }, true));
 		root->as<Block>().expressions.push_back(exp);
 	}
 	//std::cout << "Finished parsing" << std::endl;
@@ -0,0 +1,481 @@
+#include "array.hpp"
+#include "kernels.hpp"
+#include "sort.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <typeinfo>
+
+// The storage alternative holding each element kind, in ElementKind order
+static ElementKind elementKindOf(const Element &value){
+    switch(value.index()){
+    case 0:
+        return ElementKind::integer;
+    case 1:
+        return ElementKind::floating;
+    case 2:
+        return ElementKind::boolean;
+    case 3:
+        return ElementKind::byte;
+    default:
+        return ElementKind::generic;
+    }
+}
+
+static void dupElement(const Element &value){
+    if(std::holds_alternative<Object*>(value)){
+        dup(std::get<Object*>(value));
+    }
+}
+
+static void dropElement(const Element &value){
+    if(std::holds_alternative<Object*>(value)){
+        drop(std::get<Object*>(value));
+    }
+}
+
+Array::Array(std::vector<int64_t> elements)
+  : storage(std::move(elements))
+{
+}
+
+Array::Array(std::vector<double> elements)
+  : storage(std::move(elements))
+{
+}
+
+Array::Array(std::vector<char> elements)
+  : storage(std::move(elements))
+{
+}
+
+Array::Array(const Array &other)
+  : Object(other), storage(other.storage)
+{
+    if(kind() == ElementKind::generic){
+        for(const Element &value : std::get<std::vector<Element>>(storage)){
+            dupElement(value);
+        }
+    }
+}
+
+Array::~Array(){
+    if(kind() == ElementKind::generic){
+        for(const Element &value : std::get<std::vector<Element>>(storage)){
+            dropElement(value);
+        }
+    }
+}
+
+ElementKind Array::kind() const {
+    return static_cast<ElementKind>(storage.index());
+}
+
+size_t Array::size() const {
+    return std::visit([](const auto &elements) -> size_t {
+        if constexpr(std::is_same_v<std::decay_t<decltype(elements)>, std::monostate>){
+            return 0;
+        } else {
+            return elements.size();
+        }
+    }, storage);
+}
+
+Element Array::get(size_t i) const {
+    switch(kind()){
+    case ElementKind::integer:
+        return std::get<std::vector<int64_t>>(storage)[i];
+    case ElementKind::floating:
+        return std::get<std::vector<double>>(storage)[i];
+    case ElementKind::boolean:
+        return std::get<std::vector<uint8_t>>(storage)[i] != 0;
+    case ElementKind::byte:
+        return std::get<std::vector<char>>(storage)[i];
+    case ElementKind::generic:
+        return std::get<std::vector<Element>>(storage)[i];
+    default:
+        throw SystemError("Array::get on an empty array", __FILE_NAME__, __LINE__);
+    }
+}
+
+bool Array::fits(const Element &value) const {
+    return kind() == ElementKind::generic || elementKindOf(value) == kind();
+}
+
+void Array::widen(){
+    std::vector<Element> elements;
+    elements.reserve(size());
+    for(size_t i = 0; i < size(); i++){
+        elements.push_back(get(i));
+    }
+    storage = std::move(elements);
+}
+
+void Array::set(size_t i, const Element &value){
+    if(!fits(value)){
+        widen();
+    }
+    switch(kind()){
+    case ElementKind::integer:
+        std::get<std::vector<int64_t>>(storage)[i] = std::get<int64_t>(value);
+    break;
+    case ElementKind::floating:
+        std::get<std::vector<double>>(storage)[i] = std::get<double>(value);
+    break;
+    case ElementKind::boolean:
+        std::get<std::vector<uint8_t>>(storage)[i] = std::get<bool>(value);
+    break;
+    case ElementKind::byte:
+        std::get<std::vector<char>>(storage)[i] = std::get<char>(value);
+    break;
+    default:
+    {
+        Element &slot = std::get<std::vector<Element>>(storage)[i];
+        dupElement(value);
+        dropElement(slot);
+        slot = value;
+    }
+    }
+}
+
+// The first element pushed into an empty array picks its storage
+void Array::push(const Element &value){
+    if(kind() == ElementKind::empty){
+        switch(elementKindOf(value)){
+        case ElementKind::integer:
+            storage = std::vector<int64_t>();
+        break;
+        case ElementKind::floating:
+            storage = std::vector<double>();
+        break;
+        case ElementKind::boolean:
+            storage = std::vector<uint8_t>();
+        break;
+        case ElementKind::byte:
+            storage = std::vector<char>();
+        break;
+        default:
+            storage = std::vector<Element>();
+        }
+    } else if(!fits(value)){
+        widen();
+    }
+    switch(kind()){
+    case ElementKind::integer:
+        std::get<std::vector<int64_t>>(storage).push_back(std::get<int64_t>(value));
+    break;
+    case ElementKind::floating:
+        std::get<std::vector<double>>(storage).push_back(std::get<double>(value));
+    break;
+    case ElementKind::boolean:
+        std::get<std::vector<uint8_t>>(storage).push_back(std::get<bool>(value));
+    break;
+    case ElementKind::byte:
+        std::get<std::vector<char>>(storage).push_back(std::get<char>(value));
+    break;
+    default:
+        dupElement(value);
+        std::get<std::vector<Element>>(storage).push_back(value);
+    }
+}
+
+void Array::reserve(size_t capacity){
+    std::visit([capacity](auto &elements){
+        if constexpr(!std::is_same_v<std::decay_t<decltype(elements)>, std::monostate>){
+            elements.reserve(capacity);
+        }
+    }, storage);
+}
+
+void Array::trace(const Tracer &tracer){
+    if(kind() == ElementKind::generic){
+        for(Element &value : std::get<std::vector<Element>>(storage)){
+            if(std::holds_alternative<Object*>(value)){
+                tracer(std::get<Object*>(value));
+            }
+        }
+    }
+}
+
+std::span<const int64_t> Array::ints() const {
+    if(kind() != ElementKind::integer){
+        return {};
+    }
+    return std::get<std::vector<int64_t>>(storage);
+}
+
+std::span<const double> Array::floats() const {
+    if(kind() != ElementKind::floating){
+        return {};
+    }
+    return std::get<std::vector<double>>(storage);
+}
+
+std::span<const char> Array::bytes() const {
+    if(kind() != ElementKind::byte){
+        return {};
+    }
+    return std::get<std::vector<char>>(storage);
+}
+
+Array Array::reversed() const {
+    Array result;
+    switch(kind()){
+    case ElementKind::integer:
+    case ElementKind::floating:
+    {
+        // Ints and doubles are both moved as 64-bit words
+        const uint64_t *src = kind() == ElementKind::integer ?
+            reinterpret_cast<const uint64_t*>(ints().data()) : reinterpret_cast<const uint64_t*>(floats().data());
+        std::vector<uint64_t> words(size());
+        reverseWords(src, words.data(), size());
+        if(kind() == ElementKind::integer){
+            std::vector<int64_t> elements(size());
+            std::memcpy(elements.data(), words.data(), size() * sizeof(int64_t));
+            result.storage = std::move(elements);
+        } else {
+            std::vector<double> elements(size());
+            std::memcpy(elements.data(), words.data(), size() * sizeof(double));
+            result.storage = std::move(elements);
+        }
+    break;
+    }
+    case ElementKind::byte:
+    {
+        std::vector<char> elements(size());
+        reverseBytes(bytes().data(), elements.data(), size());
+        result.storage = std::move(elements);
+    break;
+    }
+    default:
+        result.reserve(size());
+        for(size_t i = size(); i-- > 0;){
+            result.push(get(i));
+        }
+    }
+    return result;
+}
+
+size_t Array::indexOf(const Element &value) const {
+    if(kind() == ElementKind::integer && std::holds_alternative<int64_t>(value)){
+        return indexOfInt(ints().data(), size(), std::get<int64_t>(value));
+    }
+    if(kind() == ElementKind::byte && std::holds_alternative<char>(value)){
+        return indexOfByte(bytes().data(), size(), std::get<char>(value));
+    }
+    for(size_t i = 0; i < size(); i++){
+        if(get(i) == value){
+            return i;
+        }
+    }
+    return size();
+}
+
+Element Array::sum() const {
+    if(kind() == ElementKind::integer){
+        int64_t result;
+        if(!sumInts(ints().data(), size(), result)){
+            throw RuntimeError("Integer overflow in sum");
+        }
+        return result;
+    }
+    if(kind() == ElementKind::floating){
+        return sumFloats(floats().data(), size());
+    }
+    if(kind() == ElementKind::empty){
+        return int64_t(0);
+    }
+    throw RuntimeError("sum needs an array of numbers");
+}
+
+Element Array::min() const {
+    if(size() == 0){
+        throw RuntimeError("min of an empty array");
+    }
+    if(kind() == ElementKind::integer){
+        return minInts(ints().data(), size());
+    }
+    if(kind() == ElementKind::floating){
+        return minFloats(floats().data(), size());
+    }
+    throw RuntimeError("min needs an array of numbers");
+}
+
+Element Array::max() const {
+    if(size() == 0){
+        throw RuntimeError("max of an empty array");
+    }
+    if(kind() == ElementKind::integer){
+        return maxInts(ints().data(), size());
+    }
+    if(kind() == ElementKind::floating){
+        return maxFloats(floats().data(), size());
+    }
+    throw RuntimeError("max needs an array of numbers");
+}
+
+// Objects compare by identity until runtime values define their own equality
+bool Array::operator==(const Array &other) const {
+    if(size() != other.size()){
+        return false;
+    }
+    if(kind() == other.kind()){
+        switch(kind()){
+        case ElementKind::integer:
+            return bytesEqual(reinterpret_cast<const char*>(ints().data()),
+                reinterpret_cast<const char*>(other.ints().data()), size() * sizeof(int64_t));
+        case ElementKind::byte:
+            return bytesEqual(bytes().data(), other.bytes().data(), size());
+        default:
+        break;
+        }
+    }
+    for(size_t i = 0; i < size(); i++){
+        if(get(i) != other.get(i)){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Equal values put the int first, so 0 < -0.0 < 0.0 stays a strict weak order
+static std::weak_ordering compareIntFloat(int64_t a, double b){
+    if(std::isnan(b)){
+        return std::signbit(b) ? std::weak_ordering::greater : std::weak_ordering::less;
+    }
+    // 2^63 is exact as a double, every double in between truncates to an int64_t
+    if(b >= 0x1p63){
+        return std::weak_ordering::less;
+    }
+    if(b < -0x1p63){
+        return std::weak_ordering::greater;
+    }
+    double whole = std::trunc(b);
+    if(int64_t(whole) != a){
+        return a <=> int64_t(whole);
+    }
+    return b < whole ? std::weak_ordering::greater : std::weak_ordering::less;
+}
+
+// Total order for sort. Ints and floats compare by value, floats totally so NaNs sort
+// consistently. Other values of different types order by type: numbers, bools, bytes,
+// then objects. Objects order through Object::compare, which throws for two objects of
+// different or unordered types
+static std::weak_ordering compareElements(const Element &a, const Element &b){
+    if(std::holds_alternative<int64_t>(a) && std::holds_alternative<double>(b)){
+        return compareIntFloat(std::get<int64_t>(a), std::get<double>(b));
+    }
+    if(std::holds_alternative<double>(a) && std::holds_alternative<int64_t>(b)){
+        return 0 <=> compareIntFloat(std::get<int64_t>(b), std::get<double>(a));
+    }
+    if(a.index() != b.index()){
+        return a.index() <=> b.index();
+    }
+    switch(a.index()){
+    case 0:
+        return std::get<int64_t>(a) <=> std::get<int64_t>(b);
+    case 1:
+        return floatSortKey(std::get<double>(a)) <=> floatSortKey(std::get<double>(b));
+    case 2:
+        return std::get<bool>(a) <=> std::get<bool>(b);
+    case 3:
+        return static_cast<unsigned char>(std::get<char>(a)) <=> static_cast<unsigned char>(std::get<char>(b));
+    default:
+    {
+        const Object *x = std::get<Object*>(a);
+        const Object *y = std::get<Object*>(b);
+        if(typeid(*x) != typeid(*y)){
+            throw RuntimeError("Can't order values of different types");
+        }
+        return x->compare(*y);
+    }
+    }
+}
+
+static bool lessElements(const Element &a, const Element &b){
+    return compareElements(a, b) < 0;
+}
+
+// Lexicographic, a prefix comes first
+std::weak_ordering Array::compare(const Object &other) const {
+    const Array &b = static_cast<const Array&>(other);
+    for(size_t i = 0; i < size() && i < b.size(); i++){
+        std::weak_ordering order = compareElements(get(i), b.get(i));
+        if(order != 0){
+            return order;
+        }
+    }
+    return size() <=> b.size();
+}
+
+template<typename T, typename Less>
+static void sortElements(std::vector<T> &elements, Less less){
+    ThreadPool &pool = ThreadPool::global();
+    if(elements.size() >= parallelSortMinimum && pool.size() > 1){
+        parallelMergeSort(elements.data(), elements.size(), less, pool, [&less](T *chunk, size_t size){
+            pdqSort(chunk, chunk + size, less);
+        });
+    } else {
+        pdqSort(elements.begin(), elements.end(), less);
+    }
+}
+
+// Native storage is sorted by counting or radix sort, boxed elements like sortedBy
+Array Array::sorted() const {
+    Array result(*this);
+    switch(kind()){
+    case ElementKind::integer:
+    {
+        std::vector<int64_t> &elements = std::get<std::vector<int64_t>>(result.storage);
+        sortInts(elements.data(), elements.size());
+    break;
+    }
+    case ElementKind::floating:
+    {
+        std::vector<double> &elements = std::get<std::vector<double>>(result.storage);
+        sortFloats(elements.data(), elements.size());
+    break;
+    }
+    case ElementKind::boolean:
+    {
+        std::vector<uint8_t> &elements = std::get<std::vector<uint8_t>>(result.storage);
+        sortBytes(reinterpret_cast<char*>(elements.data()), elements.size());
+    break;
+    }
+    case ElementKind::byte:
+    {
+        std::vector<char> &elements = std::get<std::vector<char>>(result.storage);
+        sortBytes(elements.data(), elements.size());
+    break;
+    }
+    case ElementKind::generic:
+        // Equal strings or arrays are still distinct objects, keep them in order
+        return sortedBy([](const Element &value){
+            return value;
+        });
+    default:
+    break;
+    }
+    return result;
+}
+
+// Decorate, sort, undecorate. Ties on the key are broken by position, which makes it stable
+Array Array::sortedBy(const std::function<Element(const Element&)> &key) const {
+    std::vector<std::pair<Element, size_t>> decorated;
+    decorated.reserve(size());
+    for(size_t i = 0; i < size(); i++){
+        decorated.emplace_back(key(get(i)), i);
+    }
+    sortElements(decorated, [](const std::pair<Element, size_t> &a, const std::pair<Element, size_t> &b){
+        if(lessElements(a.first, b.first)){
+            return true;
+        }
+        return !lessElements(b.first, a.first) && a.second < b.second;
+    });
+    Array result;
+    result.reserve(size());
+    for(const auto &[value, index] : decorated){
+        result.push(get(index));
+    }
+    return result;
+}
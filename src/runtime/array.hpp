@@ -0,0 +1,75 @@
+#pragma once
+
+#include "object.hpp"
+
+#include <span>
+#include <variant>
+
+enum class ElementKind {
+    empty,
+    integer,
+    floating,
+    boolean,
+    byte,
+    generic
+};
+
+// A single array element as handed in and out of Array. Objects are borrowed, the array
+// takes its own reference when it stores one. A string element is its StringData, so a
+// short string in an array costs an allocation the inline String avoids
+using Element = std::variant<int64_t, double, bool, char, Object*>;
+
+// Runtime array. Arrays whose elements all have the same primitive type keep them in a
+// contiguous native buffer, 8 bytes per int instead of a pointer and a heap object.
+// Storing an element of any other type widens the array once to boxed Elements.
+// Built-ins check kind() and run the SIMD kernels on the native buffer
+struct Array : public Object {
+private:
+    std::variant<
+        std::monostate,
+        std::vector<int64_t>,
+        std::vector<double>,
+        std::vector<uint8_t>,
+        std::vector<char>,
+        std::vector<Element>
+    > storage;
+
+    void widen();
+    bool fits(const Element&) const;
+public:
+    Array() = default;
+    Array(std::vector<int64_t>);
+    Array(std::vector<double>);
+    Array(std::vector<char>);
+    Array(const Array&);
+    Array& operator=(const Array&) = delete;
+    ~Array();
+
+    ElementKind kind() const;
+    size_t size() const;
+    Element get(size_t) const;
+    void set(size_t, const Element&);
+    void push(const Element&);
+    void reserve(size_t);
+    void trace(const Tracer&) override;
+
+    // Native buffers, empty unless kind() matches
+    std::span<const int64_t> ints() const;
+    std::span<const double> floats() const;
+    std::span<const char> bytes() const;
+
+    Array reversed() const;
+    // Returns size() when the element isn't found
+    size_t indexOf(const Element&) const;
+    // Sum, min and max of int or float arrays, throw RuntimeError for other kinds
+    Element sum() const;
+    Element min() const;
+    Element max() const;
+    bool operator==(const Array&) const;
+    // Lexicographic by the element order of sorted()
+    std::weak_ordering compare(const Object&) const override;
+    // See sort.hpp for the algorithms and their stability
+    Array sorted() const;
+    // Calls `key` once per element and sorts by the results, stable
+    Array sortedBy(const std::function<Element(const Element&)>&) const;
+};
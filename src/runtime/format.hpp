@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../include/utils.hpp"
+#include "../ast/astnode.hpp"
+#include "integer.hpp"
+#include "number.hpp"
+
+#include <charconv>
+#include <string_view>
+#include <variant>
+
+// Evaluated template values handed to renderFormatString, in template order. An int that
+// doesn't fit in 64 bits is passed as its Integer.
+// Nothing evaluates format strings yet, bench/format-string.cpp calls this directly
+using FormatValue = std::variant<long long, double, bool, std::string_view, const Integer*>;
+
+// Large enough for any double in fixed notation with the parser's maximum precision of 100
+static constexpr int formatBufferSize = 512;
+
+// Writes the unpadded text of a value to `out`, returns its length
+static size_t writeFormatValue(char *out, char *end, const FormatValue &value, const FormatSpec &spec){
+    std::to_chars_result res;
+    switch(value.index()){
+    case 0:
+        return writeInt(out, std::get<long long>(value)) - out;
+    case 1:
+        if(spec.precision >= 0){
+            res = std::to_chars(out, end, std::get<double>(value),
+                std::chars_format::fixed, spec.precision);
+            return res.ptr - out;
+        }
+        return writeFloat(out, std::get<double>(value)) - out;
+    case 2:
+        if(std::get<bool>(value)){
+            std::char_traits<char>::copy(out, "true", 4);
+            return 4;
+        }
+        std::char_traits<char>::copy(out, "false", 5);
+        return 5;
+    case 3:
+    {
+        std::string_view str = std::get<std::string_view>(value);
+        if(spec.precision >= 0 && str.length() > spec.precision){
+            str = str.substr(0, spec.precision);
+        }
+        std::char_traits<char>::copy(out, str.data(), str.length());
+        return str.length();
+    }
+    default:
+    {
+        std::string text = std::get<const Integer*>(value)->toString();
+        std::char_traits<char>::copy(out, text.data(), text.length());
+        return text.length();
+    }
+    }
+}
+
+static size_t measureFormatValue(const FormatValue &value, const FormatSpec &spec){
+    if(std::holds_alternative<std::string_view>(value)){
+        size_t length = std::get<std::string_view>(value).length();
+        return spec.precision >= 0 && length > spec.precision ? spec.precision : length;
+    }
+    if(std::holds_alternative<long long>(value)){
+        long long number = std::get<long long>(value);
+        return (number < 0) + decimalLength(number < 0 ? 0 - static_cast<unsigned long long>(number) : number);
+    }
+    // Any length, it doesn't fit the buffer
+    if(std::holds_alternative<const Integer*>(value)){
+        return std::get<const Integer*>(value)->toString().length();
+    }
+    char buffer[formatBufferSize];
+    return writeFormatValue(buffer, buffer + formatBufferSize, value, spec);
+}
+
+// Renders a format string compiled by the optimizer. The output size is computed
+// first, then every literal segment and value is written straight into the one result buffer
+static std::string renderFormatString(AstNode *node, const std::vector<FormatValue> &values){
+    FormatString &format = node->as<FormatString>();
+    size_t total = format.literalLength;
+    for(int i = 0; i < values.size(); i++){
+        const FormatSpec &spec = format.children[2 * i + 1]->as<StringTemplate>().spec;
+        total += std::max<size_t>(spec.width, measureFormatValue(values[i], spec));
+    }
+    std::string result(total, ' ');
+    char *out = result.data();
+    char *end = out + total;
+    for(int i = 0; i < format.children.size(); i++){
+        if(i % 2 == 0){
+            const std::string &literal = format.children[i]->as<StringLiteral>().value;
+            std::char_traits<char>::copy(out, literal.data(), literal.length());
+            out += literal.length();
+            continue;
+        }
+        const FormatValue &value = values[i / 2];
+        const FormatSpec &spec = format.children[i]->as<StringTemplate>().spec;
+        size_t length = writeFormatValue(out, end, value, spec);
+        size_t padding = spec.width > length ? spec.width - length : 0;
+        char align = spec.align ? spec.align : (std::holds_alternative<std::string_view>(value) ? '<' : '>');
+        if(align == '>' && padding){
+            std::char_traits<char>::move(out + padding, out, length);
+            std::char_traits<char>::assign(out, padding, ' ');
+        }
+        out += length + padding;
+    }
+    return result;
+}
@@ -0,0 +1,177 @@
+#include "heap.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+Heap::Heap(size_t nurserySize){
+    nurseryStart = static_cast<char*>(::operator new(nurserySize, std::align_val_t(headerSize)));
+    nurseryEnd = nurseryStart + nurserySize;
+    top = nurseryStart;
+}
+
+Heap::~Heap(){
+    for(char *cur = nurseryStart; cur < top; cur += *reinterpret_cast<size_t*>(cur)){
+        reinterpret_cast<Object*>(cur + headerSize)->~Object();
+    }
+    for(Object *obj : oldObjects){
+        delete obj;
+    }
+    ::operator delete(nurseryStart, std::align_val_t(headerSize));
+}
+
+Heap& Heap::current(){
+    static thread_local Heap heap;
+    return heap;
+}
+
+// Every nursery allocation is preceded by its total size so the nursery can be walked
+size_t Heap::allocationSize(size_t size){
+    return headerSize + (size + headerSize - 1) / headerSize * headerSize;
+}
+
+// Returns nullptr when the object doesn't fit in what is left of the nursery, it then goes
+// to old space. Never collects, the arguments the object is built from must stay valid
+char* Heap::allocateRaw(size_t size){
+    size_t total = allocationSize(size);
+    if(total > static_cast<size_t>(nurseryEnd - top)){
+        return nullptr;
+    }
+    char *memory = top;
+    top += total;
+    *reinterpret_cast<size_t*>(memory) = total;
+    return memory + headerSize;
+}
+
+void Heap::addRoot(Object **slot){
+    roots.push_back(slot);
+}
+
+void Heap::removeRoot(Object **slot){
+    roots.erase(std::find(roots.begin(), roots.end(), slot));
+}
+
+void Heap::addRootSet(std::vector<Object*> *slots){
+    rootSets.push_back(slots);
+}
+
+void Heap::removeRootSet(std::vector<Object*> *slots){
+    rootSets.erase(std::find(rootSets.begin(), rootSets.end(), slots));
+}
+
+void Heap::writeBarrier(Object *obj){
+    if(!obj->young && !obj->remembered){
+        obj->remembered = true;
+        rememberedSet.push_back(obj);
+    }
+}
+
+bool Heap::fitsNursery(size_t size) const {
+    return allocationSize(size) <= static_cast<size_t>(nurseryEnd - nurseryStart);
+}
+
+// The nursery is full. `obj` was just allocated in its place and has no root yet
+void Heap::collectMinorKeeping(Object *obj){
+    addRoot(&obj);
+    collectMinor();
+    removeRoot(&obj);
+}
+
+size_t Heap::nurseryUsed() const {
+    return top - nurseryStart;
+}
+
+void Heap::visitRoots(const Tracer &visit){
+    for(Object **slot : roots){
+        visit(*slot);
+    }
+    for(std::vector<Object*> *slots : rootSets){
+        for(Object *&slot : *slots){
+            visit(slot);
+        }
+    }
+}
+
+void Heap::recordPause(double ms){
+    stats.totalPauseMs += ms;
+    stats.maxPauseMs = std::max(stats.maxPauseMs, ms);
+}
+
+void Heap::collectMinor(){
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Object*> worklist;
+    Tracer evacuate = [&](Object *&slot){
+        if(slot == nullptr || !slot->young){
+            return;
+        }
+        if(slot->forward == nullptr){
+            Object *moved = slot->promote();
+            moved->refCount = slot->refCount.load();
+            moved->managed = true;
+            slot->forward = moved;
+            oldObjects.push_back(moved);
+            worklist.push_back(moved);
+            stats.promotedObjects++;
+        }
+        slot = slot->forward;
+    };
+    visitRoots(evacuate);
+    for(Object *obj : rememberedSet){
+        obj->remembered = false;
+        obj->trace(evacuate);
+    }
+    rememberedSet.clear();
+    while(!worklist.empty()){
+        Object *obj = worklist.back();
+        worklist.pop_back();
+        obj->trace(evacuate);
+    }
+    // Survivors have been moved out, what is left are dead objects and moved-from shells
+    for(char *cur = nurseryStart; cur < top; cur += *reinterpret_cast<size_t*>(cur)){
+        Object *obj = reinterpret_cast<Object*>(cur + headerSize);
+        if(obj->forward == nullptr){
+            stats.freedObjects++;
+        }
+        obj->~Object();
+    }
+    top = nurseryStart;
+    stats.minorCollections++;
+    recordPause(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    if(oldObjects.size() > majorThreshold){
+        collectMajor();
+    }
+}
+
+// Only called with an empty nursery, so every reachable object is in old space
+void Heap::collectMajor(){
+    if(top != nurseryStart){
+        collectMinor();
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Object*> worklist;
+    Tracer mark = [&](Object *&slot){
+        if(slot && !slot->marked){
+            slot->marked = true;
+            worklist.push_back(slot);
+        }
+    };
+    visitRoots(mark);
+    while(!worklist.empty()){
+        Object *obj = worklist.back();
+        worklist.pop_back();
+        obj->trace(mark);
+    }
+    size_t kept = 0;
+    for(Object *obj : oldObjects){
+        if(obj->marked){
+            obj->marked = false;
+            oldObjects[kept++] = obj;
+        } else {
+            delete obj;
+            stats.freedObjects++;
+        }
+    }
+    oldObjects.resize(kept);
+    majorThreshold = std::max<size_t>(majorThreshold, 2 * kept);
+    stats.majorCollections++;
+    recordPause(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "object.hpp"
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Base of every object type the heap can allocate, provides the move into old space
+template<typename T>
+struct HeapObject : public Object {
+    Object* promote() override {
+        return new T(std::move(static_cast<T&>(*this)));
+    }
+};
+
+struct HeapStats {
+    size_t minorCollections = 0;
+    size_t majorCollections = 0;
+    size_t promotedObjects = 0;
+    size_t freedObjects = 0;
+    double totalPauseMs = 0;
+    double maxPauseMs = 0;
+};
+
+// Generational heap for runtime values, one per thread. Nothing allocates on it yet:
+// Array and StringData are still reference counted objects from new and delete, moving
+// them here needs move constructors and tracers that rewrite their Ref children.
+// Young objects are bump allocated in the nursery. A minor collection moves the survivors
+// into old space, every reference to them is rewritten through the precise roots and
+// object tracers, then the whole nursery is reset. Old space is collected by mark and sweep,
+// which also frees the cycles reference counting can't.
+// Values are immutable, so an old object only points to a young one when it is too big for
+// the nursery and allocated straight into old space, or after an in-place update of a
+// uniquely owned value, which must be followed by writeBarrier
+class Heap {
+private:
+    static constexpr size_t headerSize = alignof(std::max_align_t);
+
+    char *nurseryStart;
+    char *nurseryEnd;
+    char *top;
+    std::vector<Object*> oldObjects;
+    std::vector<Object*> rememberedSet;
+    std::vector<Object**> roots;
+    std::vector<std::vector<Object*>*> rootSets;
+    size_t majorThreshold = 1 << 16;
+
+    static size_t allocationSize(size_t);
+    char* allocateRaw(size_t);
+    bool fitsNursery(size_t) const;
+    void collectMinorKeeping(Object*);
+    void visitRoots(const Tracer&);
+    void recordPause(double);
+public:
+    HeapStats stats;
+
+    Heap(size_t nurserySize = 4 << 20);
+    ~Heap();
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    // May trigger a minor collection, which runs after the object is built: objects passed
+    // in `args` are read before they can move. Those the new object keeps are updated through
+    // its tracer, any others the caller still holds must be reachable from a root
+    template<typename T, typename... Args>
+    T* allocate(Args&&... args){
+        static_assert(std::is_base_of_v<HeapObject<T>, T>, "Heap allocated types derive from HeapObject");
+        char *memory = allocateRaw(sizeof(T));
+        T *obj;
+        if(memory){
+            obj = new(memory) T(std::forward<Args>(args)...);
+            obj->young = true;
+            obj->managed = true;
+        } else {
+            // Born old but may be built from young objects, like any old object pointing
+            // into the nursery it goes through the write barrier
+            obj = new T(std::forward<Args>(args)...);
+            obj->managed = true;
+            oldObjects.push_back(obj);
+            writeBarrier(obj);
+            if(fitsNursery(sizeof(T))){
+                collectMinorKeeping(obj);
+            }
+        }
+        return obj;
+    }
+
+    // A VM frame registers the slots holding its locals, they are updated when objects move
+    void addRoot(Object**);
+    void removeRoot(Object**);
+    void addRootSet(std::vector<Object*>*);
+    void removeRootSet(std::vector<Object*>*);
+    void writeBarrier(Object*);
+    void collectMinor();
+    void collectMajor();
+    size_t nurseryUsed() const;
+
+    static Heap& current();
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "../include/utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+// What an inline cache keys on: the ValueType of a primitive receiver, or the id of a
+// record value's shape. Shape ids start after the ValueTypes
+using ShapeId = uint32_t;
+
+// Receiver shapes a site remembers before it gives up and goes megamorphic
+static constexpr size_t polymorphicEntries = 4;
+
+enum class InlineCacheState : uint8_t {
+    empty,
+    monomorphic,
+    polymorphic,
+    megamorphic
+};
+
+static std::unordered_map<InlineCacheState, const char*> inlineCacheStateNameLookup = {
+    { InlineCacheState::empty, "empty" },
+    { InlineCacheState::monomorphic, "monomorphic" },
+    { InlineCacheState::polymorphic, "polymorphic" },
+    { InlineCacheState::megamorphic, "megamorphic" },
+};
+
+// Lookup statistics are bumped on every call, an atomic read-modify-write there would cost
+// more than the lookup. Increments racing on another thread may be lost, never torn
+static void countLookup(std::atomic<size_t> &counter){
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// Method lookup cache of one `receiver.method(args)` call site. A hit compares the receiver's
+// shape against at most polymorphicEntries remembered shapes, the first one usually matches.
+// Only a miss resolves the method by name, through `resolve(shape, method)`. A site that sees
+// more shapes than it can remember switches to the table's shared hash map.
+// `Target` is whatever the runtime calls, a native method or a user function.
+// Sites are shared by the thread pool's workers. An entry is written once, under the table's
+// lock, before `count` publishes it, so a hit reads the entries without locking
+template<typename Target>
+class InlineCache {
+private:
+    std::array<ShapeId, polymorphicEntries> shapes;
+    std::array<Target, polymorphicEntries> targets;
+    std::atomic<uint8_t> count = 0;
+    std::atomic<bool> megamorphic = false;
+public:
+    std::string method;
+    uint32_t methodId;
+    std::atomic<size_t> hits = 0;
+    std::atomic<size_t> misses = 0;
+    std::atomic<size_t> megamorphicLookups = 0; // Included in hits and misses
+
+    InlineCache(std::string method, uint32_t methodId)
+      : method(std::move(method)), methodId(methodId)
+    {
+    }
+
+    template<typename Megamorphic, typename Resolve>
+    Target lookup(ShapeId shape, Megamorphic &shared, Resolve &&resolve){
+        if(megamorphic.load(std::memory_order_acquire)){
+            countLookup(megamorphicLookups);
+            return shared.lookup(shape, *this, resolve);
+        }
+        uint8_t known = count.load(std::memory_order_acquire);
+        for(uint8_t i = 0; i < known; i++){
+            if(shapes[i] == shape){
+                countLookup(hits);
+                return targets[i];
+            }
+        }
+        countLookup(misses);
+        Target target = resolve(shape, method);
+        std::unique_lock lock(shared.mutex);
+        // Another thread may have added shapes meanwhile, this one among them
+        known = count.load(std::memory_order_relaxed);
+        if(megamorphic.load(std::memory_order_relaxed) ||
+            std::find(shapes.begin(), shapes.begin() + known, shape) != shapes.begin() + known){
+            return target;
+        }
+        if(known < polymorphicEntries){
+            shapes[known] = shape;
+            targets[known] = target;
+            count.store(known + 1, std::memory_order_release);
+        } else {
+            // The remembered shapes move to the shared map, they don't need resolving again
+            for(uint8_t i = 0; i < known; i++){
+                shared.insert(shapes[i], methodId, targets[i]);
+            }
+            shared.insert(shape, methodId, target);
+            megamorphic.store(true, std::memory_order_release);
+        }
+        return target;
+    }
+
+    InlineCacheState state() const {
+        if(megamorphic.load(std::memory_order_acquire)){
+            return InlineCacheState::megamorphic;
+        }
+        uint8_t known = count.load(std::memory_order_acquire);
+        return known == 0 ? InlineCacheState::empty :
+            known == 1 ? InlineCacheState::monomorphic : InlineCacheState::polymorphic;
+    }
+
+    // Share of lookups answered without resolving the method by name
+    double hitRate() const {
+        size_t hit = hits.load(std::memory_order_relaxed);
+        size_t lookups = hit + misses.load(std::memory_order_relaxed);
+        return lookups ? static_cast<double>(hit) / lookups : 0;
+    }
+};
+
+// The caches of every call site, indexed by the slot the optimizer assigned to the site
+// (CallArgsList::inlineCache), plus the shared hash map of megamorphic sites keyed on
+// shape and method. The map is read under a shared lock, misses and every site's new
+// entries take it exclusively
+template<typename Target>
+class InlineCacheTable {
+private:
+    struct Megamorphic {
+        std::unordered_map<uint64_t, Target> targets;
+        std::shared_mutex mutex;
+
+        static uint64_t key(ShapeId shape, uint32_t methodId){
+            return uint64_t(shape) << 32 | methodId;
+        }
+
+        template<typename Resolve>
+        Target lookup(ShapeId shape, InlineCache<Target> &site, Resolve &resolve){
+            {
+                std::shared_lock lock(mutex);
+                auto it = targets.find(key(shape, site.methodId));
+                if(it != targets.end()){
+                    countLookup(site.hits);
+                    return it->second;
+                }
+            }
+            countLookup(site.misses);
+            Target target = resolve(shape, site.method);
+            std::unique_lock lock(mutex);
+            targets.emplace(key(shape, site.methodId), target);
+            return target;
+        }
+
+        // Called with the lock held
+        void insert(ShapeId shape, uint32_t methodId, const Target &target){
+            targets.emplace(key(shape, methodId), target);
+        }
+    };
+
+    // A deque never moves its sites, lookups may hold one while the REPL appends
+    std::deque<InlineCache<Target>> sites;
+    std::unordered_map<std::string, uint32_t> methodIds;
+    Megamorphic megamorphic;
+public:
+    // Sites are only ever appended, the REPL adds the ones of each new input. Not concurrently
+    // with lookups, they run between inputs
+    void addSite(const std::string &method){
+        auto it = methodIds.try_emplace(method, methodIds.size()).first;
+        sites.emplace_back(method, it->second);
+    }
+
+    // Appends the sites of `methods` past the ones the table has, the optimizer keeps
+    // numbering sites across inputs
+    void addSites(const std::vector<std::string> &methods){
+        for(size_t i = sites.size(); i < methods.size(); i++){
+            addSite(methods[i]);
+        }
+    }
+
+    size_t size() const {
+        return sites.size();
+    }
+
+    template<typename Resolve>
+    Target lookup(size_t site, ShapeId shape, Resolve &&resolve){
+        return sites[site].lookup(shape, megamorphic, resolve);
+    }
+
+    // One line per site: state, lookups and hit rate
+    void report(std::ostream &os) const {
+        for(size_t i = 0; i < sites.size(); i++){
+            const InlineCache<Target> &site = sites[i];
+            size_t lookups = site.hits.load(std::memory_order_relaxed) + site.misses.load(std::memory_order_relaxed);
+            os << "site " << i << " ." << site.method << ": ";
+            if(lookups == 0){
+                os << "not reached" << std::endl;
+                continue;
+            }
+            os << inlineCacheStateNameLookup[site.state()] << ", " << lookups << " lookups, "
+               << std::fixed << std::setprecision(1) << 100 * site.hitRate() << "% hits" << std::endl;
+        }
+    }
+};
@@ -0,0 +1,384 @@
+#include "integer.hpp"
+#include "number.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <span>
+#include <unordered_map>
+
+// Magnitudes are little-endian limb vectors. The helpers are generic over the base so
+// the same Karatsuba code multiplies binary limbs and, for printing, base 10^9 limbs
+using Limbs = std::vector<uint32_t>;
+using LimbSpan = std::span<const uint32_t>;
+
+static constexpr uint64_t binaryBase = uint64_t(1) << 32;
+static constexpr uint64_t decimalBase = 1000000000;
+static constexpr int decimalLimbDigits = 9;
+// Below this many limbs decimal conversion is done digit group by digit group
+static constexpr size_t decimalSplitThreshold = 64;
+
+static void trim(Limbs &limbs){
+    while(!limbs.empty() && limbs.back() == 0){
+        limbs.pop_back();
+    }
+}
+
+static LimbSpan trimmed(LimbSpan limbs){
+    while(!limbs.empty() && limbs.back() == 0){
+        limbs = limbs.first(limbs.size() - 1);
+    }
+    return limbs;
+}
+
+static int compareMagnitudes(LimbSpan a, LimbSpan b){
+    if(a.size() != b.size()){
+        return a.size() < b.size() ? -1 : 1;
+    }
+    for(size_t i = a.size(); i-- > 0;){
+        if(a[i] != b[i]){
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// acc += x * Base^shift
+template<uint64_t Base>
+static void addInto(Limbs &acc, LimbSpan x, size_t shift){
+    if(acc.size() < shift + x.size()){
+        acc.resize(shift + x.size());
+    }
+    uint64_t carry = 0;
+    for(size_t i = 0; i < x.size(); i++){
+        uint64_t sum = uint64_t(acc[shift + i]) + x[i] + carry;
+        acc[shift + i] = sum % Base;
+        carry = sum / Base;
+    }
+    for(size_t i = shift + x.size(); carry; i++){
+        if(i == acc.size()){
+            acc.push_back(0);
+        }
+        uint64_t sum = acc[i] + carry;
+        acc[i] = sum % Base;
+        carry = sum / Base;
+    }
+}
+
+// acc -= x, acc must not be smaller than x
+template<uint64_t Base>
+static void subtractFrom(Limbs &acc, LimbSpan x){
+    int64_t borrow = 0;
+    for(size_t i = 0; i < acc.size() && (i < x.size() || borrow); i++){
+        int64_t diff = int64_t(acc[i]) - (i < x.size() ? x[i] : 0) - borrow;
+        borrow = diff < 0;
+        acc[i] = borrow ? diff + Base : diff;
+    }
+    trim(acc);
+}
+
+// The largest intermediate, (Base - 1)^2 + 2 * (Base - 1), still fits in 64 bits
+template<uint64_t Base>
+static Limbs multiplySchoolbook(LimbSpan a, LimbSpan b){
+    Limbs result(a.size() + b.size());
+    for(size_t i = 0; i < a.size(); i++){
+        uint64_t carry = 0;
+        for(size_t j = 0; j < b.size(); j++){
+            uint64_t product = uint64_t(a[i]) * b[j] + result[i + j] + carry;
+            result[i + j] = product % Base;
+            carry = product / Base;
+        }
+        result[i + b.size()] = carry;
+    }
+    trim(result);
+    return result;
+}
+
+// Karatsuba: three half size products instead of four. A much shorter operand is
+// multiplied against slices of the longer one, splitting both evenly would waste work
+template<uint64_t Base>
+static Limbs multiply(LimbSpan a, LimbSpan b){
+    a = trimmed(a);
+    b = trimmed(b);
+    if(a.size() > b.size()){
+        std::swap(a, b);
+    }
+    if(a.empty()){
+        return {};
+    }
+    if(a.size() < karatsubaThreshold){
+        return multiplySchoolbook<Base>(a, b);
+    }
+    if(2 * a.size() <= b.size()){
+        Limbs result;
+        for(size_t offset = 0; offset < b.size(); offset += a.size()){
+            LimbSpan slice = b.subspan(offset, std::min(a.size(), b.size() - offset));
+            addInto<Base>(result, multiply<Base>(a, slice), offset);
+        }
+        trim(result);
+        return result;
+    }
+    size_t half = b.size() / 2;
+    LimbSpan a0 = a.first(std::min(half, a.size()));
+    LimbSpan a1 = a.subspan(a0.size());
+    LimbSpan b0 = b.first(half);
+    LimbSpan b1 = b.subspan(half);
+    Limbs low = multiply<Base>(a0, b0);
+    Limbs high = multiply<Base>(a1, b1);
+    Limbs aSum(a0.begin(), a0.end());
+    addInto<Base>(aSum, a1, 0);
+    Limbs bSum(b0.begin(), b0.end());
+    addInto<Base>(bSum, b1, 0);
+    Limbs middle = multiply<Base>(aSum, bSum);
+    subtractFrom<Base>(middle, low);
+    subtractFrom<Base>(middle, high);
+    Limbs result;
+    addInto<Base>(result, low, 0);
+    addInto<Base>(result, middle, half);
+    addInto<Base>(result, high, 2 * half);
+    trim(result);
+    return result;
+}
+
+// 2^(32k) in base 10^9, by squaring. Cached for the duration of one conversion
+static const Limbs& decimalPowerOfBase(size_t k, std::unordered_map<size_t, Limbs> &cache){
+    auto it = cache.find(k);
+    if(it != cache.end()){
+        return it->second;
+    }
+    Limbs result;
+    if(k == 1){
+        result = { 294967296, 4 };
+    } else {
+        const Limbs &half = decimalPowerOfBase(k / 2, cache);
+        result = multiply<decimalBase>(half, half);
+        if(k & 1){
+            result = multiply<decimalBase>(result, decimalPowerOfBase(1, cache));
+        }
+    }
+    return cache.emplace(k, std::move(result)).first->second;
+}
+
+// Divide and conquer: high * 2^(32 half) + low, the product done by Karatsuba in base 10^9.
+// Subquadratic where repeated division by 10^9 would be quadratic
+static Limbs toDecimalLimbs(LimbSpan binary, std::unordered_map<size_t, Limbs> &cache){
+    binary = trimmed(binary);
+    if(binary.size() <= decimalSplitThreshold){
+        Limbs result;
+        for(size_t i = binary.size(); i-- > 0;){
+            uint64_t carry = binary[i];
+            for(uint32_t &digits : result){
+                uint64_t value = uint64_t(digits) * binaryBase + carry;
+                digits = value % decimalBase;
+                carry = value / decimalBase;
+            }
+            while(carry){
+                result.push_back(carry % decimalBase);
+                carry /= decimalBase;
+            }
+        }
+        return result;
+    }
+    size_t half = binary.size() / 2;
+    Limbs low = toDecimalLimbs(binary.first(half), cache);
+    Limbs result = toDecimalLimbs(binary.subspan(half), cache);
+    result = multiply<decimalBase>(result, decimalPowerOfBase(half, cache));
+    addInto<decimalBase>(result, low, 0);
+    return result;
+}
+
+BigInt::BigInt(bool negative, std::vector<uint32_t> limbs)
+  : negative(negative), limbs(std::move(limbs))
+{
+}
+
+Integer::Integer(int64_t value){
+    if(value >= smallMin && value <= smallMax){
+        bits = (value << 1) | 1;
+    } else {
+        uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+        bits = reinterpret_cast<intptr_t>(new BigInt(value < 0,
+            { static_cast<uint32_t>(magnitude), static_cast<uint32_t>(magnitude >> 32) }));
+    }
+}
+
+Integer::Integer(const Integer &other)
+  : bits(other.bits)
+{
+    if(!isSmall()){
+        dup(big());
+    }
+}
+
+Integer::Integer(Integer &&other)
+  : bits(std::exchange(other.bits, 1))
+{
+}
+
+Integer& Integer::operator=(Integer other){
+    std::swap(bits, other.bits);
+    return *this;
+}
+
+Integer::~Integer(){
+    if(!isSmall()){
+        drop(big());
+    }
+}
+
+Integer Integer::fromBits(int64_t bits){
+    Integer result;
+    result.bits = bits;
+    return result;
+}
+
+BigInt* Integer::big() const {
+    return reinterpret_cast<BigInt*>(bits);
+}
+
+bool Integer::negative() const {
+    return isSmall() ? bits < 0 : big()->negative;
+}
+
+std::vector<uint32_t> Integer::magnitude() const {
+    if(!isSmall()){
+        return big()->limbs;
+    }
+    int64_t value = bits >> 1;
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+    Limbs limbs = { static_cast<uint32_t>(magnitude), static_cast<uint32_t>(magnitude >> 32) };
+    trim(limbs);
+    return limbs;
+}
+
+Integer Integer::fromMagnitude(bool negative, std::vector<uint32_t> magnitude){
+    trim(magnitude);
+    if(magnitude.size() <= 2){
+        uint64_t value = magnitude.empty() ? 0 : magnitude[0];
+        if(magnitude.size() == 2){
+            value |= uint64_t(magnitude[1]) << 32;
+        }
+        if(value <= uint64_t(smallMax) + negative){
+            return Integer(negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value));
+        }
+    }
+    return fromBits(reinterpret_cast<intptr_t>(new BigInt(negative, std::move(magnitude))));
+}
+
+Integer Integer::parse(std::string_view text){
+    if(std::optional<int64_t> value = parseInt(text)){
+        return Integer(*value);
+    }
+    bool negative = !text.empty() && text[0] == '-';
+    std::string_view digits = text.substr(!text.empty() && (text[0] == '-' || text[0] == '+'));
+    if(digits.empty() || !std::all_of(digits.begin(), digits.end(), [](char c){ return c >= '0' && c <= '9'; })){
+        throw RuntimeError("Invalid integer: " + std::string(text));
+    }
+    // Groups of nine digits, most significant first: magnitude = magnitude * 10^9 + group
+    Limbs magnitude;
+    size_t group = digits.length() % decimalLimbDigits;
+    for(size_t pos = 0; pos < digits.length(); pos += group, group = decimalLimbDigits){
+        uint32_t value = 0;
+        std::from_chars(digits.data() + pos, digits.data() + pos + group, value);
+        uint64_t carry = value;
+        uint64_t scale = 1;
+        for(size_t i = 0; i < group; i++){
+            scale *= 10;
+        }
+        for(uint32_t &limb : magnitude){
+            uint64_t product = uint64_t(limb) * scale + carry;
+            limb = static_cast<uint32_t>(product);
+            carry = product >> 32;
+        }
+        if(carry){
+            magnitude.push_back(carry);
+        }
+    }
+    return fromMagnitude(negative, std::move(magnitude));
+}
+
+std::optional<int64_t> Integer::toInt() const {
+    if(isSmall()){
+        return bits >> 1;
+    }
+    const Limbs &limbs = big()->limbs;
+    if(limbs.size() > 2){
+        return std::nullopt;
+    }
+    uint64_t value = limbs[0] | (limbs.size() > 1 ? uint64_t(limbs[1]) << 32 : 0);
+    if(value > uint64_t(INT64_MAX) + big()->negative){
+        return std::nullopt;
+    }
+    return big()->negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
+}
+
+std::string Integer::toString() const {
+    if(isSmall()){
+        char buffer[maxIntLength];
+        return std::string(buffer, writeInt(buffer, bits >> 1));
+    }
+    std::unordered_map<size_t, Limbs> cache;
+    Limbs decimal = toDecimalLimbs(big()->limbs, cache);
+    std::string result = big()->negative ? "-" : "";
+    result += std::to_string(decimal.back());
+    size_t pos = result.length();
+    result.resize(pos + (decimal.size() - 1) * decimalLimbDigits, '0');
+    for(size_t i = decimal.size() - 1; i-- > 0; pos += decimalLimbDigits){
+        // Right aligned in its nine digit group, the group is already zero filled
+        uint32_t value = decimal[i];
+        for(char *digit = result.data() + pos + decimalLimbDigits; value; value /= 10){
+            *--digit = '0' + value % 10;
+        }
+    }
+    return result;
+}
+
+Integer Integer::addSlow(const Integer &a, const Integer &b, bool subtract){
+    bool aNegative = a.negative();
+    bool bNegative = b.negative() != subtract;
+    Limbs aMagnitude = a.magnitude();
+    Limbs bMagnitude = b.magnitude();
+    if(aNegative == bNegative){
+        addInto<binaryBase>(aMagnitude, bMagnitude, 0);
+        return fromMagnitude(aNegative, std::move(aMagnitude));
+    }
+    if(compareMagnitudes(aMagnitude, bMagnitude) >= 0){
+        subtractFrom<binaryBase>(aMagnitude, bMagnitude);
+        return fromMagnitude(aNegative, std::move(aMagnitude));
+    }
+    subtractFrom<binaryBase>(bMagnitude, aMagnitude);
+    return fromMagnitude(bNegative, std::move(bMagnitude));
+}
+
+Integer Integer::mulSlow(const Integer &a, const Integer &b){
+    return fromMagnitude(a.negative() != b.negative(), multiply<binaryBase>(a.magnitude(), b.magnitude()));
+}
+
+Integer Integer::operator-() const {
+    int64_t result;
+    if(isSmall() && !__builtin_sub_overflow(2, bits, &result)){
+        return fromBits(result);
+    }
+    return fromMagnitude(!negative(), magnitude());
+}
+
+std::strong_ordering Integer::operator<=>(const Integer &other) const {
+    if(isSmall() && other.isSmall()){
+        return bits <=> other.bits;
+    }
+    if(negative() != other.negative()){
+        return negative() ? std::strong_ordering::less : std::strong_ordering::greater;
+    }
+    int order = compareMagnitudes(magnitude(), other.magnitude());
+    if(negative()){
+        order = -order;
+    }
+    return order <=> 0;
+}
+
+bool Integer::operator==(const Integer &other) const {
+    return (*this <=> other) == 0;
+}
+
+std::ostream& operator<<(std::ostream &os, const Integer &value){
+    return os << value.toString();
+}
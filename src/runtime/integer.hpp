@@ -0,0 +1,91 @@
+#pragma once
+
+#include "object.hpp"
+
+#include <compare>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Multiplications of operands with fewer limbs than this use the schoolbook method
+static constexpr size_t karatsubaThreshold = 32;
+
+// Arbitrary precision integer, only created once a value leaves the small int range.
+// The magnitude is stored in base 2^32, least significant limb first, without leading zeros
+struct BigInt : public Object {
+    bool negative = false;
+    std::vector<uint32_t> limbs;
+
+    BigInt(bool negative, std::vector<uint32_t> limbs);
+};
+
+// The language's int. A 63-bit small int is stored inline and tagged with the low bit,
+// anything larger points to a shared BigInt. Arithmetic on two small ints is a checked
+// machine operation, only an overflow takes the slow path and promotes the result.
+// Results that fit again are demoted, so a value has exactly one representation
+class Integer {
+public:
+    static constexpr int64_t smallMax = (int64_t(1) << 62) - 1;
+    static constexpr int64_t smallMin = -(int64_t(1) << 62);
+private:
+    // (value << 1) | 1 for a small int, otherwise a BigInt*
+    int64_t bits;
+
+    static Integer fromBits(int64_t);
+    BigInt* big() const;
+    bool negative() const;
+    std::vector<uint32_t> magnitude() const;
+    // Demotes to a small int when the magnitude fits
+    static Integer fromMagnitude(bool negative, std::vector<uint32_t>);
+
+    static Integer addSlow(const Integer&, const Integer&, bool subtract);
+    static Integer mulSlow(const Integer&, const Integer&);
+public:
+    Integer(int64_t value = 0);
+    Integer(const Integer&);
+    Integer(Integer&&);
+    Integer& operator=(Integer);
+    ~Integer();
+
+    // Decimal digits with an optional sign. Literals are parsed once by the parser
+    static Integer parse(std::string_view);
+
+    bool isSmall() const {
+        return bits & 1;
+    }
+    // Empty if the value doesn't fit in 64 bits
+    std::optional<int64_t> toInt() const;
+    std::string toString() const;
+
+    friend Integer operator+(const Integer &a, const Integer &b){
+        int64_t result;
+        if(a.isSmall() && b.isSmall() && !__builtin_add_overflow(a.bits, b.bits - 1, &result)){
+            return fromBits(result);
+        }
+        return addSlow(a, b, false);
+    }
+
+    friend Integer operator-(const Integer &a, const Integer &b){
+        int64_t result;
+        if(a.isSmall() && b.isSmall() && !__builtin_sub_overflow(a.bits, b.bits - 1, &result)){
+            return fromBits(result);
+        }
+        return addSlow(a, b, true);
+    }
+
+    // x * 2y is even, adding the tag back can't overflow
+    friend Integer operator*(const Integer &a, const Integer &b){
+        int64_t result;
+        if(a.isSmall() && b.isSmall() && !__builtin_mul_overflow(a.bits >> 1, b.bits - 1, &result)){
+            return fromBits(result | 1);
+        }
+        return mulSlow(a, b);
+    }
+
+    Integer operator-() const;
+    std::strong_ordering operator<=>(const Integer&) const;
+    bool operator==(const Integer&) const;
+};
+
+std::ostream& operator<<(std::ostream&, const Integer&);
@@ -0,0 +1,515 @@
+#include "jit.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define PFL_X86_JIT
+#endif
+
+#ifdef PFL_X86_JIT
+
+// Pre-assembled machine code with at most one operand hole, patched when pasted.
+// Values are computed in rax, the second operand of a binary operation in rcx.
+// Parameters and locals live in 8-byte slots below rbp
+struct Stencil {
+    std::vector<uint8_t> code;
+    int hole = -1;
+    int holeSize = 4;
+};
+
+// push rbp; mov rbp, rsp; sub rsp, frameSize
+static const Stencil prologue = { { 0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC, 0, 0, 0, 0 }, 7 };
+// mov [rbp + disp], rdi / rsi / rdx / rcx / r8 / r9
+static const Stencil storeParam[jitMaximumParams] = {
+    { { 0x48, 0x89, 0xBD, 0, 0, 0, 0 }, 3 },
+    { { 0x48, 0x89, 0xB5, 0, 0, 0, 0 }, 3 },
+    { { 0x48, 0x89, 0x95, 0, 0, 0, 0 }, 3 },
+    { { 0x48, 0x89, 0x8D, 0, 0, 0, 0 }, 3 },
+    { { 0x4C, 0x89, 0x85, 0, 0, 0, 0 }, 3 },
+    { { 0x4C, 0x89, 0x8D, 0, 0, 0, 0 }, 3 },
+};
+// pop rdi / rsi / rdx / rcx / r8 / r9
+static const Stencil popParam[jitMaximumParams] = {
+    { { 0x5F } }, { { 0x5E } }, { { 0x5A } }, { { 0x59 } }, { { 0x41, 0x58 } }, { { 0x41, 0x59 } },
+};
+// mov rax, [rbp + disp]
+static const Stencil loadSlot = { { 0x48, 0x8B, 0x85, 0, 0, 0, 0 }, 3 };
+// mov [rbp + disp], rax
+static const Stencil storeSlot = { { 0x48, 0x89, 0x85, 0, 0, 0, 0 }, 3 };
+// mov rax, imm64
+static const Stencil loadImmediate = { { 0x48, 0xB8, 0, 0, 0, 0, 0, 0, 0, 0 }, 2, 8 };
+// push rax
+static const Stencil pushValue = { { 0x50 } };
+// pop rax
+static const Stencil popValue = { { 0x58 } };
+// mov rcx, rax; pop rax
+static const Stencil popOperands = { { 0x48, 0x89, 0xC1, 0x58 } };
+// add / sub / imul rax, rcx
+static const Stencil addValues = { { 0x48, 0x01, 0xC8 } };
+static const Stencil subValues = { { 0x48, 0x29, 0xC8 } };
+static const Stencil mulValues = { { 0x48, 0x0F, 0xAF, 0xC1 } };
+// neg rax
+static const Stencil negateValue = { { 0x48, 0xF7, 0xD8 } };
+// cmp rax, rcx
+static const Stencil compareValues = { { 0x48, 0x39, 0xC8 } };
+// jo rel32
+static const Stencil jumpIfOverflow = { { 0x0F, 0x80, 0, 0, 0, 0 }, 2 };
+// jmp rel32
+static const Stencil jump = { { 0xE9, 0, 0, 0, 0 }, 1 };
+// call rel32, to the start of the function being compiled
+static const Stencil callSelf = { { 0xE8, 0, 0, 0, 0 }, 1 };
+// mov rax, imm64; call rax
+static const Stencil callAbsolute = { { 0x48, 0xB8, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xD0 }, 2, 8 };
+// mov rax, imm64; mov rax, [rax]; test rax, rax, loads an entry cell
+static const Stencil loadEntry = { { 0x48, 0xB8, 0, 0, 0, 0, 0, 0, 0, 0, 0x48, 0x8B, 0x00, 0x48, 0x85, 0xC0 }, 2, 8 };
+// jz rel32
+static const Stencil jumpIfZero = { { 0x0F, 0x84, 0, 0, 0, 0 }, 2 };
+// call rax
+static const Stencil callValue = { { 0xFF, 0xD0 } };
+// test rdx, rdx; jnz rel32
+static const Stencil jumpIfBailedOut = { { 0x48, 0x85, 0xD2, 0x0F, 0x85, 0, 0, 0, 0 }, 5 };
+// sub rsp, 8 / add rsp, 8
+static const Stencil alignStack = { { 0x48, 0x83, 0xEC, 0x08 } };
+static const Stencil restoreStack = { { 0x48, 0x83, 0xC4, 0x08 } };
+// xor edx, edx; leave; ret
+static const Stencil epilogue = { { 0x31, 0xD2, 0xC9, 0xC3 } };
+// mov edx, 1; leave; ret
+static const Stencil bailOut = { { 0xBA, 0x01, 0x00, 0x00, 0x00, 0xC9, 0xC3 } };
+
+// jcc rel32 taken when the comparison is false
+static std::unordered_map<NodeType, uint8_t> inverseConditionLookup = {
+    { NodeType::lessThan, 0x8D },
+    { NodeType::greaterThan, 0x8E },
+    { NodeType::lessEqual, 0x8F },
+    { NodeType::greaterEqual, 0x8C },
+    { NodeType::equality, 0x85 },
+    { NodeType::inequality, 0x84 },
+};
+
+// Thrown on the first node the JIT can't compile, the function then stays interpreted
+struct JitUnsupported {};
+
+class StencilEmitter {
+private:
+    Jit &jit;
+    AstNode *function;
+    const std::unordered_map<std::string, AstNode*> &functions;
+    std::vector<std::pair<std::string, int>> scope;
+    int slots = 0;
+    int pushed = 0; // Values pushed and not yet popped, the stack must be aligned at calls
+    std::vector<size_t> bailOutJumps;
+    std::vector<size_t> selfCalls;
+    size_t bodyStart = 0;
+
+    // Returns the position of the stencil's hole
+    size_t emit(const Stencil &stencil, int64_t operand = 0){
+        size_t start = code.size();
+        code.insert(code.end(), stencil.code.begin(), stencil.code.end());
+        if(stencil.hole < 0){
+            return start;
+        }
+        if(stencil.holeSize == 8){
+            std::memcpy(code.data() + start + stencil.hole, &operand, 8);
+        } else {
+            int32_t operand32 = operand;
+            std::memcpy(code.data() + start + stencil.hole, &operand32, 4);
+        }
+        return start + stencil.hole;
+    }
+
+    void patchJump(size_t hole, size_t target){
+        int32_t offset = static_cast<int64_t>(target) - static_cast<int64_t>(hole + 4);
+        std::memcpy(code.data() + hole, &offset, 4);
+    }
+
+    static int32_t slotOffset(int slot){
+        return -8 * (slot + 1);
+    }
+
+    std::optional<int> lookup(const std::string &name){
+        for(size_t i = scope.size(); i-- > 0;){
+            if(scope[i].first == name){
+                return scope[i].second;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void bind(const std::string &name){
+        emit(storeSlot, slotOffset(slots));
+        scope.emplace_back(name, slots++);
+    }
+
+    void binary(AstNode *node, const Stencil &operation){
+        expression(node->as<BinaryOperation>().left);
+        emit(pushValue);
+        pushed++;
+        expression(node->as<BinaryOperation>().right);
+        emit(popOperands);
+        pushed--;
+        emit(operation);
+        bailOutJumps.push_back(emit(jumpIfOverflow));
+    }
+
+    // Appends the jumps taken when the condition is false
+    void condition(AstNode *node, std::vector<size_t> &falseJumps){
+        if(node->type == NodeType::boolLiteral){
+            if(!node->as<BoolLiteral>().value){
+                falseJumps.push_back(emit(jump));
+            }
+            return;
+        }
+        if(node->type == NodeType::conjunction){
+            condition(node->as<BinaryOperation>().left, falseJumps);
+            condition(node->as<BinaryOperation>().right, falseJumps);
+            return;
+        }
+        if(!inverseConditionLookup.count(node->type)){
+            throw JitUnsupported();
+        }
+        expression(node->as<BinaryOperation>().left);
+        emit(pushValue);
+        pushed++;
+        expression(node->as<BinaryOperation>().right);
+        emit(popOperands);
+        pushed--;
+        emit(compareValues);
+        falseJumps.push_back(emit({ { 0x0F, inverseConditionLookup[node->type], 0, 0, 0, 0 }, 2 }));
+    }
+
+    void ifExpression(AstNode *node){
+        IfExpr &ifExpr = node->as<IfExpr>();
+        if(ifExpr.elseBlock == nullptr){
+            throw JitUnsupported();
+        }
+        std::vector<AstNode*> conditions = { ifExpr.condition };
+        conditions.insert(conditions.end(), ifExpr.elifCondition.begin(), ifExpr.elifCondition.end());
+        std::vector<AstNode*> blocks = { ifExpr.ifBlock };
+        blocks.insert(blocks.end(), ifExpr.elifBlock.begin(), ifExpr.elifBlock.end());
+        std::vector<size_t> endJumps;
+        for(size_t i = 0; i < conditions.size(); i++){
+            std::vector<size_t> falseJumps;
+            condition(conditions[i], falseJumps);
+            expression(blocks[i]);
+            endJumps.push_back(emit(jump));
+            for(size_t hole : falseJumps){
+                patchJump(hole, code.size());
+            }
+        }
+        expression(ifExpr.elseBlock);
+        for(size_t hole : endJumps){
+            patchJump(hole, code.size());
+        }
+    }
+
+    // Only `name = expr` bindings, the last expression is the block's value
+    void block(AstNode *node){
+        std::vector<AstNode*> &expressions = node->as<Block>().expressions;
+        if(expressions.empty()){
+            throw JitUnsupported();
+        }
+        size_t scopeSize = scope.size();
+        for(size_t i = 0; i + 1 < expressions.size(); i++){
+            AstNode *expr = expressions[i];
+            if(expr->type != NodeType::assignment){
+                throw JitUnsupported();
+            }
+            AstNode *lhs = expr->as<Assignment>().lhs;
+            AstNode *rhs = expr->as<Assignment>().rhs;
+            if(lhs->type == NodeType::tuplePattern && lhs->as<TuplePattern>().children.size() == 1){
+                lhs = lhs->as<TuplePattern>().children[0];
+            }
+            if(rhs->type == NodeType::tupleExpression && rhs->as<TupleExpression>().children.size() == 1){
+                rhs = rhs->as<TupleExpression>().children[0];
+            }
+            if(lhs->type != NodeType::identifier){
+                throw JitUnsupported();
+            }
+            expression(rhs);
+            bind(lhs->as<Identifier>().name);
+        }
+        expression(expressions.back());
+        scope.resize(scopeSize);
+    }
+
+    // A self tail call rebinds the parameters and jumps back to the body, a loop in constant
+    // stack space. Other tail calls are ordinary calls
+    void call(AstNode *node, bool tail){
+        AstNode *callee = node->as<BinaryOperation>().left;
+        if(callee->type != NodeType::identifier || lookup(callee->as<Identifier>().name) ||
+            !functions.count(callee->as<Identifier>().name)){
+            throw JitUnsupported();
+        }
+        AstNode *target = functions.at(callee->as<Identifier>().name);
+        std::vector<AstNode*> args;
+        for(AstNode *arg : node->as<BinaryOperation>().right->as<CallArgsList>().args){
+            if(arg){
+                args.push_back(arg);
+            }
+        }
+        if(args.size() != target->as<Function>().paramList->as<FnParamList>().params.size()){
+            throw JitUnsupported();
+        }
+        const JitFunction *compiledTarget = nullptr;
+        if(target != function){
+            compiledTarget = jit.compile(target);
+            if(compiledTarget == nullptr && !jit.compiling.count(target)){
+                throw JitUnsupported();
+            }
+        }
+        for(AstNode *arg : args){
+            expression(arg);
+            emit(pushValue);
+            pushed++;
+        }
+        if(tail && target == function && static_cast<size_t>(pushed) == args.size()){
+            for(size_t i = args.size(); i-- > 0;){
+                emit(popValue);
+                emit(storeSlot, slotOffset(i));
+                pushed--;
+            }
+            patchJump(emit(jump), bodyStart);
+            return;
+        }
+        for(size_t i = args.size(); i-- > 0;){
+            emit(popParam[i]);
+            pushed--;
+        }
+        bool misaligned = pushed % 2;
+        if(misaligned){
+            emit(alignStack);
+        }
+        if(compiledTarget){
+            emit(callAbsolute, reinterpret_cast<int64_t>(compiledTarget->code));
+        } else if(target != function){
+            // Still compiling further up, an empty cell means it turned out unsupported
+            emit(loadEntry, reinterpret_cast<int64_t>(&jit.entries[target]));
+            bailOutJumps.push_back(emit(jumpIfZero));
+            emit(callValue);
+        } else {
+            selfCalls.push_back(emit(callSelf));
+        }
+        if(misaligned){
+            emit(restoreStack);
+        }
+        bailOutJumps.push_back(emit(jumpIfBailedOut));
+    }
+
+    void expression(AstNode *node){
+        if(node == nullptr){
+            throw JitUnsupported();
+        }
+        switch(node->type){
+        case NodeType::intLiteral:
+            if(!node->as<IntLiteral>().number){
+                throw JitUnsupported();
+            }
+            emit(loadImmediate, *node->as<IntLiteral>().number);
+        break;
+        case NodeType::identifier:
+        {
+            std::optional<int> slot = lookup(node->as<Identifier>().name);
+            if(!slot){
+                throw JitUnsupported();
+            }
+            emit(loadSlot, slotOffset(*slot));
+        break;
+        }
+        case NodeType::addition:
+            binary(node, addValues);
+        break;
+        case NodeType::subtraction:
+            binary(node, subValues);
+        break;
+        case NodeType::multiplication:
+            binary(node, mulValues);
+        break;
+        case NodeType::plusSign:
+            expression(node->as<UnaryOperation>().expr);
+        break;
+        case NodeType::minusSign:
+            expression(node->as<UnaryOperation>().expr);
+            emit(negateValue);
+            bailOutJumps.push_back(emit(jumpIfOverflow));
+        break;
+        case NodeType::ifExpr:
+            ifExpression(node);
+        break;
+        case NodeType::block:
+            block(node);
+        break;
+        case NodeType::call:
+            call(node, false);
+        break;
+        case NodeType::tailCall:
+            call(node, true);
+        break;
+        default:
+            throw JitUnsupported();
+        }
+    }
+public:
+    std::vector<uint8_t> code;
+
+    StencilEmitter(Jit &jit, AstNode *function, const std::unordered_map<std::string, AstNode*> &functions)
+      : jit(jit), function(function), functions(functions)
+    {
+    }
+
+    void compile(){
+        std::vector<AstNode*> &params = function->as<Function>().paramList->as<FnParamList>().params;
+        if(params.size() > jitMaximumParams){
+            throw JitUnsupported();
+        }
+        size_t frameSizeHole = emit(prologue);
+        for(size_t i = 0; i < params.size(); i++){
+            AstNode *param = params[i];
+            if(param->type == NodeType::typedIdentifier && param->as<TypedIdentifier>().type == "int"){
+                emit(storeParam[i], slotOffset(slots));
+                scope.emplace_back(param->as<TypedIdentifier>().name, slots++);
+            } else if(param->type == NodeType::identifier){
+                emit(storeParam[i], slotOffset(slots));
+                scope.emplace_back(param->as<Identifier>().name, slots++);
+            } else {
+                throw JitUnsupported();
+            }
+        }
+        bodyStart = code.size();
+        expression(function->as<Function>().block);
+        emit(epilogue);
+        size_t bailOutLabel = code.size();
+        emit(bailOut);
+        for(size_t hole : bailOutJumps){
+            patchJump(hole, bailOutLabel);
+        }
+        for(size_t hole : selfCalls){
+            patchJump(hole, 0);
+        }
+        int32_t frameSize = (slots * 8 + 15) / 16 * 16;
+        std::memcpy(code.data() + frameSizeHole, &frameSize, 4);
+    }
+};
+
+#endif
+
+Jit::~Jit(){
+#ifdef PFL_X86_JIT
+    for(auto &[function, native] : compiled){
+        munmap(native.code, native.size);
+    }
+#endif
+    if(perfMap){
+        std::fclose(perfMap);
+    }
+}
+
+void Jit::addFunctions(AstNode *root){
+    if(root == nullptr){
+        return;
+    }
+    if(root->type == NodeType::function){
+        functions[root->as<Function>().name->as<Identifier>().name] = root;
+    } else if(root->type == NodeType::block){
+        for(AstNode *expr : root->as<Block>().expressions){
+            if(expr && expr->type == NodeType::function){
+                addFunctions(expr);
+            }
+        }
+    }
+}
+
+// perf reads `start size name` lines, hex without prefix
+void Jit::writePerfMap(const JitFunction &native, const std::string &name){
+#ifdef PFL_X86_JIT
+    if(perfMap == nullptr){
+        perfMap = std::fopen(("/tmp/perf-" + std::to_string(getpid()) + ".map").c_str(), "a");
+        if(perfMap == nullptr){
+            return;
+        }
+    }
+    std::fprintf(perfMap, "%lx %zx pfl:%s\n", reinterpret_cast<uintptr_t>(native.code), native.size, name.c_str());
+    std::fflush(perfMap);
+#endif
+}
+
+const JitFunction* Jit::compile(AstNode *function){
+    auto it = compiled.find(function);
+    if(it != compiled.end()){
+        return &it->second;
+    }
+    if(unsupported.count(function) || compiling.count(function)){
+        return nullptr;
+    }
+#ifdef PFL_X86_JIT
+    StencilEmitter emitter(*this, function, functions);
+    compiling.insert(function);
+    try {
+        emitter.compile();
+    } catch(JitUnsupported){
+        compiling.erase(function);
+        unsupported.insert(function);
+        return nullptr;
+    }
+    compiling.erase(function);
+    // Written while mapped writable, then made executable, never both at once
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t size = (emitter.code.size() + pageSize - 1) / pageSize * pageSize;
+    void *code = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(code == MAP_FAILED){
+        throw SystemError("Could not map memory for JIT code", __FILE_NAME__, __LINE__);
+    }
+    std::memcpy(code, emitter.code.data(), emitter.code.size());
+    mprotect(code, size, PROT_READ | PROT_EXEC);
+    JitFunction native = { code, size, function->as<Function>().paramList->as<FnParamList>().params.size() };
+    const JitFunction &result = compiled.emplace(function, native).first->second;
+    auto entry = entries.find(function);
+    if(entry != entries.end()){
+        entry->second = code;
+    }
+    JitFunction listed = result;
+    listed.size = emitter.code.size();
+    writePerfMap(listed, function->as<Function>().name->as<Identifier>().name);
+    return &result;
+#else
+    unsupported.insert(function);
+    return nullptr;
+#endif
+}
+
+std::optional<int64_t> Jit::call(AstNode *function, std::span<const int64_t> args){
+    const JitFunction *native = nullptr;
+    auto it = compiled.find(function);
+    if(it != compiled.end()){
+        native = &it->second;
+    } else if(++callCounts[function] >= jitCallThreshold){
+        native = compile(function);
+    }
+    if(native == nullptr || args.size() != native->params){
+        return std::nullopt;
+    }
+    // Unused parameter registers are ignored by the callee
+    int64_t regs[jitMaximumParams] = {};
+    std::copy(args.begin(), args.end(), regs);
+    using NativeFunction = JitResult(*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t);
+    JitResult result = reinterpret_cast<NativeFunction>(native->code)(regs[0], regs[1], regs[2], regs[3], regs[4], regs[5]);
+    if(result.bailedOut){
+        return std::nullopt;
+    }
+    return result.value;
+}
+
+void Jit::report(AstNode *root, std::ostream &os){
+    addFunctions(root);
+    std::vector<AstNode*> expressions = { root };
+    if(root && root->type == NodeType::block){
+        expressions = root->as<Block>().expressions;
+    }
+    for(AstNode *expr : expressions){
+        if(expr && expr->type == NodeType::function){
+            os << expr->as<Function>().name->as<Identifier>().name << ": " <<
+                (compile(expr) ? "compiled" : "interpreted") << std::endl;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../include/utils.hpp"
+#include "../ast/astnode.hpp"
+
+#include <cstdio>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <unordered_set>
+
+// Calls to a function before the JIT compiles it
+static constexpr size_t jitCallThreshold = 1000;
+// Arguments are passed in registers only
+static constexpr size_t jitMaximumParams = 6;
+
+// Returned in rax:rdx. A compiled function bails out on anything the native code can't
+// represent, like an int overflow that promotes to a bigint. Compiled functions are pure,
+// the caller then simply interprets the call from the start
+struct JitResult {
+    int64_t value;
+    int64_t bailedOut;
+};
+
+struct JitFunction {
+    void *code;
+    size_t size;
+    size_t params;
+};
+
+// Baseline template JIT for x86-64 Linux, no call path uses it yet, bench/jit-equivalence.cpp
+// checks it against a reference evaluator. Hot functions are compiled
+// by pasting pre-assembled machine code stencils for each node and patching their operands.
+// Supported are functions over ints: literals, parameters, local bindings, + - *, negation,
+// if/elif/else on comparisons and calls to compiled functions. A call to a function whose
+// compilation is still under way, as in mutual recursion, goes through its entry cell,
+// filled in once that function is compiled. Every arithmetic operation
+// checks for overflow and bails out. A function with anything else stays interpreted.
+// Compiled code is listed in /tmp/perf-<pid>.map so perf can name it
+class Jit {
+private:
+    std::unordered_map<std::string, AstNode*> functions;
+    std::unordered_map<AstNode*, size_t> callCounts;
+    std::unordered_map<AstNode*, JitFunction> compiled;
+    std::unordered_set<AstNode*> unsupported;
+    std::unordered_set<AstNode*> compiling;
+    // Native code of each function reached while it was compiling, null until it's
+    // compiled and for good if it can't be. Node based, the cells never move
+    std::unordered_map<AstNode*, void*> entries;
+    FILE *perfMap = nullptr;
+
+    void writePerfMap(const JitFunction&, const std::string &name);
+
+    friend class StencilEmitter;
+public:
+    Jit() = default;
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+    ~Jit();
+
+    // Registers the top level functions of a program, calls are resolved by name
+    void addFunctions(AstNode *root);
+    // nullptr if the function uses something the JIT doesn't support, or on another platform
+    const JitFunction* compile(AstNode *function);
+    // Counts the call and compiles the function once it's hot. Empty when the caller must
+    // interpret the call: not hot yet, not compilable or the native code bailed out
+    std::optional<int64_t> call(AstNode *function, std::span<const int64_t> args);
+    // Compiles every top level function of a program and lists which ones the JIT supports
+    void report(AstNode *root, std::ostream&);
+};
@@ -0,0 +1,852 @@
+#include "kernels.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define PFL_X86_KERNELS
+#endif
+
+struct KernelTable {
+    bool (*bytesEqual)(const char*, const char*, size_t);
+    size_t (*indexOfByte)(const char*, size_t, char);
+    size_t (*indexOfInt)(const int64_t*, size_t, int64_t);
+    void (*reverseBytes)(const char*, char*, size_t);
+    void (*reverseWords)(const uint64_t*, uint64_t*, size_t);
+    bool (*sumInts)(const int64_t*, size_t, int64_t&);
+    bool (*addInts)(const int64_t*, const int64_t*, int64_t*, size_t);
+    bool (*subInts)(const int64_t*, const int64_t*, int64_t*, size_t);
+    int64_t (*minInts)(const int64_t*, size_t);
+    int64_t (*maxInts)(const int64_t*, size_t);
+    double (*sumFloats)(const double*, size_t);
+    void (*addFloats)(const double*, const double*, double*, size_t);
+    void (*subFloats)(const double*, const double*, double*, size_t);
+    void (*mulFloats)(const double*, const double*, double*, size_t);
+    double (*minFloats)(const double*, size_t);
+    double (*maxFloats)(const double*, size_t);
+};
+
+static std::unordered_map<KernelLevel, const char*> kernelLevelNameLookup = {
+    { KernelLevel::scalar, "scalar" },
+    { KernelLevel::sse42, "sse4.2" },
+    { KernelLevel::avx2, "avx2" },
+};
+
+// Scalar versions, also the reference the vector ones must match
+
+static bool scalarBytesEqual(const char *a, const char *b, size_t n){
+    for(size_t i = 0; i < n; i++){
+        if(a[i] != b[i]){
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t scalarIndexOfByte(const char *data, size_t n, char value){
+    for(size_t i = 0; i < n; i++){
+        if(data[i] == value){
+            return i;
+        }
+    }
+    return n;
+}
+
+static size_t scalarIndexOfInt(const int64_t *data, size_t n, int64_t value){
+    for(size_t i = 0; i < n; i++){
+        if(data[i] == value){
+            return i;
+        }
+    }
+    return n;
+}
+
+static void scalarReverseBytes(const char *src, char *dst, size_t n){
+    for(size_t i = 0; i < n; i++){
+        dst[i] = src[n - 1 - i];
+    }
+}
+
+static void scalarReverseWords(const uint64_t *src, uint64_t *dst, size_t n){
+    for(size_t i = 0; i < n; i++){
+        dst[i] = src[n - 1 - i];
+    }
+}
+
+static bool fitsInt(__int128 value, int64_t &result){
+    if(value < INT64_MIN || value > INT64_MAX){
+        return false;
+    }
+    result = static_cast<int64_t>(value);
+    return true;
+}
+
+static bool scalarSumInts(const int64_t *data, size_t n, int64_t &result){
+    __int128 total = 0;
+    for(size_t i = 0; i < n; i++){
+        total += data[i];
+    }
+    return fitsInt(total, result);
+}
+
+// Overflowing elements hold the wrapped value, like the vector versions leave them
+static bool scalarAddInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    bool ok = true;
+    for(size_t i = 0; i < n; i++){
+        ok &= !__builtin_add_overflow(a[i], b[i], &out[i]);
+    }
+    return ok;
+}
+
+static bool scalarSubInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    bool ok = true;
+    for(size_t i = 0; i < n; i++){
+        ok &= !__builtin_sub_overflow(a[i], b[i], &out[i]);
+    }
+    return ok;
+}
+
+// Neither instruction set has a 64-bit multiply, every level uses this one
+static bool scalarMulInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    bool ok = true;
+    for(size_t i = 0; i < n; i++){
+        ok &= !__builtin_mul_overflow(a[i], b[i], &out[i]);
+    }
+    return ok;
+}
+
+static int64_t scalarMinInts(const int64_t *data, size_t n){
+    int64_t result = data[0];
+    for(size_t i = 1; i < n; i++){
+        result = data[i] < result ? data[i] : result;
+    }
+    return result;
+}
+
+static int64_t scalarMaxInts(const int64_t *data, size_t n){
+    int64_t result = data[0];
+    for(size_t i = 1; i < n; i++){
+        result = data[i] > result ? data[i] : result;
+    }
+    return result;
+}
+
+// Lane k holds the sum of elements k, k + 4, k + 8 ... The lanes are added pairwise, then the tail
+static double scalarSumFloats(const double *data, size_t n){
+    double lanes[4] = { 0, 0, 0, 0 };
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        for(int k = 0; k < 4; k++){
+            lanes[k] += data[i + k];
+        }
+    }
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for(; i < n; i++){
+        total += data[i];
+    }
+    return total;
+}
+
+static void scalarAddFloats(const double *a, const double *b, double *out, size_t n){
+    for(size_t i = 0; i < n; i++){
+        out[i] = a[i] + b[i];
+    }
+}
+
+static void scalarSubFloats(const double *a, const double *b, double *out, size_t n){
+    for(size_t i = 0; i < n; i++){
+        out[i] = a[i] - b[i];
+    }
+}
+
+static void scalarMulFloats(const double *a, const double *b, double *out, size_t n){
+    for(size_t i = 0; i < n; i++){
+        out[i] = a[i] * b[i];
+    }
+}
+
+// `x < m ? x : m` is what MINPD computes, so lanes and NaNs behave the same at every level
+static double combineMinLanes(const double *lanes, const double *data, size_t i, size_t n){
+    double result = lanes[0];
+    for(int k = 1; k < 4; k++){
+        result = lanes[k] < result ? lanes[k] : result;
+    }
+    for(; i < n; i++){
+        result = data[i] < result ? data[i] : result;
+    }
+    return result;
+}
+
+static double combineMaxLanes(const double *lanes, const double *data, size_t i, size_t n){
+    double result = lanes[0];
+    for(int k = 1; k < 4; k++){
+        result = lanes[k] > result ? lanes[k] : result;
+    }
+    for(; i < n; i++){
+        result = data[i] > result ? data[i] : result;
+    }
+    return result;
+}
+
+static double scalarMinFloats(const double *data, size_t n){
+    if(n < 4){
+        double lanes[4] = { data[0], data[0], data[0], data[0] };
+        return combineMinLanes(lanes, data, 1, n);
+    }
+    double lanes[4] = { data[0], data[1], data[2], data[3] };
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4){
+        for(int k = 0; k < 4; k++){
+            lanes[k] = data[i + k] < lanes[k] ? data[i + k] : lanes[k];
+        }
+    }
+    return combineMinLanes(lanes, data, i, n);
+}
+
+static double scalarMaxFloats(const double *data, size_t n){
+    if(n < 4){
+        double lanes[4] = { data[0], data[0], data[0], data[0] };
+        return combineMaxLanes(lanes, data, 1, n);
+    }
+    double lanes[4] = { data[0], data[1], data[2], data[3] };
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4){
+        for(int k = 0; k < 4; k++){
+            lanes[k] = data[i + k] > lanes[k] ? data[i + k] : lanes[k];
+        }
+    }
+    return combineMaxLanes(lanes, data, i, n);
+}
+
+static const KernelTable scalarKernels = {
+    scalarBytesEqual, scalarIndexOfByte, scalarIndexOfInt,
+    scalarReverseBytes, scalarReverseWords,
+    scalarSumInts, scalarAddInts, scalarSubInts, scalarMinInts, scalarMaxInts,
+    scalarSumFloats, scalarAddFloats, scalarSubFloats, scalarMulFloats, scalarMinFloats, scalarMaxFloats,
+};
+
+#ifdef PFL_X86_KERNELS
+
+// SSE4.2 versions, 16 bytes or 2 words per register
+
+#define SSE42 __attribute__((target("sse4.2")))
+
+SSE42 static bool sse42BytesEqual(const char *a, const char *b, size_t n){
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF){
+            return false;
+        }
+    }
+    return scalarBytesEqual(a + i, b + i, n - i);
+}
+
+SSE42 static size_t sse42IndexOfByte(const char *data, size_t n, char value){
+    __m128i needle = _mm_set1_epi8(value);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, needle));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scalarIndexOfByte(data + i, n - i, value);
+}
+
+SSE42 static size_t sse42IndexOfInt(const int64_t *data, size_t n, int64_t value){
+    __m128i needle = _mm_set1_epi64x(value);
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(x, needle)));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scalarIndexOfInt(data + i, n - i, value);
+}
+
+SSE42 static void sse42ReverseBytes(const char *src, char *dst, size_t n){
+    __m128i order = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + n - i - 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(x, order));
+    }
+    scalarReverseBytes(src, dst + i, n - i);
+}
+
+SSE42 static void sse42ReverseWords(const uint64_t *src, uint64_t *dst, size_t n){
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + n - i - 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi32(x, 0x4E));
+    }
+    scalarReverseWords(src, dst + i, n - i);
+}
+
+// Signed overflow of s = a + b happened when s differs in sign from both operands
+SSE42 static __m128i sse42AddOverflow(__m128i a, __m128i b, __m128i s){
+    return _mm_and_si128(_mm_xor_si128(a, s), _mm_xor_si128(b, s));
+}
+
+// A lane that overflows doesn't mean the total does, the scalar version then decides
+SSE42 static bool sse42SumInts(const int64_t *data, size_t n, int64_t &result){
+    __m128i lanes[2] = { _mm_setzero_si128(), _mm_setzero_si128() };
+    __m128i overflow = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        for(int k = 0; k < 2; k++){
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2 * k));
+            __m128i s = _mm_add_epi64(lanes[k], x);
+            overflow = _mm_or_si128(overflow, sse42AddOverflow(lanes[k], x, s));
+            lanes[k] = s;
+        }
+    }
+    if(_mm_movemask_pd(_mm_castsi128_pd(overflow))){
+        return scalarSumInts(data, n, result);
+    }
+    int64_t parts[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(parts), lanes[0]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(parts + 2), lanes[1]);
+    __int128 total = static_cast<__int128>(parts[0]) + parts[1] + parts[2] + parts[3];
+    for(; i < n; i++){
+        total += data[i];
+    }
+    return fitsInt(total, result);
+}
+
+SSE42 static bool sse42AddInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    __m128i overflow = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i s = _mm_add_epi64(x, y);
+        overflow = _mm_or_si128(overflow, sse42AddOverflow(x, y, s));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), s);
+    }
+    bool ok = !_mm_movemask_pd(_mm_castsi128_pd(overflow));
+    return scalarAddInts(a + i, b + i, out + i, n - i) && ok;
+}
+
+// s = a - b overflowed when a and b differ in sign and s differs in sign from a
+SSE42 static bool sse42SubInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    __m128i overflow = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i s = _mm_sub_epi64(x, y);
+        overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(x, y), _mm_xor_si128(x, s)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), s);
+    }
+    bool ok = !_mm_movemask_pd(_mm_castsi128_pd(overflow));
+    return scalarSubInts(a + i, b + i, out + i, n - i) && ok;
+}
+
+SSE42 static int64_t sse42MinInts(const int64_t *data, size_t n){
+    if(n < 2){
+        return data[0];
+    }
+    __m128i result = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    size_t i = 2;
+    for(; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        result = _mm_blendv_epi8(result, x, _mm_cmpgt_epi64(result, x));
+    }
+    int64_t parts[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(parts), result);
+    int64_t tail = scalarMinInts(parts, 2);
+    for(; i < n; i++){
+        tail = data[i] < tail ? data[i] : tail;
+    }
+    return tail;
+}
+
+SSE42 static int64_t sse42MaxInts(const int64_t *data, size_t n){
+    if(n < 2){
+        return data[0];
+    }
+    __m128i result = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    size_t i = 2;
+    for(; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        result = _mm_blendv_epi8(result, x, _mm_cmpgt_epi64(x, result));
+    }
+    int64_t parts[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(parts), result);
+    int64_t tail = scalarMaxInts(parts, 2);
+    for(; i < n; i++){
+        tail = data[i] > tail ? data[i] : tail;
+    }
+    return tail;
+}
+
+// Two registers make up the same 4 lanes as the scalar version
+SSE42 static double sse42SumFloats(const double *data, size_t n){
+    __m128d low = _mm_setzero_pd();
+    __m128d high = _mm_setzero_pd();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        low = _mm_add_pd(low, _mm_loadu_pd(data + i));
+        high = _mm_add_pd(high, _mm_loadu_pd(data + i + 2));
+    }
+    double lanes[4];
+    _mm_storeu_pd(lanes, low);
+    _mm_storeu_pd(lanes + 2, high);
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for(; i < n; i++){
+        total += data[i];
+    }
+    return total;
+}
+
+SSE42 static void sse42AddFloats(const double *a, const double *b, double *out, size_t n){
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2){
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    scalarAddFloats(a + i, b + i, out + i, n - i);
+}
+
+SSE42 static void sse42SubFloats(const double *a, const double *b, double *out, size_t n){
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2){
+        _mm_storeu_pd(out + i, _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    scalarSubFloats(a + i, b + i, out + i, n - i);
+}
+
+SSE42 static void sse42MulFloats(const double *a, const double *b, double *out, size_t n){
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2){
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    scalarMulFloats(a + i, b + i, out + i, n - i);
+}
+
+SSE42 static double sse42MinFloats(const double *data, size_t n){
+    if(n < 4){
+        return scalarMinFloats(data, n);
+    }
+    __m128d low = _mm_loadu_pd(data);
+    __m128d high = _mm_loadu_pd(data + 2);
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4){
+        low = _mm_min_pd(_mm_loadu_pd(data + i), low);
+        high = _mm_min_pd(_mm_loadu_pd(data + i + 2), high);
+    }
+    double lanes[4];
+    _mm_storeu_pd(lanes, low);
+    _mm_storeu_pd(lanes + 2, high);
+    return combineMinLanes(lanes, data, i, n);
+}
+
+SSE42 static double sse42MaxFloats(const double *data, size_t n){
+    if(n < 4){
+        return scalarMaxFloats(data, n);
+    }
+    __m128d low = _mm_loadu_pd(data);
+    __m128d high = _mm_loadu_pd(data + 2);
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4){
+        low = _mm_max_pd(_mm_loadu_pd(data + i), low);
+        high = _mm_max_pd(_mm_loadu_pd(data + i + 2), high);
+    }
+    double lanes[4];
+    _mm_storeu_pd(lanes, low);
+    _mm_storeu_pd(lanes + 2, high);
+    return combineMaxLanes(lanes, data, i, n);
+}
+
+static const KernelTable sse42Kernels = {
+    sse42BytesEqual, sse42IndexOfByte, sse42IndexOfInt,
+    sse42ReverseBytes, sse42ReverseWords,
+    sse42SumInts, sse42AddInts, sse42SubInts, sse42MinInts, sse42MaxInts,
+    sse42SumFloats, sse42AddFloats, sse42SubFloats, sse42MulFloats, sse42MinFloats, sse42MaxFloats,
+};
+
+// AVX2 versions, 32 bytes or 4 words per register
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static bool avx2BytesEqual(const char *a, const char *b, size_t n){
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        if(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y))) != 0xFFFFFFFF){
+            return false;
+        }
+    }
+    return sse42BytesEqual(a + i, b + i, n - i);
+}
+
+AVX2 static size_t avx2IndexOfByte(const char *data, size_t n, char value){
+    __m256i needle = _mm256_set1_epi8(value);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, needle));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + sse42IndexOfByte(data + i, n - i, value);
+}
+
+AVX2 static size_t avx2IndexOfInt(const int64_t *data, size_t n, int64_t value){
+    __m256i needle = _mm256_set1_epi64x(value);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(x, needle)));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scalarIndexOfInt(data + i, n - i, value);
+}
+
+// The byte shuffle stays within each 128-bit half, the halves are swapped afterwards
+AVX2 static void avx2ReverseBytes(const char *src, char *dst, size_t n){
+    __m256i order = _mm256_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + n - i - 32));
+        x = _mm256_shuffle_epi8(x, order);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute2x128_si256(x, x, 1));
+    }
+    scalarReverseBytes(src, dst + i, n - i);
+}
+
+AVX2 static void avx2ReverseWords(const uint64_t *src, uint64_t *dst, size_t n){
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + n - i - 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(x, 0x1B));
+    }
+    scalarReverseWords(src, dst + i, n - i);
+}
+
+AVX2 static __m256i avx2AddOverflow(__m256i a, __m256i b, __m256i s){
+    return _mm256_and_si256(_mm256_xor_si256(a, s), _mm256_xor_si256(b, s));
+}
+
+AVX2 static bool avx2SumInts(const int64_t *data, size_t n, int64_t &result){
+    __m256i lanes = _mm256_setzero_si256();
+    __m256i overflow = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i s = _mm256_add_epi64(lanes, x);
+        overflow = _mm256_or_si256(overflow, avx2AddOverflow(lanes, x, s));
+        lanes = s;
+    }
+    if(_mm256_movemask_pd(_mm256_castsi256_pd(overflow))){
+        return scalarSumInts(data, n, result);
+    }
+    int64_t parts[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(parts), lanes);
+    __int128 total = static_cast<__int128>(parts[0]) + parts[1] + parts[2] + parts[3];
+    for(; i < n; i++){
+        total += data[i];
+    }
+    return fitsInt(total, result);
+}
+
+AVX2 static bool avx2AddInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    __m256i overflow = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i s = _mm256_add_epi64(x, y);
+        overflow = _mm256_or_si256(overflow, avx2AddOverflow(x, y, s));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), s);
+    }
+    bool ok = !_mm256_movemask_pd(_mm256_castsi256_pd(overflow));
+    return scalarAddInts(a + i, b + i, out + i, n - i) && ok;
+}
+
+AVX2 static bool avx2SubInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    __m256i overflow = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i s = _mm256_sub_epi64(x, y);
+        overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(x, s)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), s);
+    }
+    bool ok = !_mm256_movemask_pd(_mm256_castsi256_pd(overflow));
+    return scalarSubInts(a + i, b + i, out + i, n - i) && ok;
+}
+
+AVX2 static int64_t avx2MinInts(const int64_t *data, size_t n){
+    if(n < 4){
+        return scalarMinInts(data, n);
+    }
+    __m256i result = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        result = _mm256_blendv_epi8(result, x, _mm256_cmpgt_epi64(result, x));
+    }
+    int64_t parts[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(parts), result);
+    int64_t tail = scalarMinInts(parts, 4);
+    for(; i < n; i++){
+        tail = data[i] < tail ? data[i] : tail;
+    }
+    return tail;
+}
+
+AVX2 static int64_t avx2MaxInts(const int64_t *data, size_t n){
+    if(n < 4){
+        return scalarMaxInts(data, n);
+    }
+    __m256i result = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        result = _mm256_blendv_epi8(result, x, _mm256_cmpgt_epi64(x, result));
+    }
+    int64_t parts[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(parts), result);
+    int64_t tail = scalarMaxInts(parts, 4);
+    for(; i < n; i++){
+        tail = data[i] > tail ? data[i] : tail;
+    }
+    return tail;
+}
+
+AVX2 static double avx2SumFloats(const double *data, size_t n){
+    __m256d lanes = _mm256_setzero_pd();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        lanes = _mm256_add_pd(lanes, _mm256_loadu_pd(data + i));
+    }
+    double parts[4];
+    _mm256_storeu_pd(parts, lanes);
+    double total = (parts[0] + parts[1]) + (parts[2] + parts[3]);
+    for(; i < n; i++){
+        total += data[i];
+    }
+    return total;
+}
+
+AVX2 static void avx2AddFloats(const double *a, const double *b, double *out, size_t n){
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    scalarAddFloats(a + i, b + i, out + i, n - i);
+}
+
+AVX2 static void avx2SubFloats(const double *a, const double *b, double *out, size_t n){
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    scalarSubFloats(a + i, b + i, out + i, n - i);
+}
+
+AVX2 static void avx2MulFloats(const double *a, const double *b, double *out, size_t n){
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    scalarMulFloats(a + i, b + i, out + i, n - i);
+}
+
+AVX2 static double avx2MinFloats(const double *data, size_t n){
+    if(n < 4){
+        return scalarMinFloats(data, n);
+    }
+    __m256d lanes = _mm256_loadu_pd(data);
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4){
+        lanes = _mm256_min_pd(_mm256_loadu_pd(data + i), lanes);
+    }
+    double parts[4];
+    _mm256_storeu_pd(parts, lanes);
+    return combineMinLanes(parts, data, i, n);
+}
+
+AVX2 static double avx2MaxFloats(const double *data, size_t n){
+    if(n < 4){
+        return scalarMaxFloats(data, n);
+    }
+    __m256d lanes = _mm256_loadu_pd(data);
+    size_t i = 4;
+    for(; i + 4 <= n; i += 4){
+        lanes = _mm256_max_pd(_mm256_loadu_pd(data + i), lanes);
+    }
+    double parts[4];
+    _mm256_storeu_pd(parts, lanes);
+    return combineMaxLanes(parts, data, i, n);
+}
+
+static const KernelTable avx2Kernels = {
+    avx2BytesEqual, avx2IndexOfByte, avx2IndexOfInt,
+    avx2ReverseBytes, avx2ReverseWords,
+    avx2SumInts, avx2AddInts, avx2SubInts, avx2MinInts, avx2MaxInts,
+    avx2SumFloats, avx2AddFloats, avx2SubFloats, avx2MulFloats, avx2MinFloats, avx2MaxFloats,
+};
+
+#endif
+
+KernelLevel detectKernelLevel(){
+#ifdef PFL_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        return KernelLevel::avx2;
+    }
+    if(__builtin_cpu_supports("sse4.2")){
+        return KernelLevel::sse42;
+    }
+#endif
+    return KernelLevel::scalar;
+}
+
+static const KernelTable* getKernelTable(KernelLevel level){
+#ifdef PFL_X86_KERNELS
+    switch(level){
+    case KernelLevel::avx2:
+        return &avx2Kernels;
+    case KernelLevel::sse42:
+        return &sse42Kernels;
+    default:
+    break;
+    }
+#endif
+    return &scalarKernels;
+}
+
+// Chosen on first use, a static initializer elsewhere may already call a kernel. The tables
+// are constants, so swapping the pointer while other threads run kernels needs no ordering
+static std::atomic<const KernelTable*>& currentKernels(){
+    static std::atomic<const KernelTable*> table = getKernelTable(detectKernelLevel());
+    return table;
+}
+
+static const KernelTable* kernels(){
+    return currentKernels().load(std::memory_order_relaxed);
+}
+
+// Without the x86 kernels every level has the scalar table, the lowest one is reported
+KernelLevel getKernelLevel(){
+    const KernelTable *table = kernels();
+    for(KernelLevel level : { KernelLevel::scalar, KernelLevel::sse42 }){
+        if(getKernelTable(level) == table){
+            return level;
+        }
+    }
+    return KernelLevel::avx2;
+}
+
+void setKernelLevel(KernelLevel level){
+    currentKernels().store(getKernelTable(std::min(level, detectKernelLevel())), std::memory_order_relaxed);
+}
+
+const char* getKernelLevelName(KernelLevel level){
+    return kernelLevelNameLookup[level];
+}
+
+bool bytesEqual(const char *a, const char *b, size_t n){
+    return kernels()->bytesEqual(a, b, n);
+}
+
+size_t indexOfByte(const char *data, size_t n, char value){
+    return kernels()->indexOfByte(data, n, value);
+}
+
+size_t indexOfInt(const int64_t *data, size_t n, int64_t value){
+    return kernels()->indexOfInt(data, n, value);
+}
+
+void reverseBytes(const char *src, char *dst, size_t n){
+    kernels()->reverseBytes(src, dst, n);
+}
+
+void reverseWords(const uint64_t *src, uint64_t *dst, size_t n){
+    kernels()->reverseWords(src, dst, n);
+}
+
+bool sumInts(const int64_t *data, size_t n, int64_t &result){
+    return kernels()->sumInts(data, n, result);
+}
+
+bool addInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    return kernels()->addInts(a, b, out, n);
+}
+
+bool subInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    return kernels()->subInts(a, b, out, n);
+}
+
+bool mulInts(const int64_t *a, const int64_t *b, int64_t *out, size_t n){
+    return scalarMulInts(a, b, out, n);
+}
+
+int64_t minInts(const int64_t *data, size_t n){
+    return kernels()->minInts(data, n);
+}
+
+int64_t maxInts(const int64_t *data, size_t n){
+    return kernels()->maxInts(data, n);
+}
+
+double sumFloats(const double *data, size_t n){
+    return kernels()->sumFloats(data, n);
+}
+
+void addFloats(const double *a, const double *b, double *out, size_t n){
+    kernels()->addFloats(a, b, out, n);
+}
+
+void subFloats(const double *a, const double *b, double *out, size_t n){
+    kernels()->subFloats(a, b, out, n);
+}
+
+void mulFloats(const double *a, const double *b, double *out, size_t n){
+    kernels()->mulFloats(a, b, out, n);
+}
+
+double minFloats(const double *data, size_t n){
+    return kernels()->minFloats(data, n);
+}
+
+double maxFloats(const double *data, size_t n){
+    return kernels()->maxFloats(data, n);
+}
+
+std::string joinStrings(const std::vector<std::string_view> &parts, std::string_view separator){
+    if(parts.empty()){
+        return "";
+    }
+    size_t total = separator.length() * (parts.size() - 1);
+    for(std::string_view part : parts){
+        total += part.length();
+    }
+    std::string result(total, '\0');
+    char *out = result.data();
+    for(size_t i = 0; i < parts.size(); i++){
+        if(i > 0){
+            std::memcpy(out, separator.data(), separator.length());
+            out += separator.length();
+        }
+        std::memcpy(out, parts[i].data(), parts[i].length());
+        out += parts[i].length();
+    }
+    return result;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../include/utils.hpp"
+
+#include <cstdint>
+#include <string_view>
+
+// Array-wide operations on unboxed element buffers. Every kernel has a portable scalar
+// version and, on x86-64, SSE4.2 and AVX2 versions chosen by CPUID on the first call.
+// All versions give bit-identical results: float reductions accumulate in 4 lanes in
+// the same order everywhere, integer overflow is judged on the exact total
+enum class KernelLevel {
+    scalar,
+    sse42,
+    avx2
+};
+
+KernelLevel detectKernelLevel();
+KernelLevel getKernelLevel();
+// Levels above the detected one are clamped, lowering it is meant for benchmarks and equivalence checks
+void setKernelLevel(KernelLevel);
+const char* getKernelLevelName(KernelLevel);
+
+bool bytesEqual(const char*, const char*, size_t);
+// Returns the length when the value isn't found
+size_t indexOfByte(const char*, size_t, char);
+size_t indexOfInt(const int64_t*, size_t, int64_t);
+
+void reverseBytes(const char *src, char *dst, size_t);
+// Ints and floats alike, elements are moved as 64-bit words
+void reverseWords(const uint64_t *src, uint64_t *dst, size_t);
+
+// Return false when the exact result doesn't fit in 64 bits
+bool sumInts(const int64_t*, size_t, int64_t&);
+bool addInts(const int64_t*, const int64_t*, int64_t*, size_t);
+bool subInts(const int64_t*, const int64_t*, int64_t*, size_t);
+bool mulInts(const int64_t*, const int64_t*, int64_t*, size_t);
+// The array must not be empty
+int64_t minInts(const int64_t*, size_t);
+int64_t maxInts(const int64_t*, size_t);
+
+double sumFloats(const double*, size_t);
+void addFloats(const double*, const double*, double*, size_t);
+void subFloats(const double*, const double*, double*, size_t);
+void mulFloats(const double*, const double*, double*, size_t);
+// The array must not be empty. A NaN already in a lane is kept, a NaN element is skipped
+double minFloats(const double*, size_t);
+double maxFloats(const double*, size_t);
+
+// Sizes the result once and copies every part straight into it
+std::string joinStrings(const std::vector<std::string_view>&, std::string_view separator);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../include/utils.hpp"
+
+#include <list>
+#include <unordered_map>
+
+// Result cache of a memoized function keyed on its argument values.
+// Holds at most `capacity` entries, the least recently used one is evicted first.
+// Nothing evaluates calls yet, so --memoize only marks the functions and sizes their
+// caches: no cache is created and report() has no counts to print
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class MemoCache {
+private:
+    using Entry = std::pair<Key, Value>;
+
+    size_t capacity;
+    std::list<Entry> entries;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> lookup;
+public:
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+
+    MemoCache(size_t capacity)
+      : capacity(capacity)
+    {
+        lookup.reserve(capacity);
+    }
+
+    Value* find(const Key &key){
+        auto it = lookup.find(key);
+        if(it == lookup.end()){
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return &it->second->second;
+    }
+
+    void insert(const Key &key, const Value &value){
+        if(capacity == 0){
+            return;
+        }
+        auto it = lookup.find(key);
+        if(it != lookup.end()){
+            it->second->second = value;
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        if(entries.size() == capacity){
+            lookup.erase(entries.back().first);
+            entries.pop_back();
+            evictions++;
+        }
+        entries.emplace_front(key, value);
+        lookup[key] = entries.begin();
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    void report(std::ostream &os, const std::string &name) const {
+        os << name << ": " << hits << " hits, " << misses << " misses, "
+            << evictions << " evictions, " << entries.size() << "/" << capacity << " entries" << std::endl;
+    }
+};
@@ -0,0 +1,130 @@
+#include "number.hpp"
+
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+static_assert(std::endian::native == std::endian::little, "The SWAR digit code expects the first character in the low byte");
+
+static constexpr uint64_t eightDigits = 100000000;
+
+static constexpr uint64_t powersOfTen[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+    1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+    1000000000000000000ull, 10000000000000000000ull
+};
+
+// bit_width * log10(2) estimates the length, at most one too small
+size_t decimalLength(uint64_t value){
+    value |= 1;
+    size_t guess = (std::bit_width(value) * 1233) >> 12;
+    return guess + (value >= powersOfTen[guess]);
+}
+
+// A value below 10^8 as eight ASCII digits, most significant first. The word is split
+// into two 4-digit lanes, those into 2-digit lanes and those into digits, dividing
+// every lane at once by multiplying with a reciprocal
+static uint64_t encodeEightDigits(uint32_t value){
+    uint64_t lanes = (value / 10000) | (uint64_t(value % 10000) << 32);
+    uint64_t high = ((lanes * 10486) >> 20) & 0x0000007F0000007F;
+    lanes = high | ((lanes - high * 100) << 16);
+    high = ((lanes * 103) >> 10) & 0x000F000F000F000F;
+    lanes = high | ((lanes - high * 10) << 8);
+    return lanes + 0x3030303030303030;
+}
+
+char* writeUnsigned(char *out, uint64_t value){
+    if(value < 10){
+        *out = '0' + value;
+        return out + 1;
+    }
+    char *end = out + decimalLength(value);
+    char *pos = end;
+    while(value >= eightDigits){
+        uint64_t digits = encodeEightDigits(value % eightDigits);
+        pos -= 8;
+        std::memcpy(pos, &digits, 8);
+        value /= eightDigits;
+    }
+    uint64_t digits = encodeEightDigits(value);
+    std::memcpy(out, reinterpret_cast<char*>(&digits) + 8 - (pos - out), pos - out);
+    return end;
+}
+
+char* writeInt(char *out, int64_t value){
+    if(value < 0){
+        *out++ = '-';
+        return writeUnsigned(out, 0 - static_cast<uint64_t>(value));
+    }
+    return writeUnsigned(out, value);
+}
+
+char* writeFloat(char *out, double value){
+    return std::to_chars(out, out + maxFloatLength, value).ptr;
+}
+
+static bool isEightDigits(uint64_t word){
+    return ((word & 0xF0F0F0F0F0F0F0F0) |
+        (((word + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+}
+
+// Pairs of digits are combined, then pairs of pairs, then the two halves
+static uint32_t parseEightDigits(uint64_t word){
+    word -= 0x3030303030303030;
+    word = word * 10 + (word >> 8);
+    word = ((word & 0x000000FF000000FF) * (100 + (1000000ull << 32)) +
+        ((word >> 16) & 0x000000FF000000FF) * (1 + (10000ull << 32))) >> 32;
+    return static_cast<uint32_t>(word);
+}
+
+std::optional<int64_t> parseInt(std::string_view text){
+    bool negative = !text.empty() && text[0] == '-';
+    if(!text.empty() && (text[0] == '-' || text[0] == '+')){
+        text.remove_prefix(1);
+    }
+    if(text.empty()){
+        return std::nullopt;
+    }
+    while(text.length() > 1 && text[0] == '0'){
+        text.remove_prefix(1);
+    }
+    // 19 digits always fit in 64 unsigned bits
+    if(text.length() > 19){
+        return std::nullopt;
+    }
+    const char *pos = text.data();
+    const char *end = pos + text.length();
+    uint64_t value = 0;
+    while(end - pos >= 8){
+        uint64_t word;
+        std::memcpy(&word, pos, 8);
+        if(!isEightDigits(word)){
+            return std::nullopt;
+        }
+        value = value * eightDigits + parseEightDigits(word);
+        pos += 8;
+    }
+    for(; pos < end; pos++){
+        if(*pos < '0' || *pos > '9'){
+            return std::nullopt;
+        }
+        value = value * 10 + (*pos - '0');
+    }
+    if(value > uint64_t(INT64_MAX) + negative){
+        return std::nullopt;
+    }
+    return negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
+}
+
+std::optional<double> parseFloat(std::string_view text){
+    if(!text.empty() && text[0] == '+'){
+        text.remove_prefix(1);
+    }
+    double value;
+    std::from_chars_result res = std::from_chars(text.data(), text.data() + text.length(), value);
+    if(res.ec != std::errc() || res.ptr != text.data() + text.length()){
+        return std::nullopt;
+    }
+    return value;
+}
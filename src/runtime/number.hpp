@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Conversions between numbers and text behind toInt, toFloat, printing and format strings.
+// Decimal ints are parsed and written eight digits at a time in a 64-bit word (SWAR).
+// Floats go through std::from_chars and std::to_chars: libstdc++ parses with the
+// Eisel-Lemire algorithm and prints the shortest text that reads back to the same double (Ryu)
+
+// Longest output of writeInt, "-9223372036854775808"
+static constexpr size_t maxIntLength = 20;
+// Longest shortest round trip output of writeFloat, e.g. "-2.2250738585072014e-308"
+static constexpr size_t maxFloatLength = 24;
+
+// Number of decimal digits, 1 for 0
+size_t decimalLength(uint64_t);
+// Writes the decimal text of a value without a terminator, returns the end of the output
+char* writeInt(char *out, int64_t);
+char* writeUnsigned(char *out, uint64_t);
+char* writeFloat(char *out, double);
+
+// Optional sign followed by digits, nothing else. Empty if the text isn't an int or the
+// value doesn't fit in 64 bits
+std::optional<int64_t> parseInt(std::string_view);
+// Anything std::from_chars accepts in general format, an optional leading '+' included
+std::optional<double> parseFloat(std::string_view);
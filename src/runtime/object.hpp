@@ -2,5 +2,121 @@
 
 #include "../include/utils.hpp"
 
-#include <unordered_map>
+#include <atomic>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <utility>
 
+// Header of every heap allocated runtime value. Values are immutable from the language's
+// point of view, so a count of one means nobody else can observe an in-place update.
+// Values reach the thread pool's workers, so the count is atomic: dup only needs the
+// increment itself, the release on drop and the acquire in unique() order every earlier
+// access from another thread before a delete or an in-place update
+struct Object;
+
+// Visits every slot of an object that points to another object, the collector may rewrite it
+using Tracer = std::function<void(Object*&)>;
+
+struct Object {
+    std::atomic<uint32_t> refCount = 1;
+    // Set by the heap. A managed object is freed by the collector, never by drop
+    bool managed = false;
+    bool young = false;
+    bool marked = false;
+    bool remembered = false;
+    Object *forward = nullptr;
+    // Objects are created on every thread, the count is only read once they are done
+    static inline std::atomic<size_t> allocations = 0;
+
+    Object(){
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    Object(const Object&){
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    Object& operator=(const Object&){
+        return *this;
+    }
+    virtual ~Object() = default;
+    virtual void trace(const Tracer&){
+    }
+    // Moves the object out of the nursery into its own old space allocation
+    virtual Object* promote(){
+        throw SystemError("Object type can't be allocated on the heap", __FILE_NAME__, __LINE__);
+    }
+    // Order against another object of the same dynamic type, used by sort. Sorts may compare
+    // from several threads, so an override must not mutate either object
+    virtual std::weak_ordering compare(const Object&) const {
+        throw RuntimeError("Values of this type can't be ordered");
+    }
+};
+
+static void dup(Object *obj){
+    if(obj){
+        obj->refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static void drop(Object *obj){
+    if(obj && obj->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1 && !obj->managed){
+        delete obj;
+    }
+}
+
+template<typename T>
+class Ref {
+private:
+    T *ptr = nullptr;
+public:
+    Ref(){}
+    explicit Ref(T *ptr)
+      : ptr(ptr)
+    {
+    }
+    Ref(const Ref &other)
+      : ptr(other.ptr)
+    {
+        dup(ptr);
+    }
+    Ref(Ref &&other)
+      : ptr(std::exchange(other.ptr, nullptr))
+    {
+    }
+    Ref& operator=(Ref other){
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+    ~Ref(){
+        drop(ptr);
+    }
+    T* get() const {
+        return ptr;
+    }
+    T* operator->() const {
+        return ptr;
+    }
+    T& operator*() const {
+        return *ptr;
+    }
+    bool unique() const {
+        return ptr && ptr->refCount.load(std::memory_order_acquire) == 1;
+    }
+};
+
+template<typename T, typename... Args>
+static Ref<T> makeRef(Args&&... args){
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+// Applies an update to a value it consumes. When the caller moved in the last reference
+// (the optimizer marks such identifiers as lastUse) the value is updated in place,
+// otherwise the update goes to a fresh copy and the shared original stays untouched
+template<typename T, typename F>
+static Ref<T> reuseOrCopy(Ref<T> value, F &&update){
+    if(!value.unique()){
+        value = makeRef<T>(*value);
+    }
+    update(*value);
+    return value;
+}
@@ -4,6 +4,9 @@
 #include "../include/parser.hpp"
 #include "../token/token.hpp"
 #include "../ast/print.hpp"
+#include "jit.hpp"
+#include "shape.hpp"
+#include "thread-pool.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -39,13 +42,23 @@ ReplReadLineStatus replReadLine(std::stringstream &stream, std::string &line){
     return ReplReadLineStatus::success;
 }
 
-void repl(){
+void repl(const InterpreterOptions &options){
     std::cout << "P[ainfully] F[unctional] L[anguage] Early Development Build" << std::endl;
     std::cout << "Tip - Type\033[36m q\033[0m to quit" << std::endl;
     std::stringstream sstream;
     std::string line;
+    ThreadPool::setGlobalThreads(options.threads);
     Lexer lexer = Lexer(&sstream);
     Parser parser;
+    Optimizer optimizer(options.optimizer);
+    // Nothing evaluates the inputs yet, every site is reported as not reached
+    InlineCacheTable<uint32_t> methodCaches;
+    FieldCacheTable fieldCaches;
+    // Functions of earlier lines stay callable from later ones
+    Jit jit;
+    if(options.jit){
+        std::cout << "jit: no execution path calls compiled code yet" << std::endl;
+    }
     while(true){
         int lineNum = 0;
         if(replReadLine(sstream, line) == ReplReadLineStatus::quit){
@@ -59,6 +72,26 @@ void repl(){
             }
             std::cout << "]" << std::endl;
             AstNode* ast = parser.parse(tokens);
+            ast = optimizer.optimize(ast);
+            if(options.inlineReport){
+                for(const std::string &line : optimizer.getInlined()){
+                    std::cout << line << std::endl;
+                }
+            }
+            if(options.escapeReport){
+                optimizer.getEscapeStats().report(std::cout);
+            }
+            if(options.cacheReport){
+                methodCaches.addSites(optimizer.getInlineCacheSites());
+                fieldCaches.addSites(optimizer.getFieldCacheSites());
+                std::cout << "method calls" << std::endl;
+                methodCaches.report(std::cout);
+                std::cout << "field loads" << std::endl;
+                fieldCaches.report(std::cout);
+            }
+            if(options.jit){
+                jit.report(ast, std::cout);
+            }
             printAst(ast);
         } catch(LexerError err){
             std::cerr << err.what() << std::endl;
@@ -66,6 +99,9 @@ void repl(){
         } catch(ParserError err){
             std::cerr << err.what() << std::endl;
             return;
+        } catch(TypeError err){
+            std::cerr << err.what() << std::endl;
+            return;
         } catch(SystemError err){
             std::cerr << err.what() << std::endl;
             return;
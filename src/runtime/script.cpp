@@ -2,13 +2,17 @@
 #include "../include/lexer.hpp"
 #include "../include/parser.hpp"
 #include "../ast/print.hpp"
+#include "jit.hpp"
+#include "shape.hpp"
+#include "thread-pool.hpp"
 
-void script(const std::string &path){
+void script(const std::string &path, const InterpreterOptions &options){
     std::ifstream is(path);
     if(!is.is_open()){
         std::cerr << "Could not open file `" << path << "`" << std::endl;
         return;
     }
+    ThreadPool::setGlobalThreads(options.threads);
     Lexer lexer = Lexer(&is);
     try {
         std::vector<Token> tokens = lexer.getTokens();
@@ -19,12 +23,44 @@ void script(const std::string &path){
         std::cout << "]" << std::endl;
         Parser parser;
         AstNode* ast = parser.parse(tokens);
-        printAst(ast);
+        OptimizerOptions optimizerOptions = options.optimizer;
+        optimizerOptions.wholeProgram = true;
+        Optimizer optimizer(optimizerOptions);
+        ast = optimizer.optimize(ast);
+        if(options.inlineReport){
+            for(const std::string &line : optimizer.getInlined()){
+                std::cout << line << std::endl;
+            }
+        }
+        if(options.escapeReport){
+            optimizer.getEscapeStats().report(std::cout);
+        }
+        if(options.cacheReport){
+            // Nothing evaluates the program yet, every site is reported as not reached
+            InlineCacheTable<uint32_t> methodCaches;
+            FieldCacheTable fieldCaches;
+            methodCaches.addSites(optimizer.getInlineCacheSites());
+            fieldCaches.addSites(optimizer.getFieldCacheSites());
+            std::cout << "method calls" << std::endl;
+            methodCaches.report(std::cout);
+            std::cout << "field loads" << std::endl;
+            fieldCaches.report(std::cout);
+        }
+        if(options.jit){
+            std::cout << "jit: no execution path calls compiled code yet" << std::endl;
+            Jit jit;
+            jit.report(ast, std::cout);
+        }
+        if(options.dumpAst){
+            printAst(ast);
+        }
     } catch(SystemError err){
         std::cout << err.what() << std::endl;
     } catch(LexerError err){
         std::cout << err.what() << std::endl;
     } catch(ParserError err){
         std::cout << err.what() << std::endl;
+    } catch(TypeError err){
+        std::cout << err.what() << std::endl;
     }
 }
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "shape.hpp"
+
+#include <new>
+
+Shape::Shape(std::vector<std::string> fields)
+  : fields(std::move(fields)), id(nextId++)
+{
+    if(this->fields.size() > shapeLinearLookupMaximum){
+        for(uint32_t slot = 0; slot < this->fields.size(); slot++){
+            slots.emplace(this->fields[slot], slot);
+        }
+    }
+}
+
+Shape* Shape::root(){
+    static Shape *root = new Shape({});
+    return root;
+}
+
+Shape* Shape::forFields(const std::vector<std::string> &fields){
+    Shape *shape = root();
+    for(const std::string &field : fields){
+        shape = shape->withField(field);
+    }
+    return shape;
+}
+
+// Records may be built on pool threads, transitions are shared by all of them
+Shape* Shape::withField(const std::string &field){
+    std::lock_guard<std::mutex> lock(transitionsMutex);
+    std::unique_ptr<Shape> &child = transitions[field];
+    if(!child){
+        if(slotOf(field)){
+            throw RuntimeError("Duplicate record field `" + field + "`");
+        }
+        std::vector<std::string> childFields = fields;
+        childFields.push_back(field);
+        child.reset(new Shape(std::move(childFields)));
+    }
+    return child.get();
+}
+
+std::optional<uint32_t> Shape::slotOf(std::string_view field) const {
+    if(fields.size() <= shapeLinearLookupMaximum){
+        for(uint32_t slot = 0; slot < fields.size(); slot++){
+            if(fields[slot] == field){
+                return slot;
+            }
+        }
+        return std::nullopt;
+    }
+    auto it = slots.find(field);
+    if(it == slots.end()){
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+size_t Shape::size() const {
+    return fields.size();
+}
+
+const std::vector<std::string>& Shape::getFields() const {
+    return fields;
+}
+
+// Slots start at the first Element aligned offset after the header
+static constexpr size_t recordSlotsOffset = (sizeof(Record) + alignof(Element) - 1) / alignof(Element) * alignof(Element);
+
+Record::Record(Shape *shape)
+  : shape(shape)
+{
+    std::uninitialized_value_construct_n(slots(), shape->size());
+}
+
+Record* Record::make(Shape *shape){
+    void *memory = ::operator new(recordSlotsOffset + shape->size() * sizeof(Element));
+    return new(memory) Record(shape);
+}
+
+void Record::operator delete(void *memory){
+    ::operator delete(memory);
+}
+
+Record::~Record(){
+    for(size_t i = 0; i < size(); i++){
+        if(std::holds_alternative<Object*>(slots()[i])){
+            drop(std::get<Object*>(slots()[i]));
+        }
+    }
+    std::destroy_n(slots(), size());
+}
+
+Element* Record::slots(){
+    return reinterpret_cast<Element*>(reinterpret_cast<char*>(this) + recordSlotsOffset);
+}
+
+const Element* Record::slots() const {
+    return reinterpret_cast<const Element*>(reinterpret_cast<const char*>(this) + recordSlotsOffset);
+}
+
+size_t Record::size() const {
+    return shape->size();
+}
+
+const Element& Record::get(uint32_t slot) const {
+    return slots()[slot];
+}
+
+const Element& Record::get(std::string_view field) const {
+    std::optional<uint32_t> slot = shape->slotOf(field);
+    if(!slot){
+        throw RuntimeError("Record has no field `" + std::string(field) + "`");
+    }
+    return slots()[*slot];
+}
+
+void Record::set(uint32_t slot, const Element &value){
+    if(std::holds_alternative<Object*>(value)){
+        dup(std::get<Object*>(value));
+    }
+    if(std::holds_alternative<Object*>(slots()[slot])){
+        drop(std::get<Object*>(slots()[slot]));
+    }
+    slots()[slot] = value;
+}
+
+Record* Record::copy() const {
+    Record *result = make(shape);
+    for(uint32_t slot = 0; slot < size(); slot++){
+        result->set(slot, get(slot));
+    }
+    return result;
+}
+
+Record* Record::withField(const std::string &field, const Element &value) const {
+    Record *result = make(shape->withField(field));
+    for(uint32_t slot = 0; slot < size(); slot++){
+        result->set(slot, get(slot));
+    }
+    result->set(size(), value);
+    return result;
+}
+
+void Record::trace(const Tracer &tracer){
+    for(size_t i = 0; i < size(); i++){
+        if(std::holds_alternative<Object*>(slots()[i])){
+            tracer(std::get<Object*>(slots()[i]));
+        }
+    }
+}
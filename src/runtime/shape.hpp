@@ -0,0 +1,84 @@
+#pragma once
+
+#include "array.hpp"
+#include "inline-cache.hpp"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+// Shape ids leave room for every ValueType below them, inline caches key on both
+static constexpr ShapeId firstShapeId = 256;
+// Shapes with up to this many fields find a slot by scanning, larger ones use a map
+static constexpr size_t shapeLinearLookupMaximum = 8;
+
+// Layout shared by every record whose fields were added in the same order, a hidden class.
+// Shapes form a tree under the empty root shape. Adding a field follows the transition to
+// a child shape, creating it the first time, so records of one type share one Shape and a
+// member access needs one inline cache entry. Shapes live for the whole run
+class Shape {
+private:
+    static inline std::mutex transitionsMutex;
+    static inline ShapeId nextId = firstShapeId;
+
+    std::vector<std::string> fields;
+    std::unordered_map<std::string_view, uint32_t> slots;
+    std::unordered_map<std::string, std::unique_ptr<Shape>> transitions;
+
+    Shape(std::vector<std::string> fields);
+public:
+    const ShapeId id;
+
+    static Shape* root();
+    // Root shape extended by each field in turn, the layout of a record type
+    static Shape* forFields(const std::vector<std::string>&);
+    Shape* withField(const std::string&);
+    std::optional<uint32_t> slotOf(std::string_view) const;
+    size_t size() const;
+    const std::vector<std::string>& getFields() const;
+};
+
+// Record instance: its shape and the field values in slot order, stored inline right after
+// the header in the same allocation. A field is read by loading its slot, no name lookup
+struct Record : public Object {
+private:
+    Record(Shape*);
+    Element* slots();
+    const Element* slots() const;
+public:
+    Shape *const shape;
+
+    // Every slot starts as int 0
+    static Record* make(Shape*);
+    // Slots are allocated together with the header, see make
+    static void operator delete(void*);
+    Record(const Record&) = delete;
+    Record& operator=(const Record&) = delete;
+    ~Record();
+
+    size_t size() const;
+    const Element& get(uint32_t slot) const;
+    // Throws a RuntimeError if the shape has no such field
+    const Element& get(std::string_view field) const;
+    void set(uint32_t slot, const Element&);
+    Record* copy() const;
+    // Copy with one more field, values are immutable so records grow into new ones
+    Record* withField(const std::string&, const Element&) const;
+    void trace(const Tracer&) override;
+};
+
+// Field loads use the inline cache machinery too, the cached target is the slot
+using FieldCacheTable = InlineCacheTable<uint32_t>;
+
+// Reads `record.field` at a site the optimizer gave an inline cache slot (Identifier::inlineCache)
+static const Element& loadField(FieldCacheTable &table, size_t site, const Record &record){
+    uint32_t slot = table.lookup(site, record.shape->id, [&record](ShapeId, const std::string &field){
+        std::optional<uint32_t> slot = record.shape->slotOf(field);
+        if(!slot){
+            throw RuntimeError("Record has no field `" + field + "`");
+        }
+        return *slot;
+    });
+    return record.get(slot);
+}
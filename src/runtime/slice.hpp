@@ -0,0 +1,125 @@
+#pragma once
+
+#include "object.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Storage shared by a sequence and every slice taken from it
+template<typename T>
+struct SequenceBuffer : public Object {
+    std::vector<T> elements;
+
+    SequenceBuffer(std::vector<T> elements)
+      : elements(std::move(elements))
+    {
+    }
+};
+
+// A slice keeping less than 1/sliceRetainRatio of a buffer of at least
+// sliceRetainMinimum elements is copied out rather than keep the whole buffer alive
+static constexpr size_t sliceRetainMinimum = 4096;
+static constexpr size_t sliceRetainRatio = 8;
+
+struct SliceBounds {
+    size_t offset;
+    size_t length;
+    long long stride;
+};
+
+// Resolves `[start : stop : step]` against a sequence of `size` elements. Negative positions
+// count from the end, out of range ones are clamped and missing ones cover the whole
+// sequence in the direction of the step
+static SliceBounds normalizeSlice(size_t size, std::optional<long long> start, std::optional<long long> stop, long long step){
+    if(step == 0){
+        throw RuntimeError("Slice step can't be zero");
+    }
+    long long n = size;
+    auto resolve = [n](long long pos, long long low, long long high){
+        if(pos < 0){
+            pos += n;
+        }
+        return std::clamp(pos, low, high);
+    };
+    if(step > 0){
+        long long first = start ? resolve(*start, 0, n) : 0;
+        long long last = stop ? resolve(*stop, 0, n) : n;
+        size_t length = last > first ? (last - first + step - 1) / step : 0;
+        return { static_cast<size_t>(first), length, step };
+    }
+    long long first = start ? resolve(*start, -1, n - 1) : n - 1;
+    long long last = stop ? resolve(*stop, -1, n - 1) : -1;
+    size_t length = first > last ? (first - last - step - 1) / -step : 0;
+    return { static_cast<size_t>(first < 0 ? 0 : first), length, step };
+}
+
+// A view of every stride-th element of a shared buffer, starting at offset. Taking a slice
+// of a slice only composes the bounds, so walking down a sequence one element at a time
+// (`str[1:]` in a recursive function) costs O(1) per step instead of copying the tail
+template<typename T>
+class Slice {
+private:
+    Ref<SequenceBuffer<T>> base;
+    size_t offset = 0;
+    size_t length = 0;
+    long long stride = 1;
+public:
+    Slice(Ref<SequenceBuffer<T>> base)
+      : base(std::move(base))
+    {
+        length = this->base->elements.size();
+    }
+    Slice(Ref<SequenceBuffer<T>> base, size_t offset, size_t length, long long stride)
+      : base(std::move(base)), offset(offset), length(length), stride(stride)
+    {
+    }
+    const T& operator[](size_t i) const {
+        return base->elements[offset + i * stride];
+    }
+    size_t size() const {
+        return length;
+    }
+    bool contiguous() const {
+        return stride == 1 || length <= 1;
+    }
+    Slice slice(std::optional<long long> start, std::optional<long long> stop, long long step = 1) const {
+        SliceBounds bounds = normalizeSlice(length, start, stop, step);
+        if(bounds.length == 0){
+            return Slice(base, offset, 0, 1);
+        }
+        return Slice(base, offset + bounds.offset * stride, bounds.length, stride * bounds.stride);
+    }
+    // Only valid for contiguous slices
+    std::basic_string_view<T> view() const {
+        return std::basic_string_view<T>(base->elements.data() + offset, length);
+    }
+    std::vector<T> materialize() const {
+        if(contiguous()){
+            return std::vector<T>(base->elements.begin() + offset, base->elements.begin() + offset + length);
+        }
+        std::vector<T> elements;
+        elements.reserve(length);
+        for(size_t i = 0; i < length; i++){
+            elements.push_back((*this)[i]);
+        }
+        return elements;
+    }
+    // Called when the slice outlives the value it was taken from. Once it holds the last
+    // reference, a small part of a large buffer is copied out so the buffer can be freed
+    Slice compact() const {
+        size_t total = base->elements.size();
+        if(base.unique() && total >= sliceRetainMinimum && length * sliceRetainRatio < total){
+            return Slice(makeRef<SequenceBuffer<T>>(materialize()));
+        }
+        return *this;
+    }
+};
+
+// Strings are byte sequences, their slices share the same machinery
+using StringSlice = Slice<char>;
+
+static StringSlice makeStringSlice(std::string_view str){
+    return StringSlice(makeRef<SequenceBuffer<char>>(std::vector<char>(str.begin(), str.end())));
+}
@@ -0,0 +1,100 @@
+#include "sort.hpp"
+
+#include <utility>
+
+void sortBytes(char *data, size_t count){
+    size_t counts[256] = {};
+    for(size_t i = 0; i < count; i++){
+        counts[static_cast<unsigned char>(data[i])]++;
+    }
+    char *out = data;
+    for(int byte = 0; byte < 256; byte++){
+        out = std::fill_n(out, counts[byte], static_cast<char>(byte));
+    }
+}
+
+// LSD radix sort on 8-bit digits. All eight histograms are built in one pass,
+// a digit that is the same in every key is skipped
+static void radixSortKeys(uint64_t *data, size_t count){
+    if(count < 2){
+        return;
+    }
+    std::vector<std::array<size_t, 256>> histograms(8);
+    for(size_t i = 0; i < count; i++){
+        for(int digit = 0; digit < 8; digit++){
+            histograms[digit][(data[i] >> (8 * digit)) & 0xFF]++;
+        }
+    }
+    std::vector<uint64_t> buffer(count);
+    uint64_t *from = data;
+    uint64_t *to = buffer.data();
+    for(int digit = 0; digit < 8; digit++){
+        std::array<size_t, 256> &histogram = histograms[digit];
+        if(histogram[(from[0] >> (8 * digit)) & 0xFF] == count){
+            continue;
+        }
+        size_t offset = 0;
+        for(size_t &bucket : histogram){
+            offset += std::exchange(bucket, offset);
+        }
+        for(size_t i = 0; i < count; i++){
+            to[histogram[(from[i] >> (8 * digit)) & 0xFF]++] = from[i];
+        }
+        std::swap(from, to);
+    }
+    if(from != data){
+        std::copy(from, from + count, data);
+    }
+}
+
+// Large inputs are split over the thread pool, each chunk radix sorted and the runs merged
+void sortKeys(uint64_t *data, size_t count){
+    ThreadPool &pool = ThreadPool::global();
+    if(count >= parallelSortMinimum && pool.size() > 1){
+        parallelMergeSort(data, count, std::less<uint64_t>(), pool, radixSortKeys);
+    } else if(count >= radixSortMinimum){
+        radixSortKeys(data, count);
+    } else {
+        pdqSort(data, data + count, std::less<uint64_t>());
+    }
+}
+
+// Ints spanning a range no larger than the array are counted instead
+void sortInts(int64_t *data, size_t count){
+    if(count < 2){
+        return;
+    }
+    auto [low, high] = std::minmax_element(data, data + count);
+    uint64_t range = static_cast<uint64_t>(*high) - static_cast<uint64_t>(*low);
+    if(range < count && range < (1 << 20)){
+        int64_t min = *low;
+        std::vector<size_t> counts(range + 1);
+        for(size_t i = 0; i < count; i++){
+            counts[data[i] - min]++;
+        }
+        int64_t *out = data;
+        for(size_t value = 0; value <= range; value++){
+            out = std::fill_n(out, counts[value], min + static_cast<int64_t>(value));
+        }
+        return;
+    }
+    std::vector<uint64_t> keys(count);
+    for(size_t i = 0; i < count; i++){
+        keys[i] = intSortKey(data[i]);
+    }
+    sortKeys(keys.data(), count);
+    for(size_t i = 0; i < count; i++){
+        data[i] = static_cast<int64_t>(keys[i] ^ (uint64_t(1) << 63));
+    }
+}
+
+void sortFloats(double *data, size_t count){
+    std::vector<uint64_t> keys(count);
+    for(size_t i = 0; i < count; i++){
+        keys[i] = floatSortKey(data[i]);
+    }
+    sortKeys(keys.data(), count);
+    for(size_t i = 0; i < count; i++){
+        data[i] = floatFromSortKey(keys[i]);
+    }
+}
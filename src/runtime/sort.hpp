@@ -0,0 +1,249 @@
+#pragma once
+
+#include "thread-pool.hpp"
+
+#include <bit>
+#include <cstdint>
+
+// Sorting behind the built-in sort and sortBy. Which algorithm runs depends on the array
+// storage, see Array::sorted. Stability:
+// - bytes, ints and floats: equal elements are indistinguishable, the question doesn't arise.
+//   Floats are ordered totally: -NaN < -inf < ... < -0.0 < 0.0 < ... < inf < NaN
+// - generic elements and sortBy: stable, elements or keys that compare equal keep their
+//   original order. Pdqsort on (element, index) pairs, see Array::sortedBy
+
+// Below this many elements radix and parallel sorts don't pay for their setup
+static constexpr size_t radixSortMinimum = 64;
+static constexpr size_t parallelSortMinimum = 1 << 16;
+
+// Counting sort, bytes compare as unsigned like strings do
+void sortBytes(char*, size_t);
+// Sorts unsigned keys, LSD radix sort for larger inputs
+void sortKeys(uint64_t*, size_t);
+void sortInts(int64_t*, size_t);
+void sortFloats(double*, size_t);
+
+// Maps values to unsigned keys with the same order
+static uint64_t intSortKey(int64_t value){
+    return static_cast<uint64_t>(value) ^ (uint64_t(1) << 63);
+}
+
+static uint64_t floatSortKey(double value){
+    uint64_t bits = std::bit_cast<uint64_t>(value);
+    return bits >> 63 ? ~bits : bits | (uint64_t(1) << 63);
+}
+
+static double floatFromSortKey(uint64_t key){
+    return std::bit_cast<double>(key >> 63 ? key & ~(uint64_t(1) << 63) : ~key);
+}
+
+// Pattern-defeating quicksort. Introsort with a median-of-3 (ninther for large ranges)
+// pivot, a partition that recognizes already sorted runs, a shuffle of unbalanced
+// partitions and a heapsort fallback that bounds the worst case to O(n log n)
+static constexpr size_t pdqInsertionThreshold = 24;
+static constexpr size_t pdqNintherThreshold = 128;
+static constexpr size_t pdqPartialInsertionLimit = 8;
+
+template<typename It, typename Less>
+static void pdqInsertionSort(It begin, It end, Less less, bool guarded){
+    if(begin == end){
+        return;
+    }
+    for(It cur = begin + 1; cur != end; ++cur){
+        It sift = cur;
+        It prev = cur - 1;
+        if(less(*sift, *prev)){
+            auto tmp = std::move(*sift);
+            do {
+                *sift-- = std::move(*prev);
+            } while((!guarded || sift != begin) && less(tmp, *--prev));
+            *sift = std::move(tmp);
+        }
+    }
+}
+
+// Gives up after moving pdqPartialInsertionLimit elements, the range wasn't nearly sorted
+template<typename It, typename Less>
+static bool pdqPartialInsertionSort(It begin, It end, Less less){
+    if(begin == end){
+        return true;
+    }
+    size_t moved = 0;
+    for(It cur = begin + 1; cur != end; ++cur){
+        It sift = cur;
+        It prev = cur - 1;
+        if(less(*sift, *prev)){
+            auto tmp = std::move(*sift);
+            do {
+                *sift-- = std::move(*prev);
+            } while(sift != begin && less(tmp, *--prev));
+            *sift = std::move(tmp);
+            moved += cur - sift;
+        }
+        if(moved > pdqPartialInsertionLimit){
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename It, typename Less>
+static void pdqSort3(It a, It b, It c, Less less){
+    if(less(*b, *a)){
+        std::iter_swap(a, b);
+    }
+    if(less(*c, *b)){
+        std::iter_swap(b, c);
+    }
+    if(less(*b, *a)){
+        std::iter_swap(a, b);
+    }
+}
+
+// Partitions around the pivot at *begin, equal elements go right. Also reports whether
+// the range was already partitioned, then it's likely sorted
+template<typename It, typename Less>
+static std::pair<It, bool> pdqPartitionRight(It begin, It end, Less less){
+    auto pivot = std::move(*begin);
+    It first = begin;
+    It last = end;
+    while(less(*++first, pivot));
+    if(first - 1 == begin){
+        while(first < last && !less(*--last, pivot));
+    } else {
+        while(!less(*--last, pivot));
+    }
+    bool partitioned = first >= last;
+    while(first < last){
+        std::iter_swap(first, last);
+        while(less(*++first, pivot));
+        while(!less(*--last, pivot));
+    }
+    It pivotPos = first - 1;
+    *begin = std::move(*pivotPos);
+    *pivotPos = std::move(pivot);
+    return { pivotPos, partitioned };
+}
+
+// Equal elements go left. Used when the pivot equals the element before the range,
+// a run of equal elements is then handled in linear time
+template<typename It, typename Less>
+static It pdqPartitionLeft(It begin, It end, Less less){
+    auto pivot = std::move(*begin);
+    It first = begin;
+    It last = end;
+    while(less(pivot, *--last));
+    if(last + 1 == end){
+        while(first < last && !less(pivot, *++first));
+    } else {
+        while(!less(pivot, *++first));
+    }
+    while(first < last){
+        std::iter_swap(first, last);
+        while(less(pivot, *--last));
+        while(!less(pivot, *++first));
+    }
+    *begin = std::move(*last);
+    *last = std::move(pivot);
+    return last;
+}
+
+template<typename It>
+static void pdqBreakPatterns(It begin, It end){
+    size_t size = end - begin;
+    if(size < pdqInsertionThreshold){
+        return;
+    }
+    std::iter_swap(begin, begin + size / 4);
+    std::iter_swap(end - 1, end - size / 4);
+    if(size > pdqNintherThreshold){
+        std::iter_swap(begin + 1, begin + (size / 4 + 1));
+        std::iter_swap(begin + 2, begin + (size / 4 + 2));
+        std::iter_swap(end - 2, end - (size / 4 + 1));
+        std::iter_swap(end - 3, end - (size / 4 + 2));
+    }
+}
+
+template<typename It, typename Less>
+static void pdqSortLoop(It begin, It end, Less less, int badAllowed, bool leftmost){
+    while(true){
+        size_t size = end - begin;
+        if(size < pdqInsertionThreshold){
+            pdqInsertionSort(begin, end, less, leftmost);
+            return;
+        }
+        size_t half = size / 2;
+        if(size > pdqNintherThreshold){
+            pdqSort3(begin, begin + half, end - 1, less);
+            pdqSort3(begin + 1, begin + (half - 1), end - 2, less);
+            pdqSort3(begin + 2, begin + (half + 1), end - 3, less);
+            pdqSort3(begin + (half - 1), begin + half, begin + (half + 1), less);
+            std::iter_swap(begin, begin + half);
+        } else {
+            pdqSort3(begin + half, begin, end - 1, less);
+        }
+        if(!leftmost && !less(*(begin - 1), *begin)){
+            begin = pdqPartitionLeft(begin, end, less) + 1;
+            continue;
+        }
+        auto [pivotPos, partitioned] = pdqPartitionRight(begin, end, less);
+        size_t leftSize = pivotPos - begin;
+        size_t rightSize = end - (pivotPos + 1);
+        if(leftSize < size / 8 || rightSize < size / 8){
+            if(--badAllowed == 0){
+                std::make_heap(begin, end, less);
+                std::sort_heap(begin, end, less);
+                return;
+            }
+            pdqBreakPatterns(begin, pivotPos);
+            pdqBreakPatterns(pivotPos + 1, end);
+        } else if(partitioned && pdqPartialInsertionSort(begin, pivotPos, less) &&
+            pdqPartialInsertionSort(pivotPos + 1, end, less)){
+            return;
+        }
+        pdqSortLoop(begin, pivotPos, less, badAllowed, leftmost);
+        begin = pivotPos + 1;
+        leftmost = false;
+    }
+}
+
+template<typename It, typename Less>
+static void pdqSort(It begin, It end, Less less){
+    if(end - begin < 2){
+        return;
+    }
+    pdqSortLoop(begin, end, less, std::bit_width(static_cast<size_t>(end - begin)), true);
+}
+
+// Sorts chunks on the pool with `sortChunk`, then merges neighbouring runs in parallel
+// rounds. std::merge takes from the left run on ties, so the merge keeps a stable chunk sort stable
+template<typename T, typename Less, typename SortChunk>
+static void parallelMergeSort(T *data, size_t count, Less less, ThreadPool &pool, SortChunk sortChunk){
+    size_t chunks = std::bit_ceil(std::max<size_t>(pool.size(), 1));
+    size_t chunkSize = (count + chunks - 1) / chunks;
+    pool.parallelFor(chunks, 1, [&](size_t begin, size_t end){
+        for(size_t chunk = begin; chunk < end; chunk++){
+            size_t first = std::min(count, chunk * chunkSize);
+            sortChunk(data + first, std::min(count, first + chunkSize) - first);
+        }
+    });
+    std::vector<T> buffer(count);
+    T *from = data;
+    T *to = buffer.data();
+    for(size_t width = chunkSize; width < count; width *= 2){
+        size_t pairs = (count + 2 * width - 1) / (2 * width);
+        pool.parallelFor(pairs, 1, [&](size_t begin, size_t end){
+            for(size_t pair = begin; pair < end; pair++){
+                size_t first = pair * 2 * width;
+                size_t middle = std::min(count, first + width);
+                size_t last = std::min(count, first + 2 * width);
+                std::merge(std::make_move_iterator(from + first), std::make_move_iterator(from + middle),
+                    std::make_move_iterator(from + middle), std::make_move_iterator(from + last), to + first, less);
+            }
+        });
+        std::swap(from, to);
+    }
+    if(from != data){
+        std::move(from, from + count, data);
+    }
+}
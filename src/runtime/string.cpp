@@ -0,0 +1,235 @@
+#include "string.hpp"
+#include "kernels.hpp"
+#include "sort.hpp"
+
+#include <cstring>
+
+StringData::StringData(std::string text)
+  : flat(std::move(text)), length(flat.length()), hasFlat(true)
+{
+}
+
+StringData::StringData(Ref<StringData> left, Ref<StringData> right)
+  : left(std::move(left)), right(std::move(right)), hasFlat(false)
+{
+    length = this->left->length + this->right->length;
+}
+
+// Long chains like `((a + b) + c) + ...` would otherwise be released recursively,
+// one stack frame per link
+StringData::~StringData(){
+    std::vector<Ref<StringData>> pending;
+    pending.push_back(std::move(left));
+    pending.push_back(std::move(right));
+    while(!pending.empty()){
+        Ref<StringData> node = std::move(pending.back());
+        pending.pop_back();
+        if(node.unique()){
+            pending.push_back(std::move(node->left));
+            pending.push_back(std::move(node->right));
+        }
+    }
+}
+
+bool StringData::isRope() const {
+    return !hasFlat.load(std::memory_order_acquire);
+}
+
+// Walks the rope left to right with an explicit stack, rope depth is unbounded
+void StringData::flatten(){
+    if(isRope()){
+        std::call_once(flattened, [this]{
+            std::string text(length, '\0');
+            char *out = text.data();
+            std::vector<const StringData*> stack = { this };
+            while(!stack.empty()){
+                const StringData *node = stack.back();
+                stack.pop_back();
+                if(node->isRope()){
+                    stack.push_back(node->right.get());
+                    stack.push_back(node->left.get());
+                } else {
+                    std::memcpy(out, node->flat.data(), node->flat.length());
+                    out += node->flat.length();
+                }
+            }
+            flat = std::move(text);
+            hasFlat.store(true, std::memory_order_release);
+        });
+    }
+    if(refCount.load(std::memory_order_acquire) == 1 && left.get()){
+        left = Ref<StringData>();
+        right = Ref<StringData>();
+    }
+}
+
+// Text of a rope copied out without touching the rope, same walk as flatten
+static std::string copyText(const StringData &data){
+    std::string text;
+    text.reserve(data.length);
+    std::vector<const StringData*> stack = { &data };
+    while(!stack.empty()){
+        const StringData *node = stack.back();
+        stack.pop_back();
+        if(node->isRope()){
+            stack.push_back(node->right.get());
+            stack.push_back(node->left.get());
+        } else {
+            text += node->flat;
+        }
+    }
+    return text;
+}
+
+std::weak_ordering StringData::compare(const Object &other) const {
+    const StringData &b = static_cast<const StringData&>(other);
+    std::string leftCopy = isRope() ? copyText(*this) : std::string();
+    std::string rightCopy = b.isRope() ? copyText(b) : std::string();
+    std::string_view x = isRope() ? std::string_view(leftCopy) : std::string_view(flat);
+    std::string_view y = b.isRope() ? std::string_view(rightCopy) : std::string_view(b.flat);
+    // char_traits<char> compares bytes as unsigned
+    return x.compare(y) <=> 0;
+}
+
+void StringData::trace(const Tracer &tracer){
+}
+
+String::String()
+  : inlineLength(0)
+{
+}
+
+String::String(std::string_view text){
+    if(text.length() <= inlineCapacity){
+        std::memcpy(inlineText, text.data(), text.length());
+        inlineLength = text.length();
+    } else {
+        setData(new StringData(std::string(text)));
+    }
+}
+
+String::String(Ref<StringData> shared){
+    dup(shared.get());
+    setData(shared.get());
+}
+
+String::String(const String &other)
+  : inlineLength(other.inlineLength)
+{
+    std::memcpy(inlineText, other.inlineText, sizeof(inlineText));
+    if(!isInline()){
+        dup(data());
+    }
+}
+
+String::String(String &&other)
+  : inlineLength(other.inlineLength)
+{
+    std::memcpy(inlineText, other.inlineText, sizeof(inlineText));
+    other.inlineLength = 0;
+}
+
+String& String::operator=(String other){
+    char swapped[sizeof(inlineText)];
+    std::memcpy(swapped, inlineText, sizeof(inlineText));
+    std::memcpy(inlineText, other.inlineText, sizeof(inlineText));
+    std::memcpy(other.inlineText, swapped, sizeof(inlineText));
+    std::swap(inlineLength, other.inlineLength);
+    return *this;
+}
+
+String::~String(){
+    if(!isInline()){
+        drop(data());
+    }
+}
+
+bool String::isInline() const {
+    return inlineLength != heapTag;
+}
+
+StringData* String::data() const {
+    StringData *data;
+    std::memcpy(&data, inlineText, sizeof(data));
+    return data;
+}
+
+void String::setData(StringData *data){
+    std::memcpy(inlineText, &data, sizeof(data));
+    inlineLength = heapTag;
+}
+
+Ref<StringData> String::toData() const {
+    if(isInline()){
+        return makeRef<StringData>(std::string(inlineText, inlineLength));
+    }
+    dup(data());
+    return Ref<StringData>(data());
+}
+
+size_t String::size() const {
+    return isInline() ? inlineLength : data()->length;
+}
+
+bool String::isRope() const {
+    return !isInline() && data()->isRope();
+}
+
+std::string_view String::view() const {
+    if(isInline()){
+        return std::string_view(inlineText, inlineLength);
+    }
+    data()->flatten();
+    return data()->flat;
+}
+
+char String::operator[](size_t i) const {
+    return view()[i];
+}
+
+bool String::operator==(const String &other) const {
+    if(size() != other.size()){
+        return false;
+    }
+    std::string_view a = view();
+    std::string_view b = other.view();
+    return bytesEqual(a.data(), b.data(), a.length());
+}
+
+// Short results are built inline or flat, long ones become a rope node in O(1)
+String String::concat(const String &a, const String &b){
+    size_t total = a.size() + b.size();
+    if(total < ropeMinimum){
+        std::string text;
+        text.reserve(total);
+        text += a.view();
+        text += b.view();
+        return String(text);
+    }
+    return String(makeRef<StringData>(a.toData(), b.toData()));
+}
+
+String String::concatAll(std::span<const String> parts){
+    size_t total = 0;
+    for(const String &part : parts){
+        total += part.size();
+    }
+    std::string text(total, '\0');
+    char *out = text.data();
+    for(const String &part : parts){
+        std::string_view view = part.view();
+        std::memcpy(out, view.data(), view.length());
+        out += view.length();
+    }
+    return String(text);
+}
+
+String String::sorted() const {
+    std::string text(view());
+    sortBytes(text.data(), text.size());
+    return String(text);
+}
+
+std::ostream& operator<<(std::ostream &os, const String &str){
+    return os << str.view();
+}
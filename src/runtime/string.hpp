@@ -0,0 +1,78 @@
+#pragma once
+
+#include "object.hpp"
+
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+// Concatenations shorter than this are copied right away, a rope node would cost more
+static constexpr size_t ropeMinimum = 256;
+
+// Heap part of a long string. Either flat text or a rope: the concatenation of two strings
+// that is only performed, once, when the text is first read.
+// A shared rope may be read from several threads. The first reader writes `flat` and then
+// publishes it through `hasFlat`, the others wait for it. The children are released only
+// by a sole owner, any other reader may still be walking them
+struct StringData : public Object {
+    std::string flat;
+    Ref<StringData> left;
+    Ref<StringData> right;
+    size_t length;
+    std::atomic<bool> hasFlat;
+    std::once_flag flattened;
+
+    StringData(std::string text);
+    StringData(Ref<StringData> left, Ref<StringData> right);
+    ~StringData();
+
+    bool isRope() const;
+    // Writes the whole text into `flat`, releases the children when nobody else holds the rope
+    void flatten();
+    void trace(const Tracer&) override;
+    // Byte-wise, like String. A rope is compared through a flat copy, never flattened in place
+    std::weak_ordering compare(const Object&) const override;
+};
+
+// Runtime string, 24 bytes. Up to inlineCapacity bytes are stored inline without any
+// allocation, longer text lives in a shared StringData
+class String {
+public:
+    static constexpr size_t inlineCapacity = 23;
+private:
+    static constexpr uint8_t heapTag = 0xFF;
+
+    // Holds the characters, or for a heap string the StringData pointer
+    char inlineText[inlineCapacity];
+    uint8_t inlineLength;
+
+    explicit String(Ref<StringData>);
+    bool isInline() const;
+    StringData* data() const;
+    void setData(StringData*);
+    // Shares or creates a StringData holding this string, for use as a rope child
+    Ref<StringData> toData() const;
+public:
+    String();
+    String(std::string_view);
+    String(const String&);
+    String(String&&);
+    String& operator=(String);
+    ~String();
+
+    size_t size() const;
+    bool isRope() const;
+    // Flattens a rope on first use
+    std::string_view view() const;
+    char operator[](size_t) const;
+    bool operator==(const String&) const;
+
+    static String concat(const String&, const String&);
+    // One allocation of the total size, every part copied once
+    static String concatAll(std::span<const String>);
+    // The bytes in ascending order, compared as unsigned like the other string comparisons
+    String sorted() const;
+};
+
+std::ostream& operator<<(std::ostream&, const String&);
@@ -0,0 +1,115 @@
+#include "thread-pool.hpp"
+
+ThreadPool::ThreadPool(size_t threads){
+    if(threads == 0){
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    // Slot 0 belongs to threads outside the pool
+    for(size_t i = 0; i < threads; i++){
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for(size_t i = 1; i < threads; i++){
+        this->threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(std::thread &thread : threads){
+        thread.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+static thread_local size_t currentWorker = 0;
+
+void ThreadPool::submit(std::function<void()> task){
+    Worker &worker = *workers[currentWorker < workers.size() ? currentWorker : 0];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued++;
+    }
+    wake.notify_one();
+    progress.notify_all();
+}
+
+// Own tasks are taken newest first while they are still in cache, stolen ones oldest first
+bool ThreadPool::tryRunTask(size_t self){
+    std::function<void()> task;
+    for(size_t i = 0; i < workers.size() && !task; i++){
+        Worker &worker = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if(worker.tasks.empty()){
+            continue;
+        }
+        if(i == 0){
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        } else {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        }
+    }
+    if(!task){
+        return false;
+    }
+    queued--;
+    task();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        finished++;
+    }
+    progress.notify_all();
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t self){
+    currentWorker = self;
+    while(true){
+        if(tryRunTask(self)){
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]{ return stopping || queued > 0; });
+        if(stopping){
+            return;
+        }
+    }
+}
+
+// The finished count is read before `done` is checked, a task finishing in between is
+// noticed by the wait and never slept through
+void ThreadPool::helpUntil(const std::function<bool()> &done){
+    size_t self = currentWorker < workers.size() ? currentWorker : 0;
+    while(true){
+        size_t seen = finished;
+        if(done()){
+            return;
+        }
+        if(tryRunTask(self)){
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        progress.wait(lock, [&]{ return queued > 0 || finished != seen; });
+    }
+}
+
+ThreadPool& ThreadPool::global(){
+    static ThreadPool pool(globalThreads);
+    return pool;
+}
+
+void ThreadPool::setGlobalThreads(size_t threads){
+    globalThreads = threads;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "../include/utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Work below this many cost units (see estimateCost) isn't worth handing to another thread
+static constexpr size_t parallelMinimumWork = 1 << 14;
+// Chunks per worker, more chunks than workers lets stealing even out uneven iterations
+static constexpr size_t parallelChunksPerWorker = 8;
+
+// Work-stealing pool. Every worker owns a deque, it takes its own tasks from the back and
+// steals from the front of the others when it runs dry
+class ThreadPool {
+private:
+    struct Worker {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping = false;
+    std::atomic<size_t> queued = 0;
+    std::atomic<size_t> finished = 0;
+    std::mutex sleepMutex;
+    // Workers sleep on `wake` until a task is queued, helpUntil on `progress` until a task
+    // is queued or one finishes
+    std::condition_variable wake;
+    std::condition_variable progress;
+
+    static inline size_t globalThreads = 0;
+
+    bool tryRunTask(size_t);
+    void workerLoop(size_t);
+public:
+    // 0 threads uses every hardware thread. The calling thread always works too,
+    // so a pool of size 1 starts no threads at all
+    ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const;
+    void submit(std::function<void()>);
+    // Runs queued tasks on the calling thread until `done` holds. With nothing left to run it
+    // sleeps until another task is queued or one finishes, `done` must only become true
+    // through tasks of this pool
+    void helpUntil(const std::function<bool()>&);
+
+    // Calls body(begin, end) over chunks of [0, count) of `grain` indices. Chunks write their
+    // own part of the result, so the output order is the sequential one.
+    // The first exception thrown by a chunk is rethrown once every chunk has finished
+    template<typename F>
+    void parallelFor(size_t count, size_t grain, F &&body){
+        grain = std::max<size_t>(grain, 1);
+        if(size() <= 1 || count <= grain){
+            body(0, count);
+            return;
+        }
+        size_t chunks = (count + grain - 1) / grain;
+        std::atomic<size_t> remaining = chunks;
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        auto runChunk = [&](size_t chunk){
+            try {
+                body(chunk * grain, std::min(count, (chunk + 1) * grain));
+            } catch(...){
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if(!error){
+                    error = std::current_exception();
+                }
+            }
+            remaining--;
+        };
+        for(size_t chunk = 1; chunk < chunks; chunk++){
+            submit([&runChunk, chunk]{ runChunk(chunk); });
+        }
+        runChunk(0);
+        helpUntil([&]{ return remaining == 0; });
+        if(error){
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Evaluates a dependency graph laid out like Block::dependencies and Block::spawn.
+    // Spawned nodes run as tasks once their dependencies are done, the others run on the
+    // calling thread in index order. Effects happen in program order because every node with
+    // effects depends on the spawned nodes before it, see Optimizer::scheduleBindings
+    template<typename F>
+    void runGraph(const std::vector<std::vector<size_t>> &dependencies, const std::vector<bool> &spawn, F &&evaluate){
+        size_t count = dependencies.size();
+        std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[count]);
+        for(size_t i = 0; i < count; i++){
+            done[i] = false;
+        }
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        auto run = [&](size_t i){
+            helpUntil([&]{
+                return std::all_of(dependencies[i].begin(), dependencies[i].end(), [&](size_t dep){ return done[dep].load(); });
+            });
+            // Once something failed the rest is skipped, no effect after the error becomes visible
+            bool failed;
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                failed = error != nullptr;
+            }
+            try {
+                if(!failed){
+                    evaluate(i);
+                }
+            } catch(...){
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if(!error){
+                    error = std::current_exception();
+                }
+            }
+            done[i] = true;
+        };
+        for(size_t i = 0; i < count; i++){
+            if(spawn[i] && size() > 1){
+                submit([&run, i]{ run(i); });
+            } else {
+                run(i);
+            }
+        }
+        helpUntil([&]{
+            return std::all_of(done.get(), done.get() + count, [](const std::atomic<bool> &flag){ return flag.load(); });
+        });
+        if(error){
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Sized by setGlobalThreads (the --threads option) before its first use
+    static ThreadPool& global();
+    static void setGlobalThreads(size_t);
+};
+
+// Indices per chunk: enough to amortize handing the chunk over, few enough to give every worker several
+static size_t chooseGrain(size_t count, size_t bodyCost, size_t workers){
+    size_t minimum = (parallelMinimumWork + bodyCost - 1) / std::max<size_t>(bodyCost, 1);
+    size_t balanced = count / std::max<size_t>(workers * parallelChunksPerWorker, 1);
+    return std::max<size_t>({ minimum, balanced, 1 });
+}
+
+static bool shouldParallelize(size_t count, size_t bodyCost, size_t workers){
+    return workers > 1 && count > 1 && count * std::max<size_t>(bodyCost, 1) >= 2 * parallelMinimumWork;
+}
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "../include/utils.hpp"
+#include "shape.hpp"
 
 #include <unordered_map>
 
 struct Type {
     bool isPrimitive;
     std::unordered_map<std::string_view, Type> attributes;
+    Shape *shape = nullptr; // Layout of a record type's instances, fields in declaration order
 };
\ No newline at end of file